@@ -0,0 +1,43 @@
+#include "account_table.hpp"
+#include <mutex>
+#include <stdexcept>
+
+AccountId AddressTable::intern(const std::string& address) {
+    {
+        std::shared_lock<std::shared_mutex> lock(tableMutex);
+        auto it = ids.find(address);
+        if (it != ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(tableMutex);
+    auto [it, inserted] = ids.emplace(address, static_cast<AccountId>(addresses.size()));
+    if (inserted) {
+        if (addresses.size() >= INVALID_ACCOUNT_ID) {
+            ids.erase(it);
+            throw std::runtime_error("Address table is full");
+        }
+        addresses.push_back(address);
+    }
+    return it->second;
+}
+
+AccountId AddressTable::find(const std::string& address) const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    auto it = ids.find(address);
+    return it != ids.end() ? it->second : INVALID_ACCOUNT_ID;
+}
+
+const std::string& AddressTable::getAddress(AccountId id) const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    if (id >= addresses.size()) {
+        throw std::out_of_range("Unknown account id");
+    }
+    return addresses[id];
+}
+
+size_t AddressTable::size() const {
+    std::shared_lock<std::shared_mutex> lock(tableMutex);
+    return addresses.size();
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+
+// Dense identifier for an interned address
+using AccountId = uint32_t;
+constexpr AccountId INVALID_ACCOUNT_ID = UINT32_MAX;
+
+// Maps each address to a dense AccountId, assigned in first-seen order, so
+// account state can live in flat arrays and an address string is hashed
+// once per transaction rather than on every balance access.
+class AddressTable {
+private:
+    std::unordered_map<std::string, AccountId> ids;
+    std::deque<std::string> addresses;     // Stable references, indexed by id
+    mutable std::shared_mutex tableMutex;
+
+public:
+    // Returns the existing id or assigns the next one
+    AccountId intern(const std::string& address);
+
+    // INVALID_ACCOUNT_ID for addresses never interned
+    AccountId find(const std::string& address) const;
+
+    const std::string& getAddress(AccountId id) const;
+    size_t size() const;
+};
+
+struct AccountState {
+    double balance;
+};
+
+// Account state indexed by AccountId. Not synchronized: callers size it
+// before a parallel pass, after which disjoint ids may be updated
+// concurrently.
+class AccountTable {
+private:
+    std::vector<AccountState> accounts;
+
+public:
+    void ensureSize(size_t count) {
+        if (accounts.size() < count) {
+            accounts.resize(count, AccountState{0.0});
+        }
+    }
+
+    // Ids past the end have never been credited
+    double getBalance(AccountId id) const {
+        return id < accounts.size() ? accounts[id].balance : 0.0;
+    }
+
+    AccountState& operator[](AccountId id) { return accounts[id]; }
+    size_t size() const { return accounts.size(); }
+};
\ No newline at end of file
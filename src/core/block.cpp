@@ -1,25 +1,78 @@
 #include "block.hpp"
-#include <sstream>
+#include "../utils/block_arena.hpp"
+#include <charconv>
+#include <memory_resource>
 
-Block::Block(uint32_t indexIn, const std::vector<Transaction>& transactionsIn, const std::string& previousHashIn) 
+namespace {
+    template<typename T>
+    void appendDecimal(std::pmr::string& buffer, T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+    }
+    
+    std::string hashHeaderFields(uint32_t index,
+                                 time_t timestamp,
+                                 const std::string& previousHash,
+                                 const std::string& merkleRoot,
+                                 uint32_t nonce) {
+        // Built in the block arena when there is one
+        std::pmr::string buffer(BlockArena::current());
+        buffer.reserve(64 + previousHash.size() + merkleRoot.size());
+        appendDecimal(buffer, index);
+        appendDecimal(buffer, timestamp);
+        buffer += previousHash;
+        buffer += merkleRoot;
+        appendDecimal(buffer, nonce);
+        
+        return SHA256::hash(buffer.data(), buffer.size());
+    }
+}
+
+std::string BlockHeader::calculateHash() const {
+    return hashHeaderFields(index, timestamp, previousHash, merkleRoot, nonce);
+}
+
+Block::Block(uint32_t indexIn, std::vector<Transaction> transactionsIn, const std::string& previousHashIn) 
     : index(indexIn), 
-      transactions(transactionsIn), 
+      transactions(std::move(transactionsIn)), 
       previousHash(previousHashIn),
       timestamp(std::time(nullptr)),
       nonce(0) {
+    merkleRoot = computeMerkleRoot();
     hash = calculateHash();
 }
 
+Block::Block(const BlockHeader& header, std::vector<Transaction> transactionsIn)
+    : index(header.index),
+      timestamp(header.timestamp),
+      previousHash(header.previousHash),
+      hash(header.hash),
+      transactions(std::move(transactionsIn)),
+      merkleRoot(header.merkleRoot),
+      nonce(header.nonce) {
+}
+
 std::string Block::calculateHash() const {
-    std::stringstream ss;
-    ss << index << timestamp << previousHash;
-    
+    // Only the header is hashed, so mining never rehashes the transactions
+    return hashHeaderFields(index, timestamp, previousHash, merkleRoot, nonce);
+}
+
+std::string Block::computeMerkleRoot() const {
+    std::vector<std::string> transactionHashes;
+    transactionHashes.reserve(transactions.size());
     for (const Transaction& transaction : transactions) {
-        ss << transaction.getHash();
+        transactionHashes.push_back(transaction.getHash());
     }
-    ss << nonce;
-    
-    return SHA256::hash(ss.str());
+    return HashUtils::calculateMerkleRoot(transactionHashes);
+}
+
+BlockHeader Block::getHeader() const {
+    return {index, timestamp, previousHash, merkleRoot, nonce, hash};
+}
+
+bool Block::hasValidMerkleRoot() const {
+    return computeMerkleRoot() == merkleRoot;
 }
 
 void Block::mineBlock(uint32_t difficulty) {
@@ -34,6 +87,7 @@ void Block::mineBlock(uint32_t difficulty) {
 bool Block::isValid() const {
     // Verify block integrity
     if (calculateHash() != hash) return false;
+    if (!hasValidMerkleRoot()) return false;
     
     // Verify all transactions
     for (const Transaction& tx : transactions) {
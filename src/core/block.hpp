@@ -4,6 +4,20 @@
 #include <ctime>
 #include "../crypto/hash.hpp"
 
+// The fields a block's hash commits to. Transactions are covered through
+// the merkle root, so a header chain can be fetched and checked before
+// any block body.
+struct BlockHeader {
+    uint32_t index;
+    time_t timestamp;
+    std::string previousHash;
+    std::string merkleRoot;
+    uint32_t nonce;
+    std::string hash;
+    
+    std::string calculateHash() const;
+};
+
 class Block {
 private:
     uint32_t index;
@@ -11,21 +25,42 @@ private:
     std::string previousHash;
     std::string hash;
     std::vector<Transaction> transactions;
+    std::string merkleRoot;
     uint32_t nonce;
     
 public:
-    Block(uint32_t indexIn, const std::vector<Transaction>& transactionsIn, const std::string& previousHashIn);
+    Block(uint32_t indexIn, std::vector<Transaction> transactionsIn, const std::string& previousHashIn);
+    
+    // Rebuilds a block received from a peer. The header is taken as sent,
+    // hash included, so validation catches a body that does not match it.
+    Block(const BlockHeader& header, std::vector<Transaction> transactionsIn);
+    
+    // Blocks are moved through the pipeline and into the chain, never
+    // copied on the hot path
+    Block(const Block&) = default;
+    Block(Block&&) noexcept = default;
+    Block& operator=(const Block&) = default;
+    Block& operator=(Block&&) noexcept = default;
     
     // Core functionality
     std::string calculateHash() const;
     void mineBlock(uint32_t difficulty);
     
     // Getters
-    std::string getHash() const { return hash; }
-    std::string getPreviousHash() const { return previousHash; }
-    std::vector<Transaction> getTransactions() const { return transactions; }
+    uint32_t getIndex() const { return index; }
+    const std::string& getHash() const { return hash; }
+    const std::string& getPreviousHash() const { return previousHash; }
+    const std::vector<Transaction>& getTransactions() const { return transactions; }
     time_t getTimestamp() const { return timestamp; }
+    const std::string& getMerkleRoot() const { return merkleRoot; }
+    BlockHeader getHeader() const;
     
     // Validation
     bool isValid() const;
+    
+    // True if the transactions hash to the merkle root the header commits to
+    bool hasValidMerkleRoot() const;
+    
+private:
+    std::string computeMerkleRoot() const;
 }; 
\ No newline at end of file
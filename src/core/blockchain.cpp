@@ -1,65 +1,289 @@
 #include "blockchain.hpp"
+#include "transaction_scheduler.hpp"
+#include "../validation/committee.hpp"
+#include "../utils/tracer.hpp"
+#include "../utils/thread_pool.hpp"
+#include "../utils/block_arena.hpp"
 #include <stdexcept>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+
+namespace {
+    // Transactions verified per pool task in the signature stage
+    constexpr size_t SIGNATURE_BATCH_SIZE = 16;
+    
+    // Below this many transactions a block is cheaper to process serially
+    constexpr size_t PARALLEL_THRESHOLD = 64;
+    
+    // Conflict-free groups are batched until a task has this many transactions
+    constexpr size_t GROUP_BATCH_SIZE = 32;
+    
+    // Runs fn over every group, in parallel for large blocks. Groups touch
+    // disjoint state, so the result does not depend on scheduling.
+    bool forEachGroup(const std::vector<std::vector<size_t>>& groups,
+                      size_t transactionCount,
+                      const std::function<bool(const std::vector<size_t>&)>& fn) {
+        if (transactionCount < PARALLEL_THRESHOLD || groups.size() < 2) {
+            for (const auto& group : groups) {
+                if (!fn(group)) return false;
+            }
+            return true;
+        }
+        
+        std::atomic<bool> succeeded(true);
+        ThreadPool::TaskGroup tasks(ThreadPool::getInstance());
+        
+        size_t begin = 0;
+        while (begin < groups.size()) {
+            size_t end = begin;
+            size_t batched = 0;
+            while (end < groups.size() && batched < GROUP_BATCH_SIZE) {
+                batched += groups[end].size();
+                end++;
+            }
+            
+            tasks.run([&, begin, end]() {
+                for (size_t g = begin; g < end && !tasks.isCancelled(); g++) {
+                    if (!fn(groups[g])) {
+                        succeeded.store(false);
+                        tasks.cancel();
+                    }
+                }
+            });
+            begin = end;
+        }
+        tasks.wait();
+        
+        return succeeded.load();
+    }
+}
 
 Blockchain::Blockchain() 
     : difficulty(4),
       miningReward(100),
-      consensusThreshold(75) {
+      consensusThreshold(75),
+      committeeSize(0) {
     // Create genesis block
-    std::vector<Transaction> genesisTransactions;
-    chain.emplace_back(Block(0, genesisTransactions, "0"));
+    chain.emplace_back(0, std::vector<Transaction>(), "0");
+    heightByHash[chain.back().getHash()] = 0;
 }
 
 void Blockchain::addBlock(Block& block) {
+    const uint64_t traceId = Tracer::traceIdFor(block.getHash());
+    TRACE_SPAN("blockchain.addBlock", traceId);
+    
     if (!validateBlock(block)) {
         throw std::runtime_error("Invalid block");
     }
     
-    if (!reachConsensus(block)) {
-        throw std::runtime_error("Consensus not reached");
+    {
+        TRACE_SPAN("blockchain.reachConsensus", traceId);
+        if (!reachConsensus(block)) {
+            throw std::runtime_error("Consensus not reached");
+        }
     }
     
-    chain.push_back(block);
+    commitBlock(block);
+}
+
+void Blockchain::commitBlock(const Block& block) {
+    // Callers must have validated the block and reached consensus
+    TRACE_SPAN("blockchain.applyState", Tracer::traceIdFor(block.getHash()));
+    BlockArena arena;
+    BlockArena::Scope arenaScope(arena);
+    {
+        std::unique_lock<std::shared_mutex> lock(chainMutex);
+        chain.push_back(block);
+        heightByHash[block.getHash()] = chain.size() - 1;
+    }
+    
+    const std::vector<Transaction>& transactions = block.getTransactions();
+    auto groups = TransactionScheduler::partition(transactions);
+    
+    // Intern every touched account and size the table up front, so groups
+    // applied in parallel only index existing slots
+    std::vector<Transfer> transfers(transactions.size(),
+                                    Transfer{INVALID_ACCOUNT_ID, INVALID_ACCOUNT_ID, 0.0});
+    for (size_t i = 0; i < transactions.size(); i++) {
+        if (transactions[i].getType() == TransactionType::FINANCIAL) {
+            transfers[i] = internTransfer(transactions[i]);
+        }
+    }
+    accounts.ensureSize(addresses.size());
     
     // Process all transactions in the block
+    forEachGroup(groups, transactions.size(), [&](const std::vector<size_t>& group) {
+        for (size_t index : group) {
+            if (transfers[index].sender != INVALID_ACCOUNT_ID) {
+                applyTransfer(transfers[index]);
+            }
+        }
+        return true;
+    });
+}
+
+void Blockchain::collectBalanceDeltas(const Block& block,
+                                      std::unordered_map<std::string, double>& deltas) const {
     for (const auto& transaction : block.getTransactions()) {
-        processTransaction(transaction);
+        if (transaction.getType() == TransactionType::FINANCIAL) {
+            deltas[transaction.getSender()] -= transaction.getAmount();
+            deltas[transaction.getRecipient()] += transaction.getAmount();
+        }
     }
 }
 
+void Blockchain::registerValidator(std::shared_ptr<Validator> validator, bool isFinancialValidator) {
+    // The pools are read by consensus without a lock, so validators are
+    // registered before blocks start arriving
+    auto& pool = isFinancialValidator ? financialValidators : messageValidators;
+    pool.push_back(std::move(validator));
+}
+
 void Blockchain::processTransaction(const Transaction& transaction) {
-    if (transaction.getType() == TransactionType::FINANCIAL) {
-        std::string sender = transaction.getSender();
-        std::string recipient = transaction.getRecipient();
-        double amount = transaction.getAmount();
-        
-        // Update balances
-        accountBalances[sender] -= amount;
-        accountBalances[recipient] += amount;
+    if (transaction.getType() != TransactionType::FINANCIAL) {
+        return;
+    }
+    
+    Transfer transfer = internTransfer(transaction);
+    accounts.ensureSize(addresses.size());
+    applyTransfer(transfer);
+}
+
+Blockchain::Transfer Blockchain::internTransfer(const Transaction& transaction) {
+    return Transfer{addresses.intern(transaction.getSender()),
+                    addresses.intern(transaction.getRecipient()),
+                    transaction.getAmount()};
+}
+
+void Blockchain::applyTransfer(const Transfer& transfer) {
+    // Both accounts must already have slots; disjoint transfers may be
+    // applied concurrently
+    accounts[transfer.sender].balance -= transfer.amount;
+    accounts[transfer.recipient].balance += transfer.amount;
+}
+
+double Blockchain::getBalance(const std::string& address) const {
+    AccountId id = addresses.find(address);
+    return id == INVALID_ACCOUNT_ID ? 0.0 : accounts.getBalance(id);
+}
+
+std::vector<BlockHeader> Blockchain::getHeadersAfter(const std::string& fromHash, size_t maxHeaders) const {
+    std::shared_lock<std::shared_mutex> lock(chainMutex);
+    std::vector<BlockHeader> headers;
+    
+    auto it = heightByHash.find(fromHash);
+    if (it == heightByHash.end()) {
+        return headers;
+    }
+    
+    const size_t end = std::min(chain.size(), it->second + 1 + maxHeaders);
+    headers.reserve(end - it->second - 1);
+    for (size_t height = it->second + 1; height < end; height++) {
+        headers.push_back(chain[height].getHeader());
     }
+    return headers;
+}
+
+std::optional<Block> Blockchain::findBlock(const std::string& hash) const {
+    std::shared_lock<std::shared_mutex> lock(chainMutex);
+    auto it = heightByHash.find(hash);
+    if (it == heightByHash.end()) {
+        return std::nullopt;
+    }
+    return chain[it->second];
 }
 
 bool Blockchain::validateBlock(const Block& block) const {
-    // Basic validation
-    if (!block.isValid()) return false;
+    const uint64_t traceId = Tracer::traceIdFor(block.getHash());
+    TRACE_SPAN("blockchain.validateBlock", traceId);
     
-    // Validate previous hash
-    if (block.getPreviousHash() != getLatestBlock().getHash()) return false;
+    return validateBlockStateless(block) && validateBlockState(block);
+}
+
+bool Blockchain::validateBlockStateless(const Block& block) const {
+    const uint64_t traceId = Tracer::traceIdFor(block.getHash());
     
-    // Validate transactions
-    for (const auto& transaction : block.getTransactions()) {
-        if (!transaction.isValid()) return false;
+    // Hashing and signature temporaries of every worker are freed together
+    BlockArena arena;
+    BlockArena::Scope arenaScope(arena);
+    
+    // Block integrity. The hash covers only the header, so the body must
+    // be checked against the merkle root it commits to.
+    {
+        TRACE_SPAN("blockchain.validateBlock.integrity", traceId);
+        if (block.calculateHash() != block.getHash()) return false;
+        if (!block.hasValidMerkleRoot()) return false;
+    }
+    
+    // Signature batch: transactions are independent here, so verify them
+    // in parallel and stop at the first failure
+    TRACE_SPAN("blockchain.validateBlock.signatures", traceId);
+    const std::vector<Transaction>& transactions = block.getTransactions();
+    std::atomic<bool> valid(true);
+    
+    ThreadPool::TaskGroup group(ThreadPool::getInstance());
+    for (size_t begin = 0; begin < transactions.size(); begin += SIGNATURE_BATCH_SIZE) {
+        group.run([&, begin]() {
+            size_t end = std::min(begin + SIGNATURE_BATCH_SIZE, transactions.size());
+            for (size_t i = begin; i < end && !group.isCancelled(); i++) {
+                if (!transactions[i].isValid()) {
+                    valid.store(false);
+                    group.cancel();
+                }
+            }
+        });
+    }
+    group.wait();
+    
+    return valid.load();
+}
+
+bool Blockchain::validateBlockState(const Block& block, const StateOverlay* overlay) const {
+    TRACE_SPAN("blockchain.validateBlock.state", Tracer::traceIdFor(block.getHash()));
+    BlockArena arena;
+    BlockArena::Scope arenaScope(arena);
+    
+    // Validate previous hash against the speculative tip when one is given
+    const std::string& expectedPrevious = (overlay && !overlay->tipHash.empty())
+        ? overlay->tipHash
+        : getLatestBlock().getHash();
+    if (block.getPreviousHash() != expectedPrevious) return false;
+    
+    // Validate conflict-free groups in parallel. Within a group balances
+    // are tracked cumulatively, so repeated spends from one account in the
+    // same block are checked against what is actually left.
+    const std::vector<Transaction>& transactions = block.getTransactions();
+    auto groups = TransactionScheduler::partition(transactions);
+    
+    return forEachGroup(groups, transactions.size(), [&](const std::vector<size_t>& group) {
+        std::pmr::unordered_map<std::string, double> groupDeltas(BlockArena::current());
         
-        // Additional validation for financial transactions
-        if (transaction.getType() == TransactionType::FINANCIAL) {
-            if (getBalance(transaction.getSender()) < transaction.getAmount()) {
+        for (size_t index : group) {
+            const Transaction& transaction = transactions[index];
+            
+            // Additional validation for financial transactions
+            if (transaction.getType() != TransactionType::FINANCIAL) continue;
+            
+            const std::string& sender = transaction.getSender();
+            double balance = getBalance(sender) + groupDeltas[sender];
+            if (overlay) {
+                auto it = overlay->balanceDeltas.find(sender);
+                if (it != overlay->balanceDeltas.end()) {
+                    balance += it->second;
+                }
+            }
+            
+            if (balance < transaction.getAmount()) {
                 return false;
             }
+            
+            groupDeltas[sender] -= transaction.getAmount();
+            groupDeltas[transaction.getRecipient()] += transaction.getAmount();
         }
-    }
-    
-    return true;
+        
+        return true;
+    });
 }
 
 bool Blockchain::reachConsensus(const Block& block) const {
@@ -67,15 +291,28 @@ bool Blockchain::reachConsensus(const Block& block) const {
     size_t approvalCount = 0;
     
     // Get appropriate validator pool based on transaction types
+    const std::vector<Transaction>& transactions = block.getTransactions();
     bool hasFinancialTx = std::any_of(
-        block.getTransactions().begin(),
-        block.getTransactions().end(),
+        transactions.begin(),
+        transactions.end(),
         [](const Transaction& tx) { 
             return tx.getType() == TransactionType::FINANCIAL; 
         }
     );
     
-    const auto& validators = hasFinancialTx ? financialValidators : messageValidators;
+    const auto& pool = hasFinancialTx ? financialValidators : messageValidators;
+    
+    // Poll a stake-weighted committee seeded by the parent hash, or the
+    // whole pool when no committee size is configured
+    std::vector<std::shared_ptr<Validator>> committee;
+    if (committeeSize > 0) {
+        committee = CommitteeSelector::selectCommittee(
+            pool, CommitteeSelector::deriveSeed(block.getPreviousHash()), committeeSize);
+    }
+    const auto& validators = committeeSize > 0 ? committee : pool;
+    if (validators.empty()) {
+        return false;
+    }
     
     // Collect validator votes
     for (const auto& validator : validators) {
@@ -2,14 +2,33 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include "block.hpp"
+#include "account_table.hpp"
 #include "../validation/validator.hpp"
 
+// Uncommitted effects of blocks accepted speculatively ahead of the tip
+struct StateOverlay {
+    std::string tipHash;
+    std::unordered_map<std::string, double> balanceDeltas;
+};
+
 class Blockchain {
 private:
     std::vector<Block> chain;
     std::vector<Transaction> pendingTransactions;
-    std::unordered_map<std::string, double> accountBalances;
+    
+    // Height of every block on the chain, so peers syncing from any point
+    // are answered without a scan. Commits take chainMutex exclusively;
+    // serving peers takes it shared.
+    std::unordered_map<std::string, size_t> heightByHash;
+    mutable std::shared_mutex chainMutex;
+    
+    // Balances live in a flat table indexed by interned account id
+    AddressTable addresses;
+    AccountTable accounts;
+    
     uint32_t difficulty;
     double miningReward;
     
@@ -19,12 +38,14 @@ private:
     
     // Consensus parameters
     uint32_t consensusThreshold;
+    size_t committeeSize; // 0 polls every validator in the pool
     
 public:
     Blockchain();
     
     // Core blockchain operations
     void addBlock(Block& block);
+    void commitBlock(const Block& block);
     bool isChainValid() const;
     void minePendingTransactions(const std::string& minerAddress);
     
@@ -36,13 +57,37 @@ public:
     void registerValidator(std::shared_ptr<Validator> validator, bool isFinancialValidator);
     void removeValidator(const std::string& validatorAddress);
     double calculateValidatorReward(const std::string& validatorAddress) const;
+    void setCommitteeSize(size_t size) { committeeSize = size; }
     
     // Getters
     size_t getChainLength() const { return chain.size(); }
-    Block getLatestBlock() const { return chain.back(); }
+    // Valid until the next block is added
+    const Block& getLatestBlock() const { return chain.back(); }
     double getBalance(const std::string& address) const;
     
+    // Serving peers: headers of up to maxHeaders blocks after fromHash
+    // (none if fromHash is not on the chain), and block bodies by hash.
+    // Both copy, since the chain may grow while the result is in use.
+    std::vector<BlockHeader> getHeadersAfter(const std::string& fromHash, size_t maxHeaders) const;
+    std::optional<Block> findBlock(const std::string& hash) const;
+    
     // Consensus methods
     bool validateBlock(const Block& block) const;
+    bool validateBlockStateless(const Block& block) const;
+    bool validateBlockState(const Block& block, const StateOverlay* overlay = nullptr) const;
     bool reachConsensus(const Block& block) const;
+    
+    // Balance changes a block would apply, for speculative overlays
+    void collectBalanceDeltas(const Block& block,
+                              std::unordered_map<std::string, double>& deltas) const;
+    
+private:
+    struct Transfer {
+        AccountId sender;
+        AccountId recipient;
+        double amount;
+    };
+    
+    Transfer internTransfer(const Transaction& transaction);
+    void applyTransfer(const Transfer& transfer);
 }; 
\ No newline at end of file
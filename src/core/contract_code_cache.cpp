@@ -0,0 +1,42 @@
+#include "contract_code_cache.hpp"
+#include "../crypto/hash.hpp"
+#include <mutex>
+#include <stdexcept>
+
+std::string ContractCodeCache::hashBytecode(const std::string& bytecode) {
+    return SHA256::hash(bytecode);
+}
+
+std::shared_ptr<const CompiledContract> ContractCodeCache::getOrCompile(const std::string& bytecode,
+                                                                        std::string& codeHash) {
+    codeHash = hashBytecode(bytecode);
+    
+    {
+        std::shared_lock<std::shared_mutex> lock(cacheMutex);
+        auto it = entries.find(codeHash);
+        if (it != entries.end()) {
+            return it->second;
+        }
+    }
+    
+    // Compile outside the lock; a racing deployment of the same code just
+    // finds the other thread's entry on insert
+    std::shared_ptr<const CompiledContract> code = ContractCompiler::compile(bytecode);
+    if (!code->hasConstructor) {
+        throw std::invalid_argument("Contract bytecode has no constructor");
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(cacheMutex);
+    return entries.emplace(codeHash, code).first->second;
+}
+
+std::shared_ptr<const CompiledContract> ContractCodeCache::get(const std::string& codeHash) const {
+    std::shared_lock<std::shared_mutex> lock(cacheMutex);
+    auto it = entries.find(codeHash);
+    return it != entries.end() ? it->second : nullptr;
+}
+
+size_t ContractCodeCache::size() const {
+    std::shared_lock<std::shared_mutex> lock(cacheMutex);
+    return entries.size();
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+#include "contract_vm.hpp"
+
+// Validated, compiled contract code keyed by bytecode hash. Contracts
+// deployed from identical bytecode share one compiled program, so repeat
+// deployments skip tokenizing and validation entirely.
+class ContractCodeCache {
+private:
+    std::unordered_map<std::string, std::shared_ptr<const CompiledContract>> entries;
+    mutable std::shared_mutex cacheMutex;
+    
+public:
+    static std::string hashBytecode(const std::string& bytecode);
+    
+    // Returns the compiled program for the bytecode, compiling it on first
+    // sight. Throws std::invalid_argument for bytecode that does not
+    // compile or has no constructor; failures are not cached so junk
+    // deployments cannot grow the cache.
+    std::shared_ptr<const CompiledContract> getOrCompile(const std::string& bytecode,
+                                                         std::string& codeHash);
+    
+    std::shared_ptr<const CompiledContract> get(const std::string& codeHash) const;
+    size_t size() const;
+};
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "contract_storage.hpp"
+#include "smart_contract.hpp"
+
+ContractStorage::ContractStorage(const std::string& pathIn, size_t cacheEntries)
+    : store(pathIn),
+      nodeStore(*this),
+      tree(nodeStore),
+      valueCache(cacheEntries),
+      nodeCache(cacheEntries),
+      version(0) {
+    const std::string rootPrefix = rootKey("");
+    for (const std::string& key : store.keysWithPrefix(rootPrefix)) {
+        std::string root;
+        if (store.get(key, root)) {
+            roots[key.substr(rootPrefix.size())] = root;
+        }
+    }
+    publishSnapshot(true);
+}
+
+std::string ContractStorage::storageKey(const std::string& contractAddress, const std::string& key) {
+    // Addresses never contain NUL, so the separator keeps keys unambiguous
+    std::string result;
+    result.reserve(1 + contractAddress.size() + 1 + key.size());
+    result += 's';
+    result += contractAddress;
+    result += '\0';
+    result += key;
+    return result;
+}
+
+std::string ContractStorage::nodeKey(const std::string& hash) {
+    return "n" + hash;
+}
+
+std::string ContractStorage::rootKey(const std::string& contractAddress) {
+    return "r" + contractAddress;
+}
+
+bool ContractStorage::load(const std::string& contractAddress,
+                           const std::string& key,
+                           std::string& value) const {
+    auto contract = pending.find(contractAddress);
+    if (contract != pending.end()) {
+        auto it = contract->second.find(key);
+        if (it != contract->second.end()) {
+            value = it->second;
+            return true;
+        }
+    }
+
+    const std::string fullKey = storageKey(contractAddress, key);
+    if (valueCache.get(fullKey, value)) {
+        return true;
+    }
+    if (!store.get(fullKey, value)) {
+        return false;
+    }
+
+    valueCache.put(fullKey, value);
+    return true;
+}
+
+void ContractStorage::stage(const std::string& contractAddress,
+                            const std::string& key,
+                            const std::string& value) {
+    pending[contractAddress][key] = value;
+}
+
+std::string ContractStorage::getStateRoot(const std::string& contractAddress) const {
+    auto it = roots.find(contractAddress);
+    return it != roots.end() ? it->second : SparseMerkleTree::emptyRoot();
+}
+
+void ContractStorage::commitBlock() {
+    // A block without contract writes still gets its version, sharing the
+    // previous roots
+    const bool rootsChanged = !pending.empty();
+    if (rootsChanged) {
+        persistPending();
+    }
+
+    version++;
+    publishSnapshot(rootsChanged);
+}
+
+void ContractStorage::persistPending() {
+    batch.clear();
+    std::unordered_map<std::string, std::string> newRoots;
+
+    for (const auto& [contractAddress, writes] : pending) {
+        std::vector<std::pair<std::string, std::string>> updates(writes.begin(), writes.end());
+        for (const auto& [key, value] : writes) {
+            batch.emplace_back(storageKey(contractAddress, key), value);
+        }
+
+        // New tree nodes are appended to the batch by the node store
+        std::string root = tree.update(getStateRoot(contractAddress), updates);
+        batch.emplace_back(rootKey(contractAddress), root);
+        newRoots[contractAddress] = std::move(root);
+    }
+
+    store.writeBatch(batch, true);
+
+    // Publish only once the block is durable
+    for (const auto& [contractAddress, writes] : pending) {
+        for (const auto& [key, value] : writes) {
+            valueCache.put(storageKey(contractAddress, key), value);
+        }
+    }
+    for (auto& [contractAddress, root] : newRoots) {
+        auto contract = attached.find(contractAddress);
+        if (contract != attached.end()) {
+            contract->second->stateRoot = root;
+        }
+        roots[contractAddress] = std::move(root);
+    }
+
+    pending.clear();
+    batch.clear();
+}
+
+void ContractStorage::attach(SmartContract& contract) {
+    attached[contract.getAddress()] = &contract;
+    contract.stateRoot = getStateRoot(contract.getAddress());
+}
+
+void ContractStorage::detach(const SmartContract& contract) {
+    auto it = attached.find(contract.getAddress());
+    if (it != attached.end() && it->second == &contract) {
+        attached.erase(it);
+    }
+}
+
+void ContractStorage::publishSnapshot(bool rootsChanged) {
+    // Copy-on-write: the roots map is copied only for blocks that changed
+    // it, and never mutated after it is shared
+    if (rootsChanged) {
+        publishedRoots = std::make_shared<const std::unordered_map<std::string, std::string>>(roots);
+    }
+    auto snapshot = std::make_shared<const StateSnapshot>(*this, version, publishedRoots);
+
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    snapshots.push_back(std::move(snapshot));
+    if (snapshots.size() > SNAPSHOT_HISTORY) {
+        snapshots.pop_front();
+    }
+}
+
+std::shared_ptr<const StateSnapshot> ContractStorage::getSnapshot() const {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    return snapshots.back();
+}
+
+std::shared_ptr<const StateSnapshot> ContractStorage::getSnapshot(uint64_t versionIn) const {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    if (versionIn > snapshots.back()->getVersion() ||
+        versionIn < snapshots.front()->getVersion()) {
+        return nullptr;
+    }
+    return snapshots[versionIn - snapshots.front()->getVersion()];
+}
+
+bool ContractStorage::readAt(const std::string& root, const std::string& key, std::string& value) const {
+    return tree.get(root, key, value);
+}
+
+std::string StateSnapshot::getStateRoot(const std::string& contractAddress) const {
+    auto it = roots->find(contractAddress);
+    return it != roots->end() ? it->second : SparseMerkleTree::emptyRoot();
+}
+
+bool StateSnapshot::get(const std::string& contractAddress,
+                        const std::string& key,
+                        std::string& value) const {
+    auto it = roots->find(contractAddress);
+    if (it == roots->end()) {
+        return false;
+    }
+    return storage.readAt(it->second, key, value);
+}
+
+bool ContractStorage::LogNodeStore::getNode(const std::string& hash, std::string& encoded) {
+    if (owner.nodeCache.get(hash, encoded)) {
+        return true;
+    }
+    if (!owner.store.get(nodeKey(hash), encoded)) {
+        return false;
+    }
+
+    owner.nodeCache.put(hash, encoded);
+    return true;
+}
+
+void ContractStorage::LogNodeStore::putNode(const std::string& hash, const std::string& encoded) {
+    // Nodes are content-addressed, so one already on disk needs no new record
+    if (owner.store.contains(nodeKey(hash))) {
+        return;
+    }
+
+    owner.batch.emplace_back(nodeKey(hash), encoded);
+    owner.nodeCache.put(hash, encoded);
+}
+
+bool PersistentStorageAccess::load(const std::string& key, std::string& value) {
+    return storage.load(contractAddress, key, value);
+}
+
+void PersistentStorageAccess::store(const std::string& key, const std::string& value) {
+    storage.stage(contractAddress, key, value);
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "../utils/log_store.hpp"
+#include "../utils/cache_manager.hpp"
+#include "../crypto/sparse_merkle_tree.hpp"
+#include "contract_vm.hpp"
+
+class ContractStorage;
+class SmartContract;
+
+// Immutable view of contract storage as of one committed block. Tree nodes
+// are never modified, so a snapshot reads the roots it captured without
+// any coordination with the writer. Must not outlive its ContractStorage.
+class StateSnapshot {
+private:
+    const ContractStorage& storage;
+    uint64_t version;
+    std::shared_ptr<const std::unordered_map<std::string, std::string>> roots;
+
+public:
+    StateSnapshot(const ContractStorage& storageIn,
+                  uint64_t versionIn,
+                  std::shared_ptr<const std::unordered_map<std::string, std::string>> rootsIn)
+        : storage(storageIn), version(versionIn), roots(std::move(rootsIn)) {}
+
+    uint64_t getVersion() const { return version; }
+    std::string getStateRoot(const std::string& contractAddress) const;
+    bool get(const std::string& contractAddress, const std::string& key, std::string& value) const;
+};
+
+// Disk-backed contract storage with a per-contract state root. Values and
+// tree nodes share one append-only log; hot entries are kept in LRU caches.
+// Writes are staged during a block and committed together, updating each
+// touched contract's root along the changed paths only.
+class ContractStorage {
+public:
+    static constexpr size_t DEFAULT_CACHE_ENTRIES = 1 << 16;
+    static constexpr size_t SNAPSHOT_HISTORY = 64;
+
+private:
+    // Routes tree nodes through the node cache and the block's write batch
+    class LogNodeStore : public SparseMerkleTree::NodeStore {
+    private:
+        ContractStorage& owner;
+
+    public:
+        explicit LogNodeStore(ContractStorage& ownerIn) : owner(ownerIn) {}
+
+        bool getNode(const std::string& hash, std::string& encoded) override;
+        void putNode(const std::string& hash, const std::string& encoded) override;
+    };
+
+    LogStore store;
+    LogNodeStore nodeStore;
+    SparseMerkleTree tree;
+    mutable LRUCache<std::string, std::string> valueCache;
+    mutable LRUCache<std::string, std::string> nodeCache;
+
+    // contract address -> key -> value, applied at commitBlock
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> pending;
+    std::unordered_map<std::string, std::string> roots;
+    std::vector<std::pair<std::string, std::string>> batch;
+
+    // Contracts whose stateRoot follows their committed storage
+    std::unordered_map<std::string, SmartContract*> attached;
+
+    // Published after every commit; readers only ever copy the pointers
+    std::shared_ptr<const std::unordered_map<std::string, std::string>> publishedRoots;
+    std::deque<std::shared_ptr<const StateSnapshot>> snapshots;
+    uint64_t version;
+    mutable std::mutex snapshotMutex;
+
+public:
+    explicit ContractStorage(const std::string& pathIn,
+                             size_t cacheEntries = DEFAULT_CACHE_ENTRIES);
+
+    // Sees staged writes. Safe to call from several threads while no
+    // writes are being staged.
+    bool load(const std::string& contractAddress, const std::string& key, std::string& value) const;
+    void stage(const std::string& contractAddress, const std::string& key, const std::string& value);
+
+    // Persists staged writes and the updated roots in one durable append,
+    // then publishes a snapshot of the new state. Called once per block,
+    // with or without staged writes, so snapshot versions follow blocks.
+    void commitBlock();
+    bool hasPendingWrites() const { return !pending.empty(); }
+
+    // Keeps the contract's stateRoot equal to its committed root from now
+    // on. The contract must be detached before it is destroyed.
+    void attach(SmartContract& contract);
+    void detach(const SmartContract& contract);
+
+    // Root over the contract's committed storage; staged writes are not
+    // reflected until commitBlock
+    std::string getStateRoot(const std::string& contractAddress) const;
+
+    // Latest committed state, or one of the last SNAPSHOT_HISTORY versions
+    // (nullptr once it has been dropped). Safe from any thread.
+    std::shared_ptr<const StateSnapshot> getSnapshot() const;
+    std::shared_ptr<const StateSnapshot> getSnapshot(uint64_t versionIn) const;
+
+    static std::string storageKey(const std::string& contractAddress, const std::string& key);
+
+private:
+    friend class StateSnapshot;
+
+    bool readAt(const std::string& root, const std::string& key, std::string& value) const;
+    void persistPending();
+    void publishSnapshot(bool rootsChanged);
+    static std::string nodeKey(const std::string& hash);
+    static std::string rootKey(const std::string& contractAddress);
+};
+
+// VM view of one contract's storage; stores are staged for the block
+class PersistentStorageAccess : public ContractStorageAccess {
+private:
+    ContractStorage& storage;
+    std::string contractAddress;
+
+public:
+    PersistentStorageAccess(ContractStorage& storageIn, const std::string& contractAddressIn)
+        : storage(storageIn), contractAddress(contractAddressIn) {}
+
+    bool load(const std::string& key, std::string& value) override;
+    void store(const std::string& key, const std::string& value) override;
+};
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "contract_vm.hpp"
+#include "../utils/block_arena.hpp"
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <cstdint>
+
+namespace {
+    // Gas charged per instruction, indexed by OpCode. Storage access is
+    // priced well above arithmetic since it dominates real cost.
+    constexpr uint64_t GAS_COSTS[] = {
+        3,    // PUSH
+        2,    // POP
+        3,    // ADD
+        3,    // SUB
+        5,    // MUL
+        5,    // DIV
+        200,  // STORE
+        50,   // LOAD
+        700,  // CALL
+        0,    // RETURN
+        0     // HALT
+    };
+    
+    // Arithmetic wraps in two's complement so every node computes the same
+    // result; signed overflow would be undefined behaviour
+    inline int64_t wrap(uint64_t value) {
+        return static_cast<int64_t>(value);
+    }
+}
+
+bool MapStorageAccess::load(const std::string& key, std::string& value) {
+    auto it = storage.find(key);
+    if (it == storage.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+void MapStorageAccess::store(const std::string& key, const std::string& value) {
+    storage[key] = value;
+}
+
+bool BufferedStorageAccess::load(const std::string& key, std::string& value) {
+    auto it = writes.find(key);
+    if (it != writes.end()) {
+        value = it->second;
+        return true;
+    }
+    return underlying.load(key, value);
+}
+
+void BufferedStorageAccess::store(const std::string& key, const std::string& value) {
+    writes[key] = value;
+}
+
+void BufferedStorageAccess::commit() {
+    for (const auto& [key, value] : writes) {
+        underlying.store(key, value);
+    }
+    writes.clear();
+}
+
+VMValue ContractCompiler::parseImmediate(const std::string& token) {
+    // Integers become typed constants; anything else stays a string
+    if (!token.empty()) {
+        size_t start = (token[0] == '-' && token.size() > 1) ? 1 : 0;
+        bool numeric = token.find_first_not_of("0123456789", start) == std::string::npos;
+        if (numeric) {
+            try {
+                return static_cast<int64_t>(std::stoll(token));
+            } catch (const std::out_of_range&) {
+                // Too large for an integer, keep the text
+            }
+        }
+    }
+    return std::pmr::string(token);
+}
+
+std::shared_ptr<const CompiledContract> ContractCompiler::compile(const std::string& bytecode) {
+    static const std::unordered_map<std::string, OpCode> opcodes = {
+        {"PUSH", OpCode::PUSH}, {"POP", OpCode::POP},
+        {"ADD", OpCode::ADD}, {"SUB", OpCode::SUB},
+        {"MUL", OpCode::MUL}, {"DIV", OpCode::DIV},
+        {"STORE", OpCode::STORE}, {"LOAD", OpCode::LOAD},
+        {"CALL", OpCode::CALL}, {"RETURN", OpCode::RETURN}
+    };
+    
+    auto contract = std::make_shared<CompiledContract>();
+    contract->hasConstructor = false;
+    
+    std::istringstream tokens(bytecode);
+    std::string token;
+    while (tokens >> token) {
+        if (token == "CONSTRUCTOR") {
+            contract->hasConstructor = true;
+            continue;
+        }
+        
+        // Attached immediate, e.g. PUSH42
+        if (token.size() > 4 && token.compare(0, 4, "PUSH") == 0) {
+            contract->code.push_back({OpCode::PUSH, static_cast<uint32_t>(contract->constants.size())});
+            contract->constants.push_back(parseImmediate(token.substr(4)));
+            continue;
+        }
+        
+        auto it = opcodes.find(token);
+        if (it == opcodes.end()) {
+            throw std::invalid_argument("Unknown opcode: " + token);
+        }
+        
+        Instruction instruction{it->second, 0};
+        if (instruction.op == OpCode::PUSH) {
+            std::string immediate;
+            if (!(tokens >> immediate)) {
+                throw std::invalid_argument("PUSH without immediate");
+            }
+            instruction.operand = static_cast<uint32_t>(contract->constants.size());
+            contract->constants.push_back(parseImmediate(immediate));
+        }
+        contract->code.push_back(instruction);
+    }
+    
+    // Sentinel so the interpreter never bounds-checks the program counter
+    contract->code.push_back({OpCode::HALT, 0});
+    return contract;
+}
+
+ContractVM::ContractVM(ContractStorageAccess& storageIn)
+    : stack(BlockArena::current()),
+      storage(storageIn),
+      gasUsed(0) {
+    stack.reserve(64);
+}
+
+uint64_t ContractVM::gasCost(OpCode op) {
+    return GAS_COSTS[static_cast<uint8_t>(op)];
+}
+
+VMValue ContractVM::pop() {
+    if (stack.empty()) {
+        throw std::runtime_error("VM stack underflow");
+    }
+    VMValue value = std::move(stack.back());
+    stack.pop_back();
+    return value;
+}
+
+void ContractVM::push(int64_t value) {
+    if (stack.size() >= MAX_STACK_DEPTH) {
+        throw std::runtime_error("VM stack overflow");
+    }
+    stack.emplace_back(value);
+}
+
+void ContractVM::push(std::string_view text) {
+    if (stack.size() >= MAX_STACK_DEPTH) {
+        throw std::runtime_error("VM stack overflow");
+    }
+    // A variant element does not inherit the vector's allocator, so the
+    // string is given it explicitly
+    stack.emplace_back(std::in_place_type<std::pmr::string>, text, stack.get_allocator());
+}
+
+int64_t ContractVM::toInteger(const VMValue& value) {
+    if (const int64_t* integer = std::get_if<int64_t>(&value)) {
+        return *integer;
+    }
+    
+    // Values loaded from storage arrive as text
+    const std::string text(std::get<std::pmr::string>(value));
+    size_t parsed = 0;
+    int64_t result = 0;
+    try {
+        result = std::stoll(text, &parsed);
+    } catch (const std::exception&) {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != text.size()) {
+        throw std::runtime_error("VM operand is not an integer: " + text);
+    }
+    return result;
+}
+
+std::string ContractVM::toString(const VMValue& value) {
+    if (const int64_t* integer = std::get_if<int64_t>(&value)) {
+        return std::to_string(*integer);
+    }
+    return std::string(std::get<std::pmr::string>(value));
+}
+
+std::string ContractVM::execute(const CompiledContract& contract,
+                                const std::vector<std::string>& params,
+                                uint64_t gasLimit) {
+    stack.clear();
+    gasUsed = 0;
+    for (const auto& param : params) {
+        push(param);
+    }
+    
+    const Instruction* pc = contract.code.data();
+    
+#if defined(__GNUC__) || defined(__clang__)
+    // Computed-goto dispatch: one indirect jump per instruction, no switch
+    // bounds check. Order must match OpCode.
+    static void* const dispatchTable[] = {
+        &&op_push, &&op_pop, &&op_add, &&op_sub, &&op_mul, &&op_div,
+        &&op_store, &&op_load, &&op_call, &&op_return, &&op_halt
+    };
+    #define VM_CASE(name) op_##name
+    #define VM_DISPATCH() do { \
+            gasUsed += GAS_COSTS[static_cast<uint8_t>(pc->op)]; \
+            if (gasUsed > gasLimit) goto out_of_gas; \
+            goto *dispatchTable[static_cast<uint8_t>((pc++)->op)]; \
+        } while (0)
+    VM_DISPATCH();
+#else
+    #define VM_CASE(name) case_##name
+    #define VM_DISPATCH() goto dispatch
+    dispatch:
+    gasUsed += GAS_COSTS[static_cast<uint8_t>(pc->op)];
+    if (gasUsed > gasLimit) goto out_of_gas;
+    switch ((pc++)->op) {
+        case OpCode::PUSH: goto case_push;
+        case OpCode::POP: goto case_pop;
+        case OpCode::ADD: goto case_add;
+        case OpCode::SUB: goto case_sub;
+        case OpCode::MUL: goto case_mul;
+        case OpCode::DIV: goto case_div;
+        case OpCode::STORE: goto case_store;
+        case OpCode::LOAD: goto case_load;
+        case OpCode::CALL: goto case_call;
+        case OpCode::RETURN: goto case_return;
+        case OpCode::HALT: goto case_halt;
+    }
+#endif
+    
+    VM_CASE(push):
+        std::visit([this](const auto& constant) { push(constant); },
+                   contract.constants[(pc - 1)->operand]);
+        VM_DISPATCH();
+    
+    VM_CASE(pop):
+        pop();
+        VM_DISPATCH();
+    
+    VM_CASE(add): {
+        int64_t b = toInteger(pop());
+        int64_t a = toInteger(pop());
+        push(wrap(static_cast<uint64_t>(a) + static_cast<uint64_t>(b)));
+        VM_DISPATCH();
+    }
+    
+    VM_CASE(sub): {
+        int64_t b = toInteger(pop());
+        int64_t a = toInteger(pop());
+        push(wrap(static_cast<uint64_t>(a) - static_cast<uint64_t>(b)));
+        VM_DISPATCH();
+    }
+    
+    VM_CASE(mul): {
+        int64_t b = toInteger(pop());
+        int64_t a = toInteger(pop());
+        push(wrap(static_cast<uint64_t>(a) * static_cast<uint64_t>(b)));
+        VM_DISPATCH();
+    }
+    
+    VM_CASE(div): {
+        int64_t b = toInteger(pop());
+        int64_t a = toInteger(pop());
+        if (b == 0) {
+            throw std::runtime_error("VM division by zero");
+        }
+        if (a == INT64_MIN && b == -1) {
+            push(a);
+            VM_DISPATCH();
+        }
+        push(a / b);
+        VM_DISPATCH();
+    }
+    
+    // Computed goto does not run destructors, so locals that own memory
+    // go out of scope before the next dispatch
+    VM_CASE(store): {
+        VMValue value = pop();
+        VMValue key = pop();
+        storage.store(toString(key), toString(value));
+    }
+    VM_DISPATCH();
+    
+    VM_CASE(load): {
+        std::string value;
+        if (!storage.load(toString(pop()), value)) {
+            value.clear();
+        }
+        push(value);
+    }
+    VM_DISPATCH();
+    
+    VM_CASE(call):
+        // Cross-contract calls need an engine context the VM does not have
+        throw std::runtime_error("CALL is not supported by the contract VM");
+    
+    VM_CASE(return):
+    VM_CASE(halt):
+        return stack.empty() ? std::string() : toString(stack.back());
+    
+    out_of_gas:
+        gasUsed = gasLimit;
+        throw OutOfGasError();
+    
+    #undef VM_CASE
+    #undef VM_DISPATCH
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <variant>
+#include <unordered_map>
+#include <cstdint>
+#include <stdexcept>
+
+enum class OpCode : uint8_t {
+    PUSH,
+    POP,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    STORE,
+    LOAD,
+    CALL,
+    RETURN,
+    HALT    // Appended by the compiler, never written in source bytecode
+};
+
+// Stack values are typed so arithmetic never round-trips through text.
+// Strings carry their allocator, so text pushed by a running VM lives in
+// the same arena as the stack.
+using VMValue = std::variant<int64_t, std::pmr::string>;
+
+struct Instruction {
+    OpCode op;
+    uint32_t operand;   // Index into the constant pool for PUSH
+};
+
+// Contract code decoded once at deployment: a flat instruction array with
+// immediates pre-parsed into a constant pool
+struct CompiledContract {
+    std::vector<Instruction> code;
+    std::vector<VMValue> constants;
+    bool hasConstructor;
+};
+
+// Storage seen by a running contract
+class ContractStorageAccess {
+public:
+    virtual ~ContractStorageAccess() = default;
+    virtual bool load(const std::string& key, std::string& value) = 0;
+    virtual void store(const std::string& key, const std::string& value) = 0;
+};
+
+class MapStorageAccess : public ContractStorageAccess {
+private:
+    std::unordered_map<std::string, std::string>& storage;
+    
+public:
+    explicit MapStorageAccess(std::unordered_map<std::string, std::string>& storageIn)
+        : storage(storageIn) {}
+    
+    bool load(const std::string& key, std::string& value) override;
+    void store(const std::string& key, const std::string& value) override;
+};
+
+// Collects writes so a failed or out-of-gas call leaves storage untouched
+class BufferedStorageAccess : public ContractStorageAccess {
+private:
+    ContractStorageAccess& underlying;
+    std::unordered_map<std::string, std::string> writes;
+    
+public:
+    explicit BufferedStorageAccess(ContractStorageAccess& underlyingIn)
+        : underlying(underlyingIn) {}
+    
+    bool load(const std::string& key, std::string& value) override;
+    void store(const std::string& key, const std::string& value) override;
+    void commit();
+};
+
+class OutOfGasError : public std::runtime_error {
+public:
+    OutOfGasError() : std::runtime_error("Out of gas") {}
+};
+
+class ContractCompiler {
+public:
+    // Tokenizes whitespace-separated bytecode ("PUSH 5", or "PUSH5" as
+    // older contracts write it). CONSTRUCTOR marks the constructor section
+    // and emits no instruction. Throws std::invalid_argument on unknown
+    // opcodes or missing immediates.
+    static std::shared_ptr<const CompiledContract> compile(const std::string& bytecode);
+    
+private:
+    static VMValue parseImmediate(const std::string& token);
+};
+
+class ContractVM {
+private:
+    std::pmr::vector<VMValue> stack;    // Slots and text in the block arena during block execution
+    ContractStorageAccess& storage;
+    uint64_t gasUsed;
+    
+public:
+    static constexpr size_t MAX_STACK_DEPTH = 1024;
+    
+    explicit ContractVM(ContractStorageAccess& storageIn);
+    
+    // Runs the program with params pushed in order. Returns the value on
+    // top of the stack at RETURN or end of code, or an empty string.
+    // Each instruction is charged before it runs; exceeding gasLimit
+    // throws OutOfGasError with getGasUsed() == gasLimit.
+    std::string execute(const CompiledContract& contract,
+                        const std::vector<std::string>& params,
+                        uint64_t gasLimit);
+    
+    uint64_t getGasUsed() const { return gasUsed; }
+    static uint64_t gasCost(OpCode op);
+    
+private:
+    VMValue pop();
+    void push(int64_t value);
+    void push(std::string_view text);   // Copied into the stack's arena
+    static int64_t toInteger(const VMValue& value);
+    static std::string toString(const VMValue& value);
+};
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "message_index.hpp"
+#include "../crypto/stream_cipher.hpp"
+#include <algorithm>
+#include <mutex>
+#include <cstdio>
+#include <cinttypes>
+#include <stdexcept>
+
+namespace {
+    const std::string HEIGHT_KEY = "h";
+    const std::string RECORD_PREFIX = "m";
+    const std::string GROUP_PREFIX = "g";
+
+    bool before(const MessageLocation& location, uint64_t height, uint32_t offset) {
+        return location.blockHeight < height ||
+               (location.blockHeight == height && location.txOffset < offset);
+    }
+
+    bool parseRecordKey(const std::string& key, size_t prefixLength, uint64_t& height, uint32_t& offset) {
+        return std::sscanf(key.c_str() + prefixLength, "%16" SCNx64 "%8" SCNx32, &height, &offset) == 2;
+    }
+
+    std::string toHex(const std::string& bytes) {
+        static const char hexDigits[] = "0123456789abcdef";
+        std::string hex(2 * bytes.size(), '0');
+        for (size_t i = 0; i < bytes.size(); i++) {
+            const uint8_t byte = static_cast<uint8_t>(bytes[i]);
+            hex[2 * i] = hexDigits[byte >> 4];
+            hex[2 * i + 1] = hexDigits[byte & 0x0f];
+        }
+        return hex;
+    }
+
+    bool fromHex(const std::string& hex, std::string& bytes) {
+        auto nibble = [](char c) -> int {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            return -1;
+        };
+        if (hex.size() % 2 != 0) return false;
+        bytes.resize(hex.size() / 2);
+        for (size_t i = 0; i < bytes.size(); i++) {
+            const int high = nibble(hex[2 * i]);
+            const int low = nibble(hex[2 * i + 1]);
+            if (high < 0 || low < 0) return false;
+            bytes[i] = static_cast<char>((high << 4) | low);
+        }
+        return true;
+    }
+}
+
+MessageIndex::MessageIndex(const std::string& pathIn)
+    : store(pathIn),
+      nextHeight(0) {
+    load();
+}
+
+void MessageIndex::load() {
+    std::string value;
+    if (store.get(HEIGHT_KEY, value)) {
+        nextHeight = std::stoull(value);
+    }
+
+    for (const std::string& key : store.keysWithPrefix(RECORD_PREFIX)) {
+        uint64_t height;
+        uint32_t offset;
+        if (!parseRecordKey(key, RECORD_PREFIX.size(), height, offset) || !store.get(key, value)) {
+            continue;
+        }
+
+        size_t separator = value.find('\0');
+        if (separator == std::string::npos) continue;
+        inboxes[value.substr(0, separator)].push_back({value.substr(separator + 1), height, offset});
+    }
+
+    // Group records: txHash, hex header and comma-separated tags, split by
+    // NULs; tags are hex so never contain either separator
+    for (const std::string& key : store.keysWithPrefix(GROUP_PREFIX)) {
+        uint64_t height;
+        uint32_t offset;
+        if (!parseRecordKey(key, GROUP_PREFIX.size(), height, offset) || !store.get(key, value)) {
+            continue;
+        }
+
+        size_t first = value.find('\0');
+        size_t second = first == std::string::npos ? first : value.find('\0', first + 1);
+        GroupMessage message{{value.substr(0, first), height, offset}, "", {}};
+        if (second == std::string::npos ||
+            !fromHex(value.substr(first + 1, second - first - 1), message.header)) {
+            continue;
+        }
+        for (size_t begin = second + 1; begin < value.size();) {
+            size_t end = std::min(value.find(',', begin), value.size());
+            message.recipientTags.push_back(value.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        groupMessages.push_back(std::move(message));
+    }
+
+    // The log directory is unordered; restore (height, offset) order
+    for (auto& [recipient, inbox] : inboxes) {
+        std::sort(inbox.begin(), inbox.end(), [](const MessageLocation& a, const MessageLocation& b) {
+            return before(a, b.blockHeight, b.txOffset);
+        });
+    }
+    std::sort(groupMessages.begin(), groupMessages.end(), [](const GroupMessage& a, const GroupMessage& b) {
+        return before(a.location, b.location.blockHeight, b.location.txOffset);
+    });
+}
+
+std::string MessageIndex::recordKey(const std::string& prefix, uint64_t height, uint32_t offset) {
+    // Fixed width, so keys for one block never collide with another's
+    char key[32];
+    std::snprintf(key, sizeof(key), "%016" PRIx64 "%08" PRIx32, height, offset);
+    return prefix + key;
+}
+
+void MessageIndex::indexBlock(const Block& block, uint64_t height) {
+    // Held until nextHeight moves, so two calls for the same height cannot
+    // both pass the check and append the block twice. Readers only take
+    // indexMutex and are not held up by the write.
+    std::lock_guard<std::mutex> writeLock(writeMutex);
+    if (height < nextHeight) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> records;
+    std::vector<std::pair<std::string, MessageLocation>> added;
+    std::vector<GroupMessage> addedGroup;
+    const std::vector<Transaction>& transactions = block.getTransactions();
+
+    for (size_t i = 0; i < transactions.size(); i++) {
+        const Transaction& transaction = transactions[i];
+        if (transaction.getType() != TransactionType::MESSAGE || !transaction.hasMessage()) {
+            continue;
+        }
+
+        const uint32_t offset = static_cast<uint32_t>(i);
+        if (transaction.isGroupMessage()) {
+            GroupMessage message{{transaction.getHash(), height, offset},
+                                 transaction.getEncryptedMessage().substr(0, StreamCipher::HEADER_SIZE),
+                                 {}};
+            std::string value = transaction.getHash();
+            value += '\0';
+            value += toHex(message.header);
+            value += '\0';
+            for (const MessageKey& messageKey : transaction.getMessageKeys()) {
+                if (!message.recipientTags.empty()) value += ',';
+                value += messageKey.recipientTag;
+                message.recipientTags.push_back(messageKey.recipientTag);
+            }
+            records.emplace_back(recordKey(GROUP_PREFIX, height, offset), std::move(value));
+            addedGroup.push_back(std::move(message));
+            continue;
+        }
+
+        const std::string& recipient = transaction.getRecipient();
+        std::string value = recipient;
+        value += '\0';
+        value += transaction.getHash();
+        records.emplace_back(recordKey(RECORD_PREFIX, height, offset), std::move(value));
+        added.push_back({recipient, {transaction.getHash(), height, offset}});
+    }
+
+    // One durable append per block, including the new high-water mark
+    records.emplace_back(HEIGHT_KEY, std::to_string(height + 1));
+    store.writeBatch(records, true);
+
+    std::unique_lock<std::shared_mutex> lock(indexMutex);
+    for (auto& [recipient, location] : added) {
+        inboxes[recipient].push_back(std::move(location));
+    }
+    for (auto& message : addedGroup) {
+        groupMessages.push_back(std::move(message));
+    }
+    nextHeight = height + 1;
+}
+
+std::pair<uint64_t, uint32_t> MessageIndex::startPosition(const std::string& cursor, uint64_t sinceHeight) {
+    uint64_t cursorHeight = sinceHeight;
+    uint32_t cursorOffset = 0;
+    if (!cursor.empty()) {
+        if (!decodeCursor(cursor, cursorHeight, cursorOffset)) {
+            throw std::invalid_argument("Invalid message cursor");
+        }
+        // Resume just after the last message already returned
+        if (cursorOffset == UINT32_MAX) {
+            cursorHeight++;
+            cursorOffset = 0;
+        } else {
+            cursorOffset++;
+        }
+        if (cursorHeight < sinceHeight) {
+            cursorHeight = sinceHeight;
+            cursorOffset = 0;
+        }
+    }
+    return {cursorHeight, cursorOffset};
+}
+
+MessageIndex::Page MessageIndex::query(const std::string& recipient,
+                                       uint64_t sinceHeight,
+                                       const std::string& cursor,
+                                       size_t limit) const {
+    const auto [cursorHeight, cursorOffset] = startPosition(cursor, sinceHeight);
+
+    Page page;
+    std::shared_lock<std::shared_mutex> lock(indexMutex);
+
+    auto it = inboxes.find(recipient);
+    if (it == inboxes.end()) {
+        return page;
+    }
+
+    const std::vector<MessageLocation>& inbox = it->second;
+    auto begin = std::lower_bound(inbox.begin(), inbox.end(), std::make_pair(cursorHeight, cursorOffset),
+        [](const MessageLocation& location, const std::pair<uint64_t, uint32_t>& position) {
+            return before(location, position.first, position.second);
+        });
+    auto end = begin + std::min<size_t>(limit, inbox.end() - begin);
+
+    page.messages.assign(begin, end);
+    if (end != inbox.end() && !page.messages.empty()) {
+        page.nextCursor = encodeCursor(page.messages.back());
+    }
+    return page;
+}
+
+MessageIndex::Page MessageIndex::queryGroup(const std::string& publicKey,
+                                            uint64_t sinceHeight,
+                                            const std::string& cursor,
+                                            size_t limit) const {
+    const auto [cursorHeight, cursorOffset] = startPosition(cursor, sinceHeight);
+
+    Page page;
+    std::shared_lock<std::shared_mutex> lock(indexMutex);
+
+    auto it = std::lower_bound(groupMessages.begin(), groupMessages.end(), std::make_pair(cursorHeight, cursorOffset),
+        [](const GroupMessage& message, const std::pair<uint64_t, uint32_t>& position) {
+            return before(message.location, position.first, position.second);
+        });
+
+    // A full page only gets a cursor if another match follows it
+    for (; it != groupMessages.end(); ++it) {
+        const std::string tag = Transaction::groupRecipientTag(publicKey, it->header);
+        if (std::find(it->recipientTags.begin(), it->recipientTags.end(), tag) == it->recipientTags.end()) {
+            continue;
+        }
+        if (page.messages.size() == limit) {
+            if (!page.messages.empty()) {
+                page.nextCursor = encodeCursor(page.messages.back());
+            }
+            break;
+        }
+        page.messages.push_back(it->location);
+    }
+    return page;
+}
+
+size_t MessageIndex::getMessageCount(const std::string& recipient) const {
+    std::shared_lock<std::shared_mutex> lock(indexMutex);
+    auto it = inboxes.find(recipient);
+    return it != inboxes.end() ? it->second.size() : 0;
+}
+
+uint64_t MessageIndex::getIndexedHeight() const {
+    std::shared_lock<std::shared_mutex> lock(indexMutex);
+    return nextHeight;
+}
+
+std::string MessageIndex::encodeCursor(const MessageLocation& location) {
+    return std::to_string(location.blockHeight) + ":" + std::to_string(location.txOffset);
+}
+
+bool MessageIndex::decodeCursor(const std::string& cursor, uint64_t& height, uint32_t& offset) {
+    size_t separator = cursor.find(':');
+    if (separator == std::string::npos || separator == 0 || separator + 1 == cursor.size()) {
+        return false;
+    }
+
+    try {
+        size_t parsed = 0;
+        height = std::stoull(cursor.substr(0, separator), &parsed);
+        if (parsed != separator) return false;
+
+        unsigned long long value = std::stoull(cursor.substr(separator + 1), &parsed);
+        if (parsed != cursor.size() - separator - 1 || value > UINT32_MAX) return false;
+        offset = static_cast<uint32_t>(value);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+#include "block.hpp"
+#include "../utils/log_store.hpp"
+
+// Where an encrypted message sits on chain
+struct MessageLocation {
+    std::string txHash;
+    uint64_t blockHeight;
+    uint32_t txOffset;      // Index of the transaction within its block
+};
+
+// Secondary index from recipient address to the messages sent to it,
+// updated as blocks are committed and persisted in an append-only log so
+// inbox queries never scan the chain. Group messages have no recipient
+// address; they are kept with their recipient tags and matched by public
+// key instead.
+class MessageIndex {
+public:
+    static constexpr size_t DEFAULT_PAGE_SIZE = 50;
+
+    struct Page {
+        std::vector<MessageLocation> messages;
+        std::string nextCursor;     // Empty when there is nothing more
+    };
+
+private:
+    LogStore store;
+
+    // A group message's tags are bound to its stream header, so the header
+    // is kept to recompute a member's tag at one hash per message
+    struct GroupMessage {
+        MessageLocation location;
+        std::string header;
+        std::vector<std::string> recipientTags;
+    };
+
+    // Per recipient, in (height, offset) order since blocks arrive in order
+    std::unordered_map<std::string, std::vector<MessageLocation>> inboxes;
+    std::vector<GroupMessage> groupMessages;
+    uint64_t nextHeight;            // Lowest height not yet indexed
+    mutable std::shared_mutex indexMutex;
+    std::mutex writeMutex;          // One indexBlock at a time, check to publish
+
+public:
+    explicit MessageIndex(const std::string& pathIn);
+
+    // Indexes the block's messages; blocks already indexed are ignored, so
+    // replaying committed blocks after a restart is harmless
+    void indexBlock(const Block& block, uint64_t height);
+
+    // Messages for recipient at or above sinceHeight. Pass the previous
+    // page's nextCursor to continue where it stopped.
+    Page query(const std::string& recipient,
+               uint64_t sinceHeight,
+               const std::string& cursor = "",
+               size_t limit = DEFAULT_PAGE_SIZE) const;
+
+    // Group messages with a tag for publicKey, paged the same way
+    Page queryGroup(const std::string& publicKey,
+                    uint64_t sinceHeight,
+                    const std::string& cursor = "",
+                    size_t limit = DEFAULT_PAGE_SIZE) const;
+
+    size_t getMessageCount(const std::string& recipient) const;
+    uint64_t getIndexedHeight() const;
+
+private:
+    void load();
+    static std::string recordKey(const std::string& prefix, uint64_t height, uint32_t offset);
+    static std::pair<uint64_t, uint32_t> startPosition(const std::string& cursor, uint64_t sinceHeight);
+    static std::string encodeCursor(const MessageLocation& location);
+    static bool decodeCursor(const std::string& cursor, uint64_t& height, uint32_t& offset);
+};
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "optimistic_executor.hpp"
+#include "../utils/thread_pool.hpp"
+#include <mutex>
+
+MultiVersionStorage::ReadResult MultiVersionStorage::read(const std::string& key,
+                                                          size_t txIndex) const {
+    std::shared_lock<std::shared_mutex> lock(storageMutex);
+    
+    auto it = versions.find(key);
+    if (it != versions.end()) {
+        // Highest writer strictly below txIndex
+        auto version = it->second.lower_bound(txIndex);
+        if (version != it->second.begin()) {
+            --version;
+            return {true, version->first, version->second.incarnation, version->second.value};
+        }
+    }
+    
+    return {false, BASE_VERSION, 0, ""};
+}
+
+void MultiVersionStorage::publish(size_t txIndex, uint32_t incarnation,
+                                  const std::vector<std::string>& previousKeys,
+                                  const std::unordered_map<std::string, std::string>& writes) {
+    std::unique_lock<std::shared_mutex> lock(storageMutex);
+    
+    for (const auto& key : previousKeys) {
+        auto it = versions.find(key);
+        if (it != versions.end()) {
+            it->second.erase(txIndex);
+        }
+    }
+    
+    for (const auto& [key, value] : writes) {
+        versions[key][txIndex] = {incarnation, value};
+    }
+}
+
+namespace {
+    // Storage view of one speculative execution: own writes first, then
+    // earlier transactions' versions, then committed state. Every read
+    // that leaves the transaction is recorded for validation.
+    class SpeculativeStorageAccess : public ContractStorageAccess {
+    private:
+        const std::string& contractAddress;
+        size_t txIndex;
+        MultiVersionStorage& storage;
+        const OptimisticExecutor::BaseLoader& loadBase;
+        
+    public:
+        struct Read {
+            std::string key;
+            size_t writerIndex;
+            uint32_t incarnation;
+        };
+        
+        std::vector<Read> reads;
+        std::unordered_map<std::string, std::string> writes;
+        
+        SpeculativeStorageAccess(const std::string& contractAddressIn, size_t txIndexIn,
+                                 MultiVersionStorage& storageIn,
+                                 const OptimisticExecutor::BaseLoader& loadBaseIn)
+            : contractAddress(contractAddressIn),
+              txIndex(txIndexIn),
+              storage(storageIn),
+              loadBase(loadBaseIn) {}
+        
+        bool load(const std::string& key, std::string& value) override {
+            std::string fullKey = OptimisticExecutor::storageKey(contractAddress, key);
+            
+            auto own = writes.find(fullKey);
+            if (own != writes.end()) {
+                value = own->second;
+                return true;
+            }
+            
+            MultiVersionStorage::ReadResult result = storage.read(fullKey, txIndex);
+            reads.push_back({fullKey, result.writerIndex, result.incarnation});
+            
+            if (result.found) {
+                value = result.value;
+                return true;
+            }
+            return loadBase(fullKey, value);
+        }
+        
+        void store(const std::string& key, const std::string& value) override {
+            writes[OptimisticExecutor::storageKey(contractAddress, key)] = value;
+        }
+    };
+}
+
+std::string OptimisticExecutor::storageKey(const std::string& contractAddress,
+                                           const std::string& key) {
+    // Contract addresses never contain NUL, so the split is unambiguous
+    std::string fullKey;
+    fullKey.reserve(contractAddress.size() + 1 + key.size());
+    fullKey += contractAddress;
+    fullKey += '\0';
+    fullKey += key;
+    return fullKey;
+}
+
+void OptimisticExecutor::splitStorageKey(const std::string& storageKey,
+                                         std::string& contractAddress, std::string& key) {
+    size_t separator = storageKey.find('\0');
+    contractAddress = storageKey.substr(0, separator);
+    key = separator == std::string::npos ? std::string() : storageKey.substr(separator + 1);
+}
+
+void OptimisticExecutor::executeOne(size_t index, const Call& call, TxState& state,
+                                    MultiVersionStorage& storage, const BaseLoader& loadBase) {
+    SpeculativeStorageAccess access(call.contractAddress, index, storage, loadBase);
+    ContractVM vm(access);
+    
+    Result result{false, 0, "", {}};
+    try {
+        result.returnValue = vm.execute(*call.code, call.params, call.gasLimit);
+        result.success = true;
+    } catch (const std::exception&) {
+        // Failed calls keep their gas charge but publish no writes
+    }
+    result.gasUsed = vm.getGasUsed();
+    
+    if (result.success) {
+        result.writes = std::move(access.writes);
+    }
+    
+    state.incarnation++;
+    storage.publish(index, state.incarnation, state.writtenKeys, result.writes);
+    
+    state.writtenKeys.clear();
+    for (const auto& [key, value] : result.writes) {
+        state.writtenKeys.push_back(key);
+    }
+    
+    state.reads.clear();
+    for (auto& read : access.reads) {
+        state.reads.push_back({std::move(read.key), read.writerIndex, read.incarnation});
+    }
+    state.result = std::move(result);
+}
+
+bool OptimisticExecutor::validate(size_t index, const TxState& state,
+                                  const MultiVersionStorage& storage) const {
+    for (const auto& read : state.reads) {
+        MultiVersionStorage::ReadResult current = storage.read(read.key, index);
+        if (current.writerIndex != read.writerIndex || current.incarnation != read.incarnation) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<OptimisticExecutor::Result> OptimisticExecutor::execute(const std::vector<Call>& calls,
+                                                                    const BaseLoader& loadBase) {
+    MultiVersionStorage storage;
+    std::vector<TxState> states(calls.size());
+    
+    std::vector<size_t> toExecute(calls.size());
+    for (size_t i = 0; i < calls.size(); i++) {
+        toExecute[i] = i;
+    }
+    
+    size_t firstUncommitted = 0;
+    lastRoundCount = 0;
+    
+    while (firstUncommitted < calls.size()) {
+        lastRoundCount++;
+        
+        // Speculative execution of everything that needs (re)running
+        {
+            ThreadPool::TaskGroup tasks(ThreadPool::getInstance());
+            for (size_t index : toExecute) {
+                tasks.run([&, index]() {
+                    executeOne(index, calls[index], states[index], storage, loadBase);
+                });
+            }
+            tasks.wait();
+        }
+        
+        // Validate in block order. The prefix that validates is final:
+        // nothing before it will change again. Anything later that fails
+        // is re-executed next round; the lowest failing call always sees
+        // final inputs then, so every round makes progress.
+        toExecute.clear();
+        bool prefixValid = true;
+        for (size_t i = firstUncommitted; i < calls.size(); i++) {
+            if (validate(i, states[i], storage)) {
+                if (prefixValid) {
+                    firstUncommitted = i + 1;
+                }
+            } else {
+                prefixValid = false;
+                toExecute.push_back(i);
+            }
+        }
+    }
+    
+    std::vector<Result> results;
+    results.reserve(calls.size());
+    for (auto& state : states) {
+        results.push_back(std::move(state.result));
+    }
+    return results;
+}
\ No newline at end of file
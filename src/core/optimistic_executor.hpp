@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+#include "contract_vm.hpp"
+
+// Storage versions written by the transactions of one block, so a
+// transaction can read the latest value written by any earlier one
+class MultiVersionStorage {
+public:
+    static constexpr size_t BASE_VERSION = SIZE_MAX;
+    
+    struct ReadResult {
+        bool found;
+        size_t writerIndex;     // BASE_VERSION when read from committed state
+        uint32_t incarnation;
+        std::string value;
+    };
+    
+private:
+    struct Version {
+        uint32_t incarnation;
+        std::string value;
+    };
+    
+    // key -> writer transaction index -> value
+    std::unordered_map<std::string, std::map<size_t, Version>> versions;
+    mutable std::shared_mutex storageMutex;
+    
+public:
+    // Latest version written by a transaction before txIndex
+    ReadResult read(const std::string& key, size_t txIndex) const;
+    
+    // Replaces everything txIndex wrote in a previous incarnation
+    void publish(size_t txIndex, uint32_t incarnation,
+                 const std::vector<std::string>& previousKeys,
+                 const std::unordered_map<std::string, std::string>& writes);
+};
+
+// Block-STM style executor. Contract calls run speculatively on the
+// shared pool against multi-versioned storage; each round validates read
+// sets in block order and re-executes only the calls whose reads were
+// invalidated. The committed result equals serial execution in block order.
+class OptimisticExecutor {
+public:
+    // Committed contract storage; keys are storageKey(contract, key)
+    using BaseLoader = std::function<bool(const std::string& key, std::string& value)>;
+    
+    struct Call {
+        std::string contractAddress;
+        std::shared_ptr<const CompiledContract> code;
+        std::vector<std::string> params;
+        uint64_t gasLimit;
+    };
+    
+    struct Result {
+        bool success;
+        uint64_t gasUsed;
+        std::string returnValue;
+        std::unordered_map<std::string, std::string> writes;  // Storage-key form
+    };
+    
+    static std::string storageKey(const std::string& contractAddress, const std::string& key);
+    static void splitStorageKey(const std::string& storageKey,
+                                std::string& contractAddress, std::string& key);
+    
+    std::vector<Result> execute(const std::vector<Call>& calls, const BaseLoader& loadBase);
+    
+    // Rounds used by the last execute(), for diagnostics
+    size_t getLastRoundCount() const { return lastRoundCount; }
+    
+private:
+    struct ReadRecord {
+        std::string key;
+        size_t writerIndex;
+        uint32_t incarnation;
+    };
+    
+    struct TxState {
+        uint32_t incarnation = 0;
+        std::vector<ReadRecord> reads;
+        std::vector<std::string> writtenKeys;
+        Result result;
+    };
+    
+    size_t lastRoundCount = 0;
+    
+    void executeOne(size_t index, const Call& call, TxState& state,
+                    MultiVersionStorage& storage, const BaseLoader& loadBase);
+    bool validate(size_t index, const TxState& state, const MultiVersionStorage& storage) const;
+};
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include <vector>
 #include <unordered_map>
 #include "transaction.hpp"
+#include "../crypto/sparse_merkle_tree.hpp"
+
+class ContractStorage;
 
 class SmartContract {
 private:
@@ -10,6 +13,7 @@ private:
     std::string bytecode;
     std::string abi;
     std::unordered_map<std::string, std::string> state;
+    std::string stateRoot;      // Root of the committed storage, set by ContractStorage::commitBlock
     bool isActive;
     
     struct ContractFunction {
@@ -23,6 +27,14 @@ private:
     
 public:
     SmartContract(const std::string& bytecodeIn, const std::string& abiIn);
+    SmartContract(const std::string& addressIn, const std::string& bytecodeIn, const std::string& abiIn)
+        : address(addressIn),
+          bytecode(bytecodeIn),
+          abi(abiIn),
+          stateRoot(SparseMerkleTree::emptyRoot()),
+          isActive(true) {}
+    
+    const std::string& getAddress() const { return address; }
     
     // Contract execution
     bool execute(const Transaction& transaction);
@@ -38,5 +50,11 @@ public:
     
     // Validation
     bool validateTransaction(const Transaction& transaction) const;
-    bool verifyState() const;
+    // State is authenticated by its root, so verification is a comparison
+    // against the root committed in the block rather than a rescan
+    bool verifyState(const std::string& committedRoot) const { return stateRoot == committedRoot; }
+    const std::string& getStateRoot() const { return stateRoot; }
+    
+private:
+    friend class ContractStorage;
 }; 
\ No newline at end of file
@@ -1,8 +1,13 @@
 #include "smart_contract_engine.hpp"
 #include "../crypto/hash.hpp"
+#include "../utils/block_arena.hpp"
 #include <stdexcept>
+#include <algorithm>
 
-SmartContractEngine::SmartContractEngine() {
+SmartContractEngine::SmartContractEngine(const std::string& storagePath)
+    : contractStorage(storagePath),
+      blockGasLimit(DEFAULT_BLOCK_GAS_LIMIT),
+      blockGasUsed(0) {
     initializeStandardFunctions();
 }
 
@@ -25,7 +30,11 @@ void SmartContractEngine::initializeStandardFunctions() {
 
 std::string SmartContractEngine::deployContract(const std::string& bytecode, 
                                               const std::string& owner) {
-    if (!validateContract(bytecode)) {
+    // Compile once per distinct bytecode; every later call and every
+    // identical deployment reuses the decoded instructions
+    std::string codeHash;
+    std::shared_ptr<const CompiledContract> code = compileContract(bytecode, codeHash);
+    if (!code) {
         throw std::runtime_error("Invalid contract bytecode");
     }
     
@@ -34,7 +43,8 @@ std::string SmartContractEngine::deployContract(const std::string& bytecode,
     
     // Initialize contract state
     ContractState state;
-    state.bytecode = bytecode;
+    state.codeHash = codeHash;
+    state.code = code;
     state.owner = owner;
     state.isActive = true;
     
@@ -42,10 +52,11 @@ std::string SmartContractEngine::deployContract(const std::string& bytecode,
     return contractAddress;
 }
 
-bool SmartContractEngine::executeContract(const std::string& contractAddress,
-                                        const std::string& method,
-                                        const std::vector<std::string>& params,
-                                        const std::string& caller) {
+ExecutionReceipt SmartContractEngine::executeContract(const std::string& contractAddress,
+                                                     const std::string& method,
+                                                     const std::vector<std::string>& params,
+                                                     const std::string& caller,
+                                                     uint64_t gasLimit) {
     // Validate contract exists and is active
     if (!isContractActive(contractAddress)) {
         throw std::runtime_error("Contract not found or inactive");
@@ -56,66 +67,167 @@ bool SmartContractEngine::executeContract(const std::string& contractAddress,
         throw std::runtime_error("Invalid method call");
     }
     
+    // A call can never spend more than what is left in the block
+    const uint64_t available = std::min(gasLimit, getBlockGasRemaining());
+    ExecutionReceipt receipt{false, 0, ""};
+    
     try {
         // Execute standard function if it exists
         if (standardFunctions.count(method) > 0) {
+            if (available < STANDARD_FUNCTION_GAS) {
+                throw OutOfGasError();
+            }
             standardFunctions[method](params);
-            return true;
+            receipt.gasUsed = STANDARD_FUNCTION_GAS;
+        } else {
+            // Custom contract execution
+            ContractState& state = contracts[contractAddress];
+            
+            // Execute contract-specific logic on the compiled program
+            executeCustomMethod(contractAddress, state, method, params, caller, available, receipt);
         }
         
-        // Custom contract execution
-        ContractState& state = contracts[contractAddress];
-        
-        // Execute contract-specific logic
-        // This is where the VM would interpret the bytecode
-        executeCustomMethod(state, method, params, caller);
-        
-        return true;
+        receipt.success = true;
+    } catch (const OutOfGasError& e) {
+        receipt.gasUsed = available;
     } catch (const std::exception& e) {
-        // Log contract execution failure
-        return false;
+        // Log contract execution failure; gas used so far is still charged
     }
+    
+    blockGasUsed += receipt.gasUsed;
+    return receipt;
 }
 
-void SmartContractEngine::executeCustomMethod(ContractState& state,
-                                            const std::string& method,
-                                            const std::vector<std::string>& params,
-                                            const std::string& caller) {
-    // Virtual Machine implementation for custom methods
-    struct VM {
-        std::vector<std::string> stack;
-        std::unordered_map<std::string, std::string>& storage;
+ExecutionReceipt SmartContractEngine::executeTransaction(Transaction& transaction,
+                                                         const std::string& caller) {
+    ExecutionReceipt receipt = executeContract(transaction.getContractAddress(),
+                                               transaction.getMethodSignature(),
+                                               transaction.getParameters(),
+                                               caller,
+                                               transaction.getGasLimit());
+    transaction.setGasUsed(receipt.gasUsed);
+    return receipt;
+}
+
+std::vector<ExecutionReceipt> SmartContractEngine::executeBlock(std::vector<Transaction>& transactions) {
+    // VM stacks of every execution and re-execution live in this arena
+    BlockArena arena;
+    BlockArena::Scope arenaScope(arena);
+    
+    std::vector<ExecutionReceipt> receipts(transactions.size(), ExecutionReceipt{true, 0, ""});
+    std::vector<OptimisticExecutor::Call> calls;
+    std::vector<size_t> callTransactions;
+    
+    for (size_t i = 0; i < transactions.size(); i++) {
+        const Transaction& transaction = transactions[i];
+        if (transaction.getContractAddress().empty()) continue;
         
-        VM(std::unordered_map<std::string, std::string>& contractStorage) 
-            : storage(contractStorage) {}
+        const std::string& method = transaction.getMethodSignature();
+        const std::vector<std::string>& params = transaction.getParameters();
         
-        void execute(const std::string& bytecode) {
-            // Basic VM operations
-            std::vector<std::string> operations = parseBytecode(bytecode);
-            
-            for (const auto& op : operations) {
-                if (op.substr(0, 4) == "PUSH") {
-                    stack.push_back(op.substr(4));
-                } else if (op == "ADD") {
-                    // Implementation of ADD operation
-                } else if (op == "STORE") {
-                    // Implementation of STORE operation
-                } else if (op == "LOAD") {
-                    // Implementation of LOAD operation
-                }
+        if (!isContractActive(transaction.getContractAddress()) ||
+            !validateMethodCall(method, params)) {
+            receipts[i] = {false, 0, ""};
+            continue;
+        }
+        
+        // Standard functions touch no contract storage, so they cannot
+        // conflict and are settled here
+        auto standard = standardFunctions.find(method);
+        if (standard != standardFunctions.end()) {
+            if (transaction.getGasLimit() < STANDARD_FUNCTION_GAS) {
+                receipts[i] = {false, transaction.getGasLimit(), ""};
+                continue;
+            }
+            try {
+                standard->second(params);
+                receipts[i] = {true, STANDARD_FUNCTION_GAS, ""};
+            } catch (const std::exception& e) {
+                receipts[i] = {false, 0, ""};
             }
+            continue;
         }
         
-        std::vector<std::string> parseBytecode(const std::string& bytecode) {
-            // Parse bytecode into operations
-            std::vector<std::string> ops;
-            // Implementation of bytecode parsing
-            return ops;
+        calls.push_back({transaction.getContractAddress(),
+                         contracts.at(transaction.getContractAddress()).code,
+                         params,
+                         transaction.getGasLimit()});
+        callTransactions.push_back(i);
+    }
+    
+    // The contracts map is not modified until every call has finished
+    OptimisticExecutor executor;
+    std::vector<OptimisticExecutor::Result> results = executor.execute(calls,
+        [this](const std::string& storageKey, std::string& value) {
+            std::string contractAddress;
+            std::string key;
+            OptimisticExecutor::splitStorageKey(storageKey, contractAddress, key);
+            return contractStorage.load(contractAddress, key, value);
+        });
+    
+    std::vector<const OptimisticExecutor::Result*> resultOf(transactions.size(), nullptr);
+    for (size_t c = 0; c < calls.size(); c++) {
+        const OptimisticExecutor::Result& result = results[c];
+        receipts[callTransactions[c]] = {result.success, result.gasUsed, result.returnValue};
+        resultOf[callTransactions[c]] = &result;
+    }
+    
+    // Settle in block order against the block gas budget. A call that used
+    // more than was left would have run out of gas at that point when run
+    // serially; once the budget is gone only calls that used no gas (and
+    // therefore touched no storage) can still succeed.
+    for (size_t i = 0; i < transactions.size(); i++) {
+        if (transactions[i].getContractAddress().empty()) continue;
+        
+        ExecutionReceipt& receipt = receipts[i];
+        uint64_t remaining = getBlockGasRemaining();
+        
+        if (receipt.gasUsed > remaining) {
+            receipt = {false, remaining, ""};
+        } else if (receipt.success && resultOf[i]) {
+            for (const auto& [storageKey, value] : resultOf[i]->writes) {
+                std::string contractAddress;
+                std::string key;
+                OptimisticExecutor::splitStorageKey(storageKey, contractAddress, key);
+                contractStorage.stage(contractAddress, key, value);
+            }
         }
-    };
+        
+        blockGasUsed += receipt.gasUsed;
+        transactions[i].setGasUsed(receipt.gasUsed);
+    }
+    
+    commitBlockState();
+    return receipts;
+}
+
+void SmartContractEngine::beginBlock(uint64_t blockGasLimitIn) {
+    blockGasLimit = blockGasLimitIn;
+    blockGasUsed = 0;
+}
+
+void SmartContractEngine::executeCustomMethod(const std::string& contractAddress,
+                                            ContractState& state,
+                                            const std::string& method,
+                                            const std::vector<std::string>& params,
+                                            const std::string& caller,
+                                            uint64_t gasLimit,
+                                            ExecutionReceipt& receipt) {
+    // Methods share one program for now; params are pushed in order.
+    // Writes are buffered so a failed call leaves storage untouched.
+    PersistentStorageAccess storage(contractStorage, contractAddress);
+    BufferedStorageAccess buffered(storage);
+    ContractVM vm(buffered);
+    
+    try {
+        receipt.returnValue = vm.execute(*state.code, params, gasLimit);
+    } catch (...) {
+        receipt.gasUsed = vm.getGasUsed();
+        throw;
+    }
     
-    VM vm(state.storage);
-    vm.execute(state.bytecode);
+    receipt.gasUsed = vm.getGasUsed();
+    buffered.commit();
 }
 
 bool SmartContractEngine::updateContractState(const std::string& contractAddress,
@@ -125,7 +237,7 @@ bool SmartContractEngine::updateContractState(const std::string& contractAddress
         return false;
     }
     
-    contracts[contractAddress].storage[key] = value;
+    contractStorage.stage(contractAddress, key, value);
     return true;
 }
 
@@ -135,42 +247,86 @@ std::string SmartContractEngine::getContractState(const std::string& contractAdd
         throw std::runtime_error("Contract not found or inactive");
     }
     
-    const auto& state = contracts.at(contractAddress);
-    auto it = state.storage.find(key);
-    if (it == state.storage.end()) {
+    std::string value;
+    if (!contractStorage.load(contractAddress, key, value)) {
         throw std::runtime_error("State key not found");
     }
     
-    return it->second;
+    return value;
 }
 
-bool SmartContractEngine::validateContract(const std::string& bytecode) const {
+void SmartContractEngine::commitBlockState() {
+    contractStorage.commitBlock();
+}
+
+std::string SmartContractEngine::getStateRoot(const std::string& contractAddress) const {
+    return contractStorage.getStateRoot(contractAddress);
+}
+
+bool SmartContractEngine::verifyContractState(const std::string& contractAddress,
+                                              const std::string& expectedRoot) const {
+    // The root is maintained incrementally, so verification never rescans storage
+    return contractStorage.getStateRoot(contractAddress) == expectedRoot;
+}
+
+std::shared_ptr<const StateSnapshot> SmartContractEngine::getStateSnapshot() const {
+    return contractStorage.getSnapshot();
+}
+
+std::shared_ptr<const StateSnapshot> SmartContractEngine::getStateSnapshot(uint64_t version) const {
+    return contractStorage.getSnapshot(version);
+}
+
+std::string SmartContractEngine::queryContractState(const std::string& contractAddress,
+                                                    const std::string& key) const {
+    // Deliberately does not consult the contracts map, which belongs to
+    // the block-processing thread
+    std::string value;
+    if (!contractStorage.getSnapshot()->get(contractAddress, key, value)) {
+        throw std::runtime_error("State key not found");
+    }
+    
+    return value;
+}
+
+std::shared_ptr<const CompiledContract> SmartContractEngine::compileContract(
+    const std::string& bytecode, std::string& codeHash) {
     // Basic bytecode validation
     if (bytecode.empty()) {
-        return false;
+        return nullptr;
     }
     
-    // Check for required functions
-    bool hasConstructor = bytecode.find("CONSTRUCTOR") != std::string::npos;
-    bool hasValidOpcodes = validateOpcodes(bytecode);
-    
-    return hasConstructor && hasValidOpcodes;
+    // The cache only admits code with a constructor
+    try {
+        return codeCache.getOrCompile(bytecode, codeHash);
+    } catch (const std::invalid_argument&) {
+        return nullptr;
+    }
 }
 
-bool SmartContractEngine::validateOpcodes(const std::string& bytecode) const {
-    // Define valid opcodes
-    static const std::unordered_set<std::string> validOpcodes = {
-        "PUSH", "POP", "ADD", "SUB", "MUL", "DIV",
-        "STORE", "LOAD", "CALL", "RETURN"
-    };
+bool SmartContractEngine::validateContract(const std::string& bytecode) const {
+    // Already-deployed code was validated when it entered the cache
+    if (codeCache.get(ContractCodeCache::hashBytecode(bytecode))) {
+        return true;
+    }
     
-    // Parse and validate each opcode
-    std::vector<std::string> ops = parseOpcodes(bytecode);
-    for (const auto& op : ops) {
-        if (validOpcodes.find(op) == validOpcodes.end()) {
-            return false;
-        }
+    if (bytecode.empty()) {
+        return false;
     }
     
-    return true;
-} 
\ No newline at end of file
+    try {
+        return ContractCompiler::compile(bytecode)->hasConstructor;
+    } catch (const std::invalid_argument&) {
+        return false;
+    }
+}
+
+bool SmartContractEngine::validateOpcodes(const std::string& bytecode) const {
+    // The compiler rejects any token that is not a known opcode
+    try {
+        ContractCompiler::compile(bytecode);
+        return true;
+    } catch (const std::invalid_argument&) {
+        return false;
+    }
+}
\ No newline at end of file
@@ -3,31 +3,76 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 #include "transaction.hpp"
+#include "contract_vm.hpp"
+#include "contract_code_cache.hpp"
+#include "optimistic_executor.hpp"
+#include "contract_storage.hpp"
+
+// Outcome of a metered contract call
+struct ExecutionReceipt {
+    bool success;
+    uint64_t gasUsed;
+    std::string returnValue;
+};
 
 class SmartContractEngine {
+public:
+    static constexpr uint64_t DEFAULT_CALL_GAS_LIMIT = Transaction::DEFAULT_CALL_GAS_LIMIT;
+    static constexpr uint64_t DEFAULT_BLOCK_GAS_LIMIT = 30000000;
+    static constexpr uint64_t STANDARD_FUNCTION_GAS = 5000;
+    
 private:
     struct ContractState {
-        std::string bytecode;
-        std::unordered_map<std::string, std::string> storage;
+        std::string codeHash;                          // Key into codeCache
+        std::shared_ptr<const CompiledContract> code;  // Shared with codeCache
         std::string owner;
         bool isActive;
     };
     
     std::unordered_map<std::string, ContractState> contracts;
+    ContractStorage contractStorage;
+    ContractCodeCache codeCache;
     std::unordered_map<std::string, std::function<void(const std::vector<std::string>&)>> standardFunctions;
     
+    // Gas budget of the block currently being executed
+    uint64_t blockGasLimit;
+    uint64_t blockGasUsed;
+    
 public:
-    SmartContractEngine();
+    // Engines sharing a storage log would append into and replay each
+    // other's state, so every engine gets its own path; nodes use
+    // nodeId + "_contract_state.log"
+    explicit SmartContractEngine(const std::string& storagePath);
     
     // Contract deployment and execution
     std::string deployContract(const std::string& bytecode, 
                              const std::string& owner);
     
-    bool executeContract(const std::string& contractAddress,
-                        const std::string& method,
-                        const std::vector<std::string>& params,
-                        const std::string& caller);
+    // Runs a call with at most gasLimit gas, further capped by what is left
+    // of the block budget. Failed calls still consume the gas they used.
+    ExecutionReceipt executeContract(const std::string& contractAddress,
+                                     const std::string& method,
+                                     const std::vector<std::string>& params,
+                                     const std::string& caller,
+                                     uint64_t gasLimit = DEFAULT_CALL_GAS_LIMIT);
+    
+    // Executes a contract-call transaction under its own gas limit and
+    // records the gas used on it for fee settlement
+    ExecutionReceipt executeTransaction(Transaction& transaction, const std::string& caller);
+    
+    // Executes every contract call of a block optimistically in parallel.
+    // Storage effects and receipts match running the calls one by one in
+    // block order. Returns one receipt per transaction; non-contract
+    // transactions get an empty successful receipt. The block's storage
+    // writes are committed before returning.
+    std::vector<ExecutionReceipt> executeBlock(std::vector<Transaction>& transactions);
+    
+    // Block gas accounting
+    void beginBlock(uint64_t blockGasLimitIn = DEFAULT_BLOCK_GAS_LIMIT);
+    uint64_t getBlockGasUsed() const { return blockGasUsed; }
+    uint64_t getBlockGasRemaining() const { return blockGasLimit - blockGasUsed; }
     
     // State management
     bool updateContractState(const std::string& contractAddress,
@@ -37,6 +82,21 @@ public:
     std::string getContractState(const std::string& contractAddress,
                                 const std::string& key) const;
     
+    // Persists storage written since the last commit and advances the
+    // state roots of the contracts it touched
+    void commitBlockState();
+    std::string getStateRoot(const std::string& contractAddress) const;
+    bool verifyContractState(const std::string& contractAddress,
+                             const std::string& expectedRoot) const;
+    
+    // Read-only queries, served from immutable per-block snapshots. Safe
+    // from any number of threads while a block is executed or committed;
+    // they never observe a partially applied block.
+    std::shared_ptr<const StateSnapshot> getStateSnapshot() const;
+    std::shared_ptr<const StateSnapshot> getStateSnapshot(uint64_t version) const;
+    std::string queryContractState(const std::string& contractAddress,
+                                   const std::string& key) const;
+    
     // Contract validation
     bool validateContract(const std::string& bytecode) const;
     bool isContractActive(const std::string& contractAddress) const;
@@ -45,4 +105,14 @@ private:
     void initializeStandardFunctions();
     bool validateMethodCall(const std::string& method,
                           const std::vector<std::string>& params) const;
+    std::shared_ptr<const CompiledContract> compileContract(const std::string& bytecode,
+                                                            std::string& codeHash);
+    bool validateOpcodes(const std::string& bytecode) const;
+    void executeCustomMethod(const std::string& contractAddress,
+                             ContractState& state,
+                             const std::string& method,
+                             const std::vector<std::string>& params,
+                             const std::string& caller,
+                             uint64_t gasLimit,
+                             ExecutionReceipt& receipt);
 }; 
\ No newline at end of file
@@ -1,12 +1,156 @@
 #include "transaction.hpp"
 #include "../crypto/encryption.hpp"
-#include <sstream>
+#include "../crypto/signature_cache.hpp"
+#include "../crypto/stream_cipher.hpp"
+#include "../utils/block_arena.hpp"
+#include <charconv>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
 #include <stdexcept>
+#include <algorithm>
+#include <openssl/rand.h>
+
+namespace {
+    template<typename T>
+    void appendDecimal(std::pmr::string& buffer, T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+    }
+    
+    // Same text as streaming a double with default formatting
+    void appendDecimal(std::pmr::string& buffer, double value) {
+        char digits[32];
+        int length = std::snprintf(digits, sizeof(digits), "%g", value);
+        buffer.append(digits, length);
+    }
+    
+    // Wire encoding: little-endian fixed-width integers and strings
+    // prefixed with a 32-bit length
+    void putU32(std::string& out, uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out += static_cast<char>(value >> shift);
+        }
+    }
+    
+    void putU64(std::string& out, uint64_t value) {
+        for (int shift = 0; shift < 64; shift += 8) {
+            out += static_cast<char>(value >> shift);
+        }
+    }
+    
+    void putDouble(std::string& out, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        putU64(out, bits);
+    }
+    
+    void putString(std::string& out, const std::string& value) {
+        putU32(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+    
+    class WireReader {
+    private:
+        const std::string& data;
+        size_t position;
+        
+        void require(size_t length) const {
+            if (data.size() - position < length) {
+                throw std::runtime_error("Truncated transaction");
+            }
+        }
+        
+    public:
+        explicit WireReader(const std::string& dataIn) : data(dataIn), position(0) {}
+        
+        uint32_t u32() {
+            require(4);
+            uint32_t value = 0;
+            for (int i = 0; i < 4; i++) {
+                value |= static_cast<uint32_t>(static_cast<uint8_t>(data[position++])) << (8 * i);
+            }
+            return value;
+        }
+        
+        uint64_t u64() {
+            require(8);
+            uint64_t value = 0;
+            for (int i = 0; i < 8; i++) {
+                value |= static_cast<uint64_t>(static_cast<uint8_t>(data[position++])) << (8 * i);
+            }
+            return value;
+        }
+        
+        bool flag() {
+            require(1);
+            return data[position++] != 0;
+        }
+        
+        double real() {
+            uint64_t bits = u64();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        
+        std::string string() {
+            uint32_t length = u32();
+            require(length);
+            std::string value = data.substr(position, length);
+            position += length;
+            return value;
+        }
+        
+        bool atEnd() const { return position == data.size(); }
+    };
+    
+    constexpr size_t RECIPIENT_TAG_LENGTH = 16;
+    
+    // Signature cache index of the transaction signature, past any input
+    constexpr uint32_t TRANSACTION_SIGNATURE_INDEX = UINT32_MAX;
+    
+    // Checks one signature over message, consulting the shared cache first
+    bool verifyCached(const std::string& message,
+                      uint32_t index,
+                      const std::string& publicKey,
+                      const std::string& signature) {
+        SignatureCache& signatureCache = SignatureCache::getInstance();
+        std::string cacheEntry = signatureCache.computeEntry(message, index, publicKey, signature);
+        if (signatureCache.contains(cacheEntry)) {
+            return true;
+        }
+        
+        // Verified in place rather than copied into a byte vector
+        if (!Encryption::verify(message,
+                                reinterpret_cast<const uint8_t*>(signature.data()),
+                                signature.size(),
+                                publicKey)) {
+            return false;
+        }
+        
+        signatureCache.insert(cacheEntry);
+        return true;
+    }
+}
+
+std::string Transaction::groupRecipientTag(const std::string& publicKey, const std::string& encryptedMessage) {
+    // Binds the recipient's public key to this message's stream header, so
+    // a recipient matches with one hash and no key operations
+    std::string preimage = publicKey;
+    preimage.append(encryptedMessage, 0, StreamCipher::HEADER_SIZE);
+    return SHA256::hash(preimage).substr(0, RECIPIENT_TAG_LENGTH);
+}
 
 Transaction::Transaction(TransactionType type)
     : status(TransactionStatus::PENDING),
       timestamp(std::time(nullptr)),
-      lockTime(0) {
+      lockTime(0),
+      gasLimit(0),
+      gasPrice(0),
+      gasUsed(0) {
     hash = calculateHash();
 }
 
@@ -14,49 +158,208 @@ Transaction::Transaction(const std::string& sender,
                        const std::string& recipient, 
                        TransactionType type)
     : Transaction(type) {
-    // Create basic output
+    // Create basic output; addOutput rehashes, so the hash covers it
     TransactionOutput output;
     output.recipient = recipient;
+    output.amount = 0;
     output.isSpent = false;
+    addOutput(output);
+}
+
+void Transaction::addInput(const TransactionInput& input) {
+    inputs.push_back(input);
+    hash = calculateHash();
+}
+
+void Transaction::addOutput(const TransactionOutput& output) {
     outputs.push_back(output);
+    hash = calculateHash();
 }
 
 std::string Transaction::calculateHash() const {
-    std::stringstream ss;
-    ss << timestamp;
+    // Built in the block arena when there is one, since verification
+    // recomputes this for every transaction of a block
+    std::pmr::string buffer(BlockArena::current());
+    buffer.reserve(32 + (inputs.size() + outputs.size()) * 64 +
+                   encryptedMessage.size() + messageRecipient.size() +
+                   messageKeys.size() * 160);
+    appendDecimal(buffer, timestamp);
     
     for (const auto& input : inputs) {
-        ss << input.getHash();
+        buffer += input.getHash();
     }
     
     for (const auto& output : outputs) {
-        ss << output.getHash();
+        buffer += output.getHash();
     }
     
-    ss << lockTime << static_cast<int>(status);
+    appendDecimal(buffer, lockTime);
+    appendDecimal(buffer, static_cast<int>(status));
     
     if (!encryptedMessage.empty()) {
-        ss << encryptedMessage << messageRecipient;
+        buffer += encryptedMessage;
+        buffer += messageRecipient;
+        for (const auto& messageKey : messageKeys) {
+            buffer += messageKey.recipientTag;
+            buffer += messageKey.wrappedKey;
+        }
     }
     
     if (!contractAddress.empty()) {
-        ss << contractAddress << methodSignature;
+        buffer += contractAddress;
+        buffer += methodSignature;
         for (const auto& param : parameters) {
-            ss << param;
+            buffer += param;
         }
+        appendDecimal(buffer, gasLimit);
+        appendDecimal(buffer, gasPrice);
+    }
+    
+    return SHA256::doubleHash(buffer.data(), buffer.size());
+}
+
+size_t Transaction::getSerializedSize() const {
+    // lockTime, timestamp, status and type, then the variable fields
+    size_t size = 4 + 8 + 1 + 1;
+    for (const auto& input : inputs) {
+        size += input.previousTxHash.size() + 4 + input.signature.size() + input.publicKey.size();
+    }
+    for (const auto& output : outputs) {
+        size += output.recipient.size() + 8 + output.scriptPubKey.size();
+    }
+    size += signature.size() + signerPublicKey.size();
+    size += encryptedMessage.size() + messageRecipient.size();
+    for (const auto& messageKey : messageKeys) {
+        size += messageKey.recipientTag.size() + messageKey.wrappedKey.size();
+    }
+    if (!contractAddress.empty()) {
+        size += contractAddress.size() + methodSignature.size() + 8 + 8;
+        for (const auto& param : parameters) {
+            size += param.size();
+        }
+    }
+    return size;
+}
+
+std::string Transaction::serialize() const {
+    std::string out;
+    out.reserve(getSerializedSize() + 64);
+    
+    putU64(out, static_cast<uint64_t>(timestamp));
+    putU32(out, lockTime);
+    putU32(out, static_cast<uint32_t>(status));
+    
+    putU32(out, static_cast<uint32_t>(inputs.size()));
+    for (const auto& input : inputs) {
+        putString(out, input.previousTxHash);
+        putU32(out, input.outputIndex);
+        putString(out, input.signature);
+        putString(out, input.publicKey);
+    }
+    putU32(out, static_cast<uint32_t>(outputs.size()));
+    for (const auto& output : outputs) {
+        putString(out, output.recipient);
+        putDouble(out, output.amount);
+        putString(out, output.scriptPubKey);
+        out += static_cast<char>(output.isSpent ? 1 : 0);
+    }
+    
+    putString(out, encryptedMessage);
+    putString(out, messageRecipient);
+    putU32(out, static_cast<uint32_t>(messageKeys.size()));
+    for (const auto& messageKey : messageKeys) {
+        putString(out, messageKey.recipientTag);
+        putString(out, messageKey.wrappedKey);
+    }
+    
+    putString(out, contractAddress);
+    putString(out, methodSignature);
+    putU32(out, static_cast<uint32_t>(parameters.size()));
+    for (const auto& param : parameters) {
+        putString(out, param);
+    }
+    putU64(out, gasLimit);
+    putDouble(out, gasPrice);
+    putU64(out, gasUsed);
+    
+    putString(out, signature);
+    putString(out, signerPublicKey);
+    return out;
+}
+
+Transaction Transaction::deserialize(const std::string& data) {
+    WireReader reader(data);
+    Transaction tx(TransactionType::FINANCIAL);
+    
+    tx.timestamp = static_cast<time_t>(reader.u64());
+    tx.lockTime = reader.u32();
+    tx.status = static_cast<TransactionStatus>(reader.u32());
+    
+    // Counts are not trusted for reserve(); every element reads at least
+    // one length prefix, so a bogus count runs out of data instead
+    for (uint32_t count = reader.u32(); count > 0; count--) {
+        TransactionInput input;
+        input.previousTxHash = reader.string();
+        input.outputIndex = reader.u32();
+        input.signature = reader.string();
+        input.publicKey = reader.string();
+        tx.inputs.push_back(std::move(input));
+    }
+    for (uint32_t count = reader.u32(); count > 0; count--) {
+        TransactionOutput output;
+        output.recipient = reader.string();
+        output.amount = reader.real();
+        output.scriptPubKey = reader.string();
+        output.isSpent = reader.flag();
+        tx.outputs.push_back(std::move(output));
     }
     
-    return SHA256::doubleHash(ss.str());
+    tx.encryptedMessage = reader.string();
+    tx.messageRecipient = reader.string();
+    for (uint32_t count = reader.u32(); count > 0; count--) {
+        MessageKey messageKey;
+        messageKey.recipientTag = reader.string();
+        messageKey.wrappedKey = reader.string();
+        tx.messageKeys.push_back(std::move(messageKey));
+    }
+    
+    tx.contractAddress = reader.string();
+    tx.methodSignature = reader.string();
+    for (uint32_t count = reader.u32(); count > 0; count--) {
+        tx.parameters.push_back(reader.string());
+    }
+    tx.gasLimit = reader.u64();
+    tx.gasPrice = reader.real();
+    tx.gasUsed = reader.u64();
+    
+    tx.signature = reader.string();
+    tx.signerPublicKey = reader.string();
+    if (!reader.atEnd()) {
+        throw std::runtime_error("Trailing data after transaction");
+    }
+    
+    tx.hash = tx.calculateHash();
+    return tx;
 }
 
 bool Transaction::sign(const std::string& privateKey) {
+    try {
+        return sign(SigningKey(privateKey));
+    } catch (const std::exception& e) {
+        return false;
+    }
+}
+
+bool Transaction::sign(const SigningKey& key) {
     try {
         std::string message = calculateHash();
-        std::vector<uint8_t> signature = Encryption::sign(message, privateKey);
+        std::vector<uint8_t> signatureBytes = key.sign(message);
+        signature.assign(signatureBytes.begin(), signatureBytes.end());
+        signerPublicKey = key.getPublicKey();
         
         for (auto& input : inputs) {
-            input.signature = std::string(signature.begin(), signature.end());
-            input.publicKey = Encryption::generatePublicKey(privateKey);
+            input.signature = signature;
+            input.publicKey = signerPublicKey;
         }
         
         return true;
@@ -66,29 +369,30 @@ bool Transaction::sign(const std::string& privateKey) {
 }
 
 bool Transaction::verify() const {
-    // Verify basic transaction structure
-    if (inputs.empty() || outputs.empty()) {
+    if (signature.empty() || signerPublicKey.empty()) {
         return false;
     }
     
-    // Verify total input >= total output
-    if (getTotalInput() < getTotalOutput()) {
+    // Signatures already verified at mempool admission or by an earlier
+    // validation pass are skipped through the shared cache
+    const std::string message = calculateHash();
+    if (!verifyCached(message, TRANSACTION_SIGNATURE_INDEX, signerPublicKey, signature)) {
         return false;
     }
     
-    // Verify all inputs
-    for (const auto& input : inputs) {
-        if (!input.verify()) {
-            return false;
-        }
+    // Account transfers and messages have no inputs; spends must also
+    // balance and carry valid input signatures
+    if (inputs.empty()) {
+        return true;
+    }
+    if (outputs.empty() || getTotalInput() < getTotalOutput()) {
+        return false;
     }
     
-    // Verify signatures
-    for (const auto& input : inputs) {
-        std::string message = calculateHash();
-        std::vector<uint8_t> signature(input.signature.begin(), input.signature.end());
-        
-        if (!Encryption::verify(message, signature, input.publicKey)) {
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const auto& input = inputs[i];
+        if (!input.verify() ||
+            !verifyCached(message, static_cast<uint32_t>(i), input.publicKey, input.signature)) {
             return false;
         }
     }
@@ -101,15 +405,102 @@ void Transaction::setMessage(const std::string& message,
     std::vector<uint8_t> encrypted = Encryption::encrypt(message, recipientPublicKey);
     encryptedMessage = std::string(encrypted.begin(), encrypted.end());
     messageRecipient = recipientPublicKey;
+    messageKeys.clear();
+    hash = calculateHash();
+}
+
+void Transaction::setEncryptedMessage(const std::string& ciphertext,
+                                      const std::string& recipientPublicKey) {
+    encryptedMessage = ciphertext;
+    messageRecipient = recipientPublicKey;
+    messageKeys.clear();
+    hash = calculateHash();
 }
 
 std::string Transaction::decryptMessage(const std::string& recipientPrivateKey) const {
+    if (!messageKeys.empty()) {
+        return decryptMessage(recipientPrivateKey,
+                              Encryption::generatePublicKey(recipientPrivateKey));
+    }
+    return decryptMessage(recipientPrivateKey, messageRecipient);
+}
+
+std::string Transaction::decryptMessage(const std::string& recipientPrivateKey,
+                                        const std::string& recipientPublicKey) const {
     if (encryptedMessage.empty()) {
         throw std::runtime_error("No encrypted message found");
     }
     
-    std::vector<uint8_t> encrypted(encryptedMessage.begin(), encryptedMessage.end());
-    return Encryption::decrypt(encrypted, recipientPrivateKey);
+    if (messageKeys.empty()) {
+        std::vector<uint8_t> encrypted(encryptedMessage.begin(), encryptedMessage.end());
+        return Encryption::decrypt(encrypted, recipientPrivateKey);
+    }
+    
+    const std::string tag = groupRecipientTag(recipientPublicKey, encryptedMessage);
+    std::vector<uint8_t> payload(encryptedMessage.begin(), encryptedMessage.end());
+    for (const auto& messageKey : messageKeys) {
+        if (messageKey.recipientTag != tag) continue;
+        
+        // Tags are short, so a collision with another member only costs
+        // one failed unwrap
+        std::string contentKey;
+        try {
+            std::vector<uint8_t> wrapped(messageKey.wrappedKey.begin(), messageKey.wrappedKey.end());
+            contentKey = Encryption::decrypt(wrapped, recipientPrivateKey);
+        } catch (const std::exception& e) {
+            continue;
+        }
+        if (contentKey.size() != StreamCipher::KEY_SIZE) continue;
+        
+        return StreamCipher::open(payload, std::vector<uint8_t>(contentKey.begin(), contentKey.end()));
+    }
+    
+    throw std::runtime_error("Message not addressed to this key");
+}
+
+void Transaction::setGroupMessage(const std::string& message,
+                                  const std::vector<std::string>& recipientPublicKeys) {
+    std::vector<std::string> recipients(recipientPublicKeys);
+    std::sort(recipients.begin(), recipients.end());
+    recipients.erase(std::unique(recipients.begin(), recipients.end()), recipients.end());
+    if (recipients.empty()) {
+        throw std::invalid_argument("Group message needs at least one recipient");
+    }
+    
+    std::vector<uint8_t> contentKey(StreamCipher::KEY_SIZE);
+    if (RAND_bytes(contentKey.data(), contentKey.size()) != 1) {
+        throw std::runtime_error("Failed to generate content key");
+    }
+    
+    // The body is encrypted once; the random nonce in its header makes the
+    // recipient tags unlinkable across messages
+    std::vector<uint8_t> sealed = StreamCipher::seal(message, contentKey);
+    encryptedMessage.assign(sealed.begin(), sealed.end());
+    messageRecipient.clear();
+    
+    const std::string keyText(contentKey.begin(), contentKey.end());
+    messageKeys.clear();
+    messageKeys.reserve(recipients.size());
+    for (const auto& publicKey : recipients) {
+        std::vector<uint8_t> wrapped = Encryption::encrypt(keyText, publicKey);
+        messageKeys.push_back({groupRecipientTag(publicKey, encryptedMessage),
+                               std::string(wrapped.begin(), wrapped.end())});
+    }
+    
+    // Sorted by tag so the order of entries says nothing about the recipients
+    std::sort(messageKeys.begin(), messageKeys.end(),
+              [](const MessageKey& a, const MessageKey& b) { return a.recipientTag < b.recipientTag; });
+    hash = calculateHash();
+}
+
+bool Transaction::isMessageRecipient(const std::string& publicKey) const {
+    if (messageKeys.empty()) {
+        return !encryptedMessage.empty() && messageRecipient == publicKey;
+    }
+    
+    const std::string tag = groupRecipientTag(publicKey, encryptedMessage);
+    return std::any_of(messageKeys.begin(), messageKeys.end(),
+                       [&tag](const MessageKey& messageKey) { return messageKey.recipientTag == tag; });
 }
 
 void Transaction::setContractCall(const std::string& contractAddr,
@@ -118,9 +509,44 @@ void Transaction::setContractCall(const std::string& contractAddr,
     contractAddress = contractAddr;
     methodSignature = method;
     parameters = params;
+    
+    // Without gas the call would fail on its first instruction
+    if (gasLimit == 0) {
+        gasLimit = DEFAULT_CALL_GAS_LIMIT;
+    }
     hash = calculateHash(); // Recalculate hash with new data
 }
 
+void Transaction::setGas(uint64_t gasLimitIn, double gasPriceIn) {
+    gasLimit = gasLimitIn;
+    gasPrice = gasPriceIn;
+    hash = calculateHash();
+}
+
+bool Transaction::isValid() const {
+    return verify() && hasValidFee();
+}
+
+bool Transaction::hasValidFee() const {
+    double fee = getFee();
+    if (fee < 0) {
+        return false;
+    }
+    
+    // Contract calls prepay their whole gas limit; once executed, the fee
+    // must also cover the gas actually used
+    if (!contractAddress.empty()) {
+        if (fee < gasLimit * gasPrice) {
+            return false;
+        }
+        if (gasUsed > gasLimit) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
 double Transaction::getTotalInput() const {
     double total = 0;
     for (const auto& input : inputs) {
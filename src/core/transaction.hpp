@@ -2,8 +2,11 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <cstdint>
 #include "../crypto/hash.hpp"
 
+class SigningKey;
+
 enum class TransactionStatus {
     PENDING,
     CONFIRMED,
@@ -32,6 +35,14 @@ public:
     std::string getHash() const;
 };
 
+// Per-recipient entry of a group message: the content key wrapped to one
+// recipient's public key, filed under a short tag that only that
+// recipient can recompute
+struct MessageKey {
+    std::string recipientTag;
+    std::string wrappedKey;
+};
+
 class Transaction {
 private:
     std::string hash;
@@ -44,38 +55,107 @@ private:
     // Message-specific fields
     std::string encryptedMessage;
     std::string messageRecipient;
+    std::vector<MessageKey> messageKeys;    // Group messages only
     
     // Smart contract interaction fields
     std::string contractAddress;
     std::string methodSignature;
     std::vector<std::string> parameters;
     
+    // Gas for contract calls; gasUsed is filled in by execution and is
+    // not part of the signed hash
+    uint64_t gasLimit;
+    double gasPrice;
+    uint64_t gasUsed;
+    
+    // Signer's signature over the hash, so transactions without inputs
+    // are signed too. Neither field is part of the hash.
+    std::string signature;
+    std::string signerPublicKey;
+    
 public:
+    // Gas limit a contract call gets unless setGas says otherwise
+    static constexpr uint64_t DEFAULT_CALL_GAS_LIMIT = 1000000;
+    
     Transaction(TransactionType type);
     Transaction(const std::string& sender, const std::string& recipient, TransactionType type);
     
+    Transaction(const Transaction&) = default;
+    Transaction(Transaction&&) noexcept = default;
+    Transaction& operator=(const Transaction&) = default;
+    Transaction& operator=(Transaction&&) noexcept = default;
+    
     // Core transaction methods
     void addInput(const TransactionInput& input);
     void addOutput(const TransactionOutput& output);
     bool sign(const std::string& privateKey);
+    
+    // Signs the hash, and every input when there are any. A parsed key is
+    // reused across a batch of transactions.
+    bool sign(const SigningKey& key);
+    
+    // Checks the transaction signature, and for spends also the inputs
     bool verify() const;
     
     // Message methods
     void setMessage(const std::string& message, const std::string& recipientPublicKey);
+    void setEncryptedMessage(const std::string& ciphertext, const std::string& recipientPublicKey);
     std::string decryptMessage(const std::string& recipientPrivateKey) const;
+    std::string decryptMessage(const std::string& recipientPrivateKey,
+                               const std::string& recipientPublicKey) const;
+    
+    // Group messages encrypt the body once under a random content key and
+    // wrap only that key for each recipient
+    void setGroupMessage(const std::string& message,
+                         const std::vector<std::string>& recipientPublicKeys);
+    bool isMessageRecipient(const std::string& publicKey) const;
+    
+    // Tag filed for publicKey on a group message. Only the stream header
+    // at the start of encryptedMessage is read, so the header alone is
+    // enough to match against.
+    static std::string groupRecipientTag(const std::string& publicKey, const std::string& encryptedMessage);
     
-    // Smart contract methods
+    // Smart contract methods. A call keeps any gas limit already set and
+    // otherwise gets DEFAULT_CALL_GAS_LIMIT.
     void setContractCall(const std::string& contractAddr, 
                         const std::string& method,
                         const std::vector<std::string>& params);
+    void setGas(uint64_t gasLimitIn, double gasPriceIn);
+    void setGasUsed(uint64_t gasUsedIn) { gasUsed = gasUsedIn; }
     
     // Getters
-    std::string getHash() const { return hash; }
+    const std::string& getHash() const { return hash; }
+    const std::vector<TransactionInput>& getInputs() const { return inputs; }
     TransactionStatus getStatus() const { return status; }
+    bool hasMessage() const { return !encryptedMessage.empty(); }
+    const std::string& getEncryptedMessage() const { return encryptedMessage; }
+    bool isGroupMessage() const { return !messageKeys.empty(); }
+    const std::vector<MessageKey>& getMessageKeys() const { return messageKeys; }
+    const std::string& getContractAddress() const { return contractAddress; }
+    const std::string& getMethodSignature() const { return methodSignature; }
+    const std::vector<std::string>& getParameters() const { return parameters; }
+    uint64_t getGasLimit() const { return gasLimit; }
+    double getGasPrice() const { return gasPrice; }
+    uint64_t getGasUsed() const { return gasUsed; }
+    const std::string& getSignature() const { return signature; }
+    const std::string& getSignerPublicKey() const { return signerPublicKey; }
+    double getFee() const { return getTotalInput() - getTotalOutput(); }
     double getTotalInput() const;
     double getTotalOutput() const;
     
-    // Validation
+    // Estimated encoded size, used to price block space
+    size_t getSerializedSize() const;
+    
+    // Wire encoding for relaying transactions and block bodies. The hash
+    // is recomputed on decode rather than trusted; deserialize throws
+    // std::runtime_error on truncated or trailing data.
+    std::string serialize() const;
+    static Transaction deserialize(const std::string& data);
+    
+    // Validation: signatures and fee
     bool isValid() const;
     bool hasValidFee() const;
+    
+private:
+    std::string calculateHash() const;
 }; 
\ No newline at end of file
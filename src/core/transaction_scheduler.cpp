@@ -0,0 +1,68 @@
+#include "transaction_scheduler.hpp"
+#include <unordered_map>
+#include <numeric>
+
+AccessSet TransactionScheduler::computeAccessSet(const Transaction& transaction) {
+    AccessSet access;
+    
+    if (transaction.getType() == TransactionType::FINANCIAL) {
+        // The sender's balance is checked and debited, the recipient credited
+        access.reads.push_back(transaction.getSender());
+        access.writes.push_back(transaction.getSender());
+        access.writes.push_back(transaction.getRecipient());
+    }
+    
+    if (!transaction.getContractAddress().empty()) {
+        access.reads.push_back(transaction.getContractAddress());
+        access.writes.push_back(transaction.getContractAddress());
+    }
+    
+    return access;
+}
+
+std::vector<std::vector<size_t>> TransactionScheduler::partition(
+    const std::vector<Transaction>& transactions) {
+    
+    // Union-find over transaction indices, joined through shared keys
+    std::vector<size_t> parent(transactions.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    
+    auto find = [&parent](size_t i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    
+    std::unordered_map<std::string, size_t> keyOwner;
+    for (size_t i = 0; i < transactions.size(); i++) {
+        AccessSet access = computeAccessSet(transactions[i]);
+        
+        auto join = [&](const std::string& key) {
+            auto [it, inserted] = keyOwner.emplace(key, i);
+            if (!inserted) {
+                size_t a = find(it->second);
+                size_t b = find(i);
+                // Keep the lowest index as root so group order is stable
+                if (a < b) parent[b] = a; else parent[a] = b;
+            }
+        };
+        
+        for (const auto& key : access.reads) join(key);
+        for (const auto& key : access.writes) join(key);
+    }
+    
+    std::vector<std::vector<size_t>> groups;
+    std::unordered_map<size_t, size_t> groupOfRoot;
+    for (size_t i = 0; i < transactions.size(); i++) {
+        size_t root = find(i);
+        auto [it, inserted] = groupOfRoot.emplace(root, groups.size());
+        if (inserted) {
+            groups.emplace_back();
+        }
+        groups[it->second].push_back(i);
+    }
+    
+    return groups;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "transaction.hpp"
+
+// State a transaction touches, used to find transactions that can be
+// validated and applied independently of each other
+struct AccessSet {
+    std::vector<std::string> reads;
+    std::vector<std::string> writes;
+};
+
+class TransactionScheduler {
+public:
+    static AccessSet computeAccessSet(const Transaction& transaction);
+    
+    // Splits transactions into groups with disjoint access sets. Each group
+    // lists indices in block order, and groups are ordered by their first
+    // index, so the result depends only on the block contents.
+    static std::vector<std::vector<size_t>> partition(const std::vector<Transaction>& transactions);
+};
\ No newline at end of file
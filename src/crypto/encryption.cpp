@@ -1,8 +1,10 @@
 #include "encryption.hpp"
+#include "hash.hpp"
 #include <openssl/evp.h>
 #include <openssl/aes.h>
 #include <openssl/rand.h>
 #include <openssl/ec.h>
+#include <openssl/ecdsa.h>
 
 std::string Encryption::generatePrivateKey() {
     std::vector<uint8_t> key(KEY_SIZE / 8);
@@ -46,6 +48,106 @@ std::string Encryption::generatePublicKey(const std::string& privateKey) {
     return publicKey;
 }
 
+SigningKey::SigningKey(const std::string& privateKeyHex)
+    : key(EC_KEY_new_by_curve_name(NID_secp256k1)) {
+    BIGNUM* priv = nullptr;
+    EC_POINT* pub = nullptr;
+    char* pubHex = nullptr;
+    
+    bool ok = key &&
+              BN_hex2bn(&priv, privateKeyHex.c_str()) > 0 &&
+              EC_KEY_set_private_key(key, priv) == 1 &&
+              (pub = EC_POINT_new(EC_KEY_get0_group(key))) != nullptr &&
+              EC_POINT_mul(EC_KEY_get0_group(key), pub, priv, nullptr, nullptr, nullptr) == 1 &&
+              EC_KEY_set_public_key(key, pub) == 1 &&
+              (pubHex = EC_POINT_point2hex(EC_KEY_get0_group(key), pub,
+                                           POINT_CONVERSION_COMPRESSED, nullptr)) != nullptr;
+    if (ok) {
+        publicKey = pubHex;
+    }
+    
+    OPENSSL_free(pubHex);
+    EC_POINT_free(pub);
+    BN_clear_free(priv);
+    
+    if (!ok) {
+        EC_KEY_free(key);
+        throw std::runtime_error("Failed to parse signing key");
+    }
+}
+
+SigningKey::~SigningKey() {
+    EC_KEY_free(key);
+}
+
+std::vector<uint8_t> SigningKey::sign(const std::string& message) const {
+    uint8_t digest[32];
+    std::vector<uint8_t> signature(ECDSA_size(key));
+    unsigned int length = 0;
+    
+    if (EVP_Digest(message.data(), message.size(), digest, nullptr, EVP_sha256(), nullptr) != 1 ||
+        ECDSA_sign(0, digest, sizeof(digest), signature.data(), &length, key) != 1) {
+        throw std::runtime_error("Failed to sign message");
+    }
+    
+    signature.resize(length);
+    return signature;
+}
+
+std::vector<uint8_t> Encryption::sign(const std::string& message,
+                                      const std::string& privateKey) {
+    return SigningKey(privateKey).sign(message);
+}
+
+std::string Encryption::deriveAddress(const std::string& publicKey) {
+    return "M" + SHA256::hash(publicKey).substr(0, 30);
+}
+
+bool Encryption::isPublicKey(const std::string& publicKey) {
+    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    EC_POINT* point = group ? EC_POINT_hex2point(group, publicKey.c_str(), nullptr, nullptr) : nullptr;
+    const bool valid = point != nullptr;
+    EC_POINT_free(point);
+    EC_GROUP_free(group);
+    return valid;
+}
+
+std::vector<uint8_t> Encryption::deriveSharedSecret(const std::string& privateKey,
+                                                   const std::string& peerPublicKey) {
+    EC_GROUP* group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+    BIGNUM* priv = nullptr;
+    EC_POINT* peer = nullptr;
+    EC_POINT* shared = nullptr;
+    BIGNUM* x = BN_new();
+    
+    bool ok = group && x &&
+              BN_hex2bn(&priv, privateKey.c_str()) > 0 &&
+              (peer = EC_POINT_hex2point(group, peerPublicKey.c_str(), nullptr, nullptr)) != nullptr &&
+              (shared = EC_POINT_new(group)) != nullptr &&
+              EC_POINT_mul(group, shared, nullptr, peer, priv, nullptr) == 1 &&
+              EC_POINT_get_affine_coordinates(group, shared, x, nullptr, nullptr) == 1;
+    
+    std::vector<uint8_t> secret;
+    if (ok) {
+        std::vector<uint8_t> xBytes(32);
+        ok = BN_bn2binpad(x, xBytes.data(), xBytes.size()) == 32;
+        secret.resize(32);
+        ok = ok && EVP_Digest(xBytes.data(), xBytes.size(), secret.data(), nullptr, EVP_sha256(), nullptr) == 1;
+        OPENSSL_cleanse(xBytes.data(), xBytes.size());
+    }
+    
+    BN_clear_free(priv);
+    BN_free(x);
+    EC_POINT_free(peer);
+    EC_POINT_free(shared);
+    EC_GROUP_free(group);
+    
+    if (!ok) {
+        throw std::runtime_error("Failed to derive shared secret");
+    }
+    return secret;
+}
+
 std::vector<uint8_t> Encryption::encrypt(const std::string& message,
                                        const std::string& publicKey) {
     EncryptionKey key;
@@ -75,4 +177,10 @@ std::vector<uint8_t> Encryption::encrypt(const std::string& message,
     
     ciphertext.resize(len + finalLen);
     return ciphertext;
-} 
\ No newline at end of file
+} 
+
+bool Encryption::verify(const std::string& message,
+                        const std::vector<uint8_t>& signature,
+                        const std::string& publicKey) {
+    return verify(message, signature.data(), signature.size(), publicKey);
+}
\ No newline at end of file
@@ -3,6 +3,27 @@
 #include <vector>
 #include <memory>
 
+typedef struct ec_key_st EC_KEY;
+
+// Private key parsed once for repeated signing. Signing through one key
+// from several threads at once is safe.
+class SigningKey {
+private:
+    EC_KEY* key;
+    std::string publicKey;
+    
+public:
+    explicit SigningKey(const std::string& privateKeyHex);
+    ~SigningKey();
+    
+    SigningKey(const SigningKey&) = delete;
+    SigningKey& operator=(const SigningKey&) = delete;
+    
+    // ECDSA over SHA-256 of the message, DER encoded
+    std::vector<uint8_t> sign(const std::string& message) const;
+    const std::string& getPublicKey() const { return publicKey; }
+};
+
 class Encryption {
 private:
     static const uint32_t KEY_SIZE = 256;
@@ -24,15 +45,30 @@ public:
     static std::string decrypt(const std::vector<uint8_t>& ciphertext,
                              const std::string& privateKey);
     
+    // ECDH over secp256k1; returns SHA-256 of the shared point's x coordinate
+    static std::vector<uint8_t> deriveSharedSecret(const std::string& privateKey,
+                                                   const std::string& peerPublicKey);
+    
     // Digital signatures
     static std::vector<uint8_t> sign(const std::string& message,
                                    const std::string& privateKey);
+    static std::vector<uint8_t> sign(const std::string& message,
+                                   const SigningKey& key) {
+        return key.sign(message);
+    }
     static bool verify(const std::string& message,
                       const std::vector<uint8_t>& signature,
                       const std::string& publicKey);
+    static bool verify(const std::string& message,
+                      const uint8_t* signature,
+                      size_t signatureLength,
+                      const std::string& publicKey);
     
     // Key management
     static bool validateKeyPair(const std::string& privateKey,
                               const std::string& publicKey);
     static std::string deriveAddress(const std::string& publicKey);
+    
+    // True for a hex-encoded point on the curve
+    static bool isPublicKey(const std::string& publicKey);
 }; 
\ No newline at end of file
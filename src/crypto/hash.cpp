@@ -5,23 +5,34 @@
 #include <iomanip>
 
 std::string SHA256::hash(const std::string& input) {
+    return hash(input.data(), input.size());
+}
+
+std::string SHA256::hash(const char* data, size_t length) {
     unsigned char hash[SHA256_DIGEST_LENGTH];
     SHA256_CTX sha256;
     SHA256_Init(&sha256);
-    SHA256_Update(&sha256, input.c_str(), input.length());
+    SHA256_Update(&sha256, data, length);
     SHA256_Final(hash, &sha256);
     
-    std::stringstream ss;
+    // Hot in state-tree updates, so skip the stringstream formatting
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string hex(2 * SHA256_DIGEST_LENGTH, '0');
     for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+        hex[2 * i] = hexDigits[hash[i] >> 4];
+        hex[2 * i + 1] = hexDigits[hash[i] & 0x0f];
     }
-    return ss.str();
+    return hex;
 }
 
 std::string SHA256::doubleHash(const std::string& input) {
     return hash(hash(input));
 }
 
+std::string SHA256::doubleHash(const char* data, size_t length) {
+    return hash(hash(data, length));
+}
+
 std::string SHA256::hashWithSalt(const std::string& input, const std::string& salt) {
     return hash(input + salt);
 }
@@ -7,9 +7,11 @@ class SHA256 {
 public:
     static std::string hash(const std::string& input);
     static std::string hash(const std::vector<uint8_t>& input);
+    static std::string hash(const char* data, size_t length);
     
     // Double SHA256 (commonly used in blockchain)
     static std::string doubleHash(const std::string& input);
+    static std::string doubleHash(const char* data, size_t length);
     
     // Hash with salt
     static std::string hashWithSalt(const std::string& input, const std::string& salt);
@@ -0,0 +1,342 @@
+#include "key_derivation.hpp"
+#include "encryption.hpp"
+#include "../utils/cache_manager.hpp"
+#include "../utils/thread_pool.hpp"
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/crypto.h>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+    constexpr size_t KEY_BYTES = 32;
+    constexpr size_t PUBLIC_KEY_CACHE_SIZE = 1 << 16;
+    
+    // Ranges below this size are derived on the calling thread
+    constexpr size_t PARALLEL_DERIVE_THRESHOLD = 32;
+    constexpr size_t DERIVE_BATCH_SIZE = 64;
+    
+    // Shared curve with the generator multiples precomputed once; only
+    // read after construction, so safe to use from any thread
+    const EC_GROUP* curve() {
+        static const EC_GROUP* group = []() {
+            EC_GROUP* g = EC_GROUP_new_by_curve_name(NID_secp256k1);
+            if (!g) {
+                throw std::runtime_error("Failed to create curve");
+            }
+            EC_GROUP_precompute_mult(g, nullptr);
+            return g;
+        }();
+        return group;
+    }
+    
+    // HMAC implementation, fetched once and shared like the curve
+    EVP_MAC* hmacAlgorithm() {
+        static EVP_MAC* mac = []() {
+            EVP_MAC* fetched = EVP_MAC_fetch(nullptr, OSSL_MAC_NAME_HMAC, nullptr);
+            if (!fetched) {
+                throw std::runtime_error("HMAC unavailable");
+            }
+            return fetched;
+        }();
+        return mac;
+    }
+    
+    // HMAC-SHA512 context keyed and ready for data; nullptr on failure
+    EVP_MAC_CTX* newHmacSHA512(const uint8_t* key, size_t keyLength) {
+        EVP_MAC_CTX* ctx = EVP_MAC_CTX_new(hmacAlgorithm());
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA512"), 0),
+            OSSL_PARAM_construct_end()
+        };
+        if (ctx && EVP_MAC_init(ctx, key, keyLength, params) != 1) {
+            EVP_MAC_CTX_free(ctx);
+            return nullptr;
+        }
+        return ctx;
+    }
+    
+    std::string toHex(const uint8_t* data, size_t length) {
+        static const char hexDigits[] = "0123456789abcdef";
+        std::string hex(2 * length, '0');
+        for (size_t i = 0; i < length; i++) {
+            hex[2 * i] = hexDigits[data[i] >> 4];
+            hex[2 * i + 1] = hexDigits[data[i] & 0x0f];
+        }
+        return hex;
+    }
+    
+    std::vector<uint8_t> fromHex(const std::string& hex) {
+        if (hex.size() % 2 != 0) {
+            throw std::invalid_argument("Odd-length hex string");
+        }
+        auto nibble = [](char c) -> uint8_t {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            throw std::invalid_argument("Invalid hex digit");
+        };
+        std::vector<uint8_t> bytes(hex.size() / 2);
+        for (size_t i = 0; i < bytes.size(); i++) {
+            bytes[i] = (nibble(hex[2 * i]) << 4) | nibble(hex[2 * i + 1]);
+        }
+        return bytes;
+    }
+    
+    std::string computePublicKey(const BIGNUM* privateKey, BN_CTX* bnCtx) {
+        const EC_GROUP* group = curve();
+        EC_POINT* point = EC_POINT_new(group);
+        char* hex = nullptr;
+        if (!point ||
+            EC_POINT_mul(group, point, privateKey, nullptr, nullptr, bnCtx) != 1 ||
+            (hex = EC_POINT_point2hex(group, point, POINT_CONVERSION_COMPRESSED, bnCtx)) == nullptr) {
+            EC_POINT_free(point);
+            throw std::runtime_error("Failed to compute public key");
+        }
+        
+        std::string publicKey(hex);
+        OPENSSL_free(hex);
+        EC_POINT_free(point);
+        return publicKey;
+    }
+    
+    // Public keys cached under a digest of the private key, so the cache
+    // never holds private key material
+    LRUCache<std::string, std::string>& publicKeyCache() {
+        static LRUCache<std::string, std::string> cache(PUBLIC_KEY_CACHE_SIZE);
+        return cache;
+    }
+    
+    std::string publicKeyCacheKey(const std::string& privateKeyHex) {
+        static const char tag[] = "public-key-cache";
+        uint8_t digest[32];
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        const bool ok = ctx &&
+                        EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) == 1 &&
+                        EVP_DigestUpdate(ctx, tag, sizeof(tag)) == 1 &&
+                        EVP_DigestUpdate(ctx, privateKeyHex.data(), privateKeyHex.size()) == 1 &&
+                        EVP_DigestFinal_ex(ctx, digest, nullptr) == 1;
+        EVP_MD_CTX_free(ctx);
+        if (!ok) {
+            throw std::runtime_error("Failed to hash cache key");
+        }
+        return std::string(reinterpret_cast<const char*>(digest), sizeof(digest));
+    }
+    
+    // Per-slice scratch state; the template context is duplicated, never
+    // used directly, so one parent serves any number of threads
+    class ChildDeriver {
+    private:
+        const EVP_MAC_CTX* parentState;
+        const BIGNUM* parentKey;
+        BN_CTX* bnCtx;
+        BIGNUM* tweak;
+        BIGNUM* child;
+        
+    public:
+        ChildDeriver(const EVP_MAC_CTX* parentStateIn, const BIGNUM* parentKeyIn)
+            : parentState(parentStateIn),
+              parentKey(parentKeyIn),
+              bnCtx(BN_CTX_new()),
+              tweak(BN_new()),
+              child(BN_new()) {
+            if (!bnCtx || !tweak || !child) {
+                release();
+                throw std::runtime_error("Failed to allocate derivation state");
+            }
+        }
+        
+        ~ChildDeriver() { release(); }
+        
+        ChildDeriver(const ChildDeriver&) = delete;
+        ChildDeriver& operator=(const ChildDeriver&) = delete;
+        
+        // I = HMAC-SHA512(chainCode, prefix || ser32(index));
+        // child = I_L + parent mod n, chain code = I_R
+        void derive(uint32_t index, KeyDerivation::DerivedKey& out) {
+            uint8_t indexBytes[4] = {
+                static_cast<uint8_t>(index >> 24), static_cast<uint8_t>(index >> 16),
+                static_cast<uint8_t>(index >> 8), static_cast<uint8_t>(index)
+            };
+            uint8_t digest[64];
+            size_t digestLength = 0;
+            EVP_MAC_CTX* hmac = EVP_MAC_CTX_dup(parentState);
+            const bool ok = hmac &&
+                            EVP_MAC_update(hmac, indexBytes, sizeof(indexBytes)) == 1 &&
+                            EVP_MAC_final(hmac, digest, &digestLength, sizeof(digest)) == 1;
+            EVP_MAC_CTX_free(hmac);
+            if (!ok) {
+                throw std::runtime_error("Failed to derive child key");
+            }
+            
+            const BIGNUM* order = EC_GROUP_get0_order(curve());
+            BN_bin2bn(digest, KEY_BYTES, tweak);
+            if (BN_cmp(tweak, order) >= 0 ||
+                BN_mod_add(child, tweak, parentKey, order, bnCtx) != 1 ||
+                BN_is_zero(child)) {
+                // Probability below 2^-127; BIP32 skips such indices
+                throw std::runtime_error("Invalid child key at index " + std::to_string(index));
+            }
+            
+            uint8_t childBytes[KEY_BYTES];
+            BN_bn2binpad(child, childBytes, KEY_BYTES);
+            out.index = index;
+            out.privateKey = toHex(childBytes, KEY_BYTES);
+            out.extendedKey = out.privateKey + toHex(digest + KEY_BYTES, KEY_BYTES);
+            OPENSSL_cleanse(childBytes, sizeof(childBytes));
+            OPENSSL_cleanse(digest, sizeof(digest));
+            
+            LRUCache<std::string, std::string>& cache = publicKeyCache();
+            const std::string cacheKey = publicKeyCacheKey(out.privateKey);
+            if (!cache.get(cacheKey, out.publicKey)) {
+                out.publicKey = computePublicKey(child, bnCtx);
+                cache.put(cacheKey, out.publicKey);
+            }
+            out.address = Encryption::deriveAddress(out.publicKey);
+        }
+        
+    private:
+        void release() {
+            BN_CTX_free(bnCtx);
+            BN_clear_free(tweak);
+            BN_clear_free(child);
+        }
+    };
+}
+
+std::vector<uint8_t> KeyDerivation::hmacSHA512(const std::vector<uint8_t>& key,
+                                               const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> result(64);
+    size_t length = 0;
+    EVP_MAC_CTX* ctx = newHmacSHA512(key.data(), key.size());
+    const bool ok = ctx &&
+                    EVP_MAC_update(ctx, data.data(), data.size()) == 1 &&
+                    EVP_MAC_final(ctx, result.data(), &length, result.size()) == 1;
+    EVP_MAC_CTX_free(ctx);
+    if (!ok) {
+        throw std::runtime_error("HMAC-SHA512 failed");
+    }
+    return result;
+}
+
+std::string KeyDerivation::createHDWallet(const std::string& seed) {
+    static const std::string masterSalt = "Bitcoin seed";
+    std::vector<uint8_t> digest = hmacSHA512(std::vector<uint8_t>(masterSalt.begin(), masterSalt.end()),
+                                             std::vector<uint8_t>(seed.begin(), seed.end()));
+    std::string masterKey = toHex(digest.data(), digest.size());
+    OPENSSL_cleanse(digest.data(), digest.size());
+    return masterKey;
+}
+
+std::string KeyDerivation::deriveChildKey(const std::string& masterKey, uint32_t index) {
+    const bool hardened = index >= HARDENED_OFFSET;
+    const uint32_t base = hardened ? index - HARDENED_OFFSET : index;
+    return deriveRange(masterKey, base, base + 1, hardened).front().extendedKey;
+}
+
+std::string KeyDerivation::getPublicKey(const std::string& privateKey) {
+    LRUCache<std::string, std::string>& cache = publicKeyCache();
+    const std::string cacheKey = publicKeyCacheKey(privateKey);
+    std::string publicKey;
+    if (cache.get(cacheKey, publicKey)) {
+        return publicKey;
+    }
+    
+    BIGNUM* key = nullptr;
+    BN_CTX* bnCtx = BN_CTX_new();
+    if (!bnCtx || BN_hex2bn(&key, privateKey.c_str()) <= 0) {
+        BN_CTX_free(bnCtx);
+        throw std::invalid_argument("Invalid private key");
+    }
+    
+    try {
+        publicKey = computePublicKey(key, bnCtx);
+    } catch (...) {
+        BN_clear_free(key);
+        BN_CTX_free(bnCtx);
+        throw;
+    }
+    BN_clear_free(key);
+    BN_CTX_free(bnCtx);
+    
+    cache.put(cacheKey, publicKey);
+    return publicKey;
+}
+
+std::vector<KeyDerivation::DerivedKey> KeyDerivation::deriveRange(const std::string& parentKey,
+                                                                  uint32_t begin,
+                                                                  uint32_t end,
+                                                                  bool hardened) {
+    if (end <= begin) {
+        return {};
+    }
+    if (end > HARDENED_OFFSET) {
+        throw std::invalid_argument("Derivation index out of range");
+    }
+    
+    std::vector<uint8_t> parent = fromHex(parentKey);
+    if (parent.size() != 2 * KEY_BYTES) {
+        throw std::invalid_argument("Extended key must be 64 bytes");
+    }
+    
+    BIGNUM* parentPrivate = BN_bin2bn(parent.data(), KEY_BYTES, nullptr);
+    
+    // Everything but the index is the same for every child: key the HMAC
+    // with the chain code and absorb the parent part of the data once
+    EVP_MAC_CTX* parentState = newHmacSHA512(parent.data() + KEY_BYTES, KEY_BYTES);
+    auto releaseParent = [&]() {
+        BN_clear_free(parentPrivate);
+        EVP_MAC_CTX_free(parentState);
+        OPENSSL_cleanse(parent.data(), parent.size());
+    };
+    
+    bool ok = parentPrivate && parentState;
+    if (ok && hardened) {
+        const uint8_t zero = 0;
+        ok = EVP_MAC_update(parentState, &zero, 1) == 1 &&
+             EVP_MAC_update(parentState, parent.data(), KEY_BYTES) == 1;
+    } else if (ok) {
+        std::string parentPublic;
+        try {
+            parentPublic = getPublicKey(toHex(parent.data(), KEY_BYTES));
+        } catch (...) {
+            releaseParent();
+            throw;
+        }
+        std::vector<uint8_t> serialized = fromHex(parentPublic);
+        ok = EVP_MAC_update(parentState, serialized.data(), serialized.size()) == 1;
+    }
+    if (!ok) {
+        releaseParent();
+        throw std::runtime_error("Failed to initialize parent key state");
+    }
+    
+    const uint32_t offset = hardened ? HARDENED_OFFSET : 0;
+    const size_t count = end - begin;
+    std::vector<DerivedKey> keys(count);
+    
+    auto deriveSlice = [&](size_t first, size_t last) {
+        ChildDeriver deriver(parentState, parentPrivate);
+        for (size_t i = first; i < last; i++) {
+            deriver.derive(offset + begin + static_cast<uint32_t>(i), keys[i]);
+        }
+    };
+    
+    try {
+        if (count < PARALLEL_DERIVE_THRESHOLD) {
+            deriveSlice(0, count);
+        } else {
+            // The first slice to fail cancels the rest and is rethrown here
+            ThreadPool::getInstance().forEachBatch(count, DERIVE_BATCH_SIZE, deriveSlice);
+        }
+    } catch (...) {
+        releaseParent();
+        throw;
+    }
+    
+    releaseParent();
+    return keys;
+}
\ No newline at end of file
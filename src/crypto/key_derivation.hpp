@@ -2,17 +2,38 @@
 #include <string>
 #include <vector>
 
+// BIP32-style derivation. Extended keys are hex of privateKey(32) ||
+// chainCode(32).
 class KeyDerivation {
 public:
+    struct DerivedKey {
+        uint32_t index;
+        std::string extendedKey;
+        std::string privateKey;
+        std::string publicKey;
+        std::string address;
+    };
+    
     static std::string deriveChildKey(const std::string& masterKey, uint32_t index);
     static std::string createHDWallet(const std::string& seed);
     static std::string generateMnemonic();
     static std::string mnemonicToSeed(const std::string& mnemonic, const std::string& passphrase = "");
     
+    // Derives children [begin, end) of parentKey, as hardened indices when
+    // hardened is set. The parent's HMAC state is set up once for the
+    // whole range, and large ranges are split across the thread pool.
+    static std::vector<DerivedKey> deriveRange(const std::string& parentKey,
+                                               uint32_t begin,
+                                               uint32_t end,
+                                               bool hardened = false);
+    
+    // Compressed public key for a private key, from a shared cache
+    static std::string getPublicKey(const std::string& privateKey);
+    
 private:
     static const std::vector<std::string> wordList;
     static constexpr uint32_t HARDENED_OFFSET = 0x80000000;
     
     static std::vector<uint8_t> hmacSHA512(const std::vector<uint8_t>& key, 
                                           const std::vector<uint8_t>& data);
-}; 
\ No newline at end of file
+};
\ No newline at end of file
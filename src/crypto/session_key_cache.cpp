@@ -0,0 +1,335 @@
+#include "session_key_cache.hpp"
+#include "encryption.hpp"
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr char MAGIC[4] = {'M', 'S', 'K', '1'};
+    constexpr size_t KEY_SIZE = 32;
+    constexpr size_t TAG_SIZE = 16;
+    constexpr size_t NONCE_SIZE = 12;
+    constexpr size_t FIXED_HEADER_SIZE = sizeof(MAGIC) + 8 + 4 + 4 + 1;
+    
+    struct CipherContext {
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        ~CipherContext() { EVP_CIPHER_CTX_free(ctx); }
+    };
+    
+    // One context per thread, reused for every message
+    EVP_CIPHER_CTX* threadCipherContext() {
+        thread_local CipherContext context;
+        if (!context.ctx) {
+            throw std::runtime_error("Failed to create cipher context");
+        }
+        return context.ctx;
+    }
+    
+    void appendUint32(std::string& buffer, uint32_t value) {
+        buffer += static_cast<char>(value >> 24);
+        buffer += static_cast<char>(value >> 16);
+        buffer += static_cast<char>(value >> 8);
+        buffer += static_cast<char>(value);
+    }
+    
+    uint32_t readUint32(const std::string& buffer, size_t offset) {
+        const auto* bytes = reinterpret_cast<const uint8_t*>(buffer.data() + offset);
+        return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+               (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+    }
+    
+    std::array<uint8_t, NONCE_SIZE> messageNonce(uint32_t epoch, uint32_t counter) {
+        std::array<uint8_t, NONCE_SIZE> nonce{};
+        for (int i = 0; i < 4; i++) {
+            nonce[i] = static_cast<uint8_t>(epoch >> (24 - 8 * i));
+            nonce[4 + i] = static_cast<uint8_t>(counter >> (24 - 8 * i));
+        }
+        return nonce;
+    }
+    
+    std::vector<uint8_t> hmac(const std::vector<uint8_t>& key, const std::string& data) {
+        std::vector<uint8_t> out(KEY_SIZE);
+        unsigned int length = 0;
+        if (!HMAC(EVP_sha256(), key.data(), key.size(),
+                  reinterpret_cast<const uint8_t*>(data.data()), data.size(),
+                  out.data(), &length)) {
+            throw std::runtime_error("HMAC failed");
+        }
+        return out;
+    }
+    
+    void wipe(std::vector<uint8_t>& key) {
+        OPENSSL_cleanse(key.data(), key.size());
+        key.clear();
+    }
+}
+
+SessionKeyCache::SessionKeyCache(uint32_t messagesPerEpochIn,
+                                 std::chrono::seconds sessionLifetimeIn,
+                                 size_t maxSessionsIn,
+                                 uint32_t maxSessionMessagesIn)
+    : messagesPerEpoch(std::max<uint32_t>(1, messagesPerEpochIn)),
+      maxSessionMessages(std::max<uint32_t>(1, maxSessionMessagesIn)),
+      sessionLifetime(sessionLifetimeIn),
+      maxSessions(std::max<size_t>(1, maxSessionsIn)) {
+}
+
+std::vector<uint8_t> SessionKeyCache::initialEpochKey(const std::vector<uint8_t>& sharedSecret,
+                                                      const SessionId& id,
+                                                      const std::string& senderPublicKey,
+                                                      const std::string& recipientPublicKey) {
+    // Directional: the two sides of a pair share the ECDH secret but never
+    // a chain
+    std::string label = "session";
+    label.append(reinterpret_cast<const char*>(id.data()), id.size());
+    label += senderPublicKey;
+    label += '|';
+    label += recipientPublicKey;
+    return hmac(sharedSecret, label);
+}
+
+void SessionKeyCache::ratchet(std::vector<uint8_t>& epochKey) {
+    std::vector<uint8_t> next = hmac(epochKey, "ratchet");
+    wipe(epochKey);
+    epochKey = std::move(next);
+}
+
+std::vector<uint8_t> SessionKeyCache::messageKey(const std::vector<uint8_t>& epochKey, uint32_t counter) {
+    std::string label = "message";
+    appendUint32(label, counter);
+    return hmac(epochKey, label);
+}
+
+void SessionKeyCache::evictLocked(std::unordered_map<std::string, Session>& sessions, Clock::time_point now) {
+    if (sessions.size() < maxSessions) {
+        return;
+    }
+    
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        if (now - it->second.established >= sessionLifetime) {
+            wipe(it->second.epochKey);
+            it = sessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    if (sessions.size() >= maxSessions) {
+        auto oldest = std::min_element(sessions.begin(), sessions.end(),
+            [](const auto& a, const auto& b) { return a.second.established < b.second.established; });
+        wipe(oldest->second.epochKey);
+        sessions.erase(oldest);
+    }
+}
+
+std::string SessionKeyCache::seal(const std::string& message,
+                                  const std::string& senderPrivateKey,
+                                  const std::string& senderPublicKey,
+                                  const std::string& recipientPublicKey) {
+    if (senderPublicKey.size() > 255) {
+        throw std::invalid_argument("Sender public key too long");
+    }
+    
+    const std::string pairKey = senderPublicKey + '|' + recipientPublicKey;
+    SessionId id;
+    uint32_t epoch = 0;
+    uint32_t counter = 0;
+    std::vector<uint8_t> key;
+    
+    // Takes the next message key from a session and advances it; caller
+    // holds cacheMutex
+    auto takeKey = [&](Session& session) {
+        id = session.id;
+        epoch = session.epoch;
+        counter = session.counter;
+        key = messageKey(session.epochKey, session.counter);
+        session.messageCount++;
+        if (++session.counter == messagesPerEpoch) {
+            ratchet(session.epochKey);
+            session.epoch++;
+            session.counter = 0;
+        }
+    };
+    
+    bool haveKey = false;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = sending.find(pairKey);
+        if (it != sending.end()) {
+            const Session& session = it->second;
+            if (Clock::now() - session.established >= sessionLifetime ||
+                session.messageCount >= maxSessionMessages) {
+                wipe(it->second.epochKey);
+                sending.erase(it);
+            } else {
+                takeKey(it->second);
+                haveKey = true;
+            }
+        }
+    }
+    
+    if (!haveKey) {
+        // New session: the one EC operation, done outside the lock
+        std::vector<uint8_t> secret = Encryption::deriveSharedSecret(senderPrivateKey, recipientPublicKey);
+        Session session;
+        if (RAND_bytes(session.id.data(), session.id.size()) != 1) {
+            throw std::runtime_error("Failed to generate session id");
+        }
+        session.epochKey = initialEpochKey(secret, session.id, senderPublicKey, recipientPublicKey);
+        session.epoch = 0;
+        session.counter = 0;
+        session.messageCount = 0;
+        session.established = Clock::now();
+        wipe(secret);
+        
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = sending.find(pairKey);
+        if (it == sending.end()) {
+            evictLocked(sending, session.established);
+            it = sending.emplace(pairKey, std::move(session)).first;
+        }
+        takeKey(it->second);
+    }
+    
+    std::string envelope(MAGIC, sizeof(MAGIC));
+    envelope.reserve(FIXED_HEADER_SIZE + senderPublicKey.size() + message.size() + TAG_SIZE);
+    envelope.append(reinterpret_cast<const char*>(id.data()), id.size());
+    appendUint32(envelope, epoch);
+    appendUint32(envelope, counter);
+    envelope += static_cast<char>(senderPublicKey.size());
+    envelope += senderPublicKey;
+    const size_t headerSize = envelope.size();
+    envelope.resize(headerSize + message.size() + TAG_SIZE);
+    
+    auto* out = reinterpret_cast<uint8_t*>(&envelope[0]);
+    auto nonce = messageNonce(epoch, counter);
+    EVP_CIPHER_CTX* ctx = threadCipherContext();
+    int length = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.data(), nonce.data()) == 1 &&
+              EVP_EncryptUpdate(ctx, nullptr, &length, out, headerSize) == 1 &&
+              (message.empty() ||
+               EVP_EncryptUpdate(ctx, out + headerSize, &length,
+                                 reinterpret_cast<const uint8_t*>(message.data()), message.size()) == 1) &&
+              EVP_EncryptFinal_ex(ctx, out + headerSize + message.size(), &length) == 1 &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, out + headerSize + message.size()) == 1;
+    wipe(key);
+    if (!ok) {
+        throw std::runtime_error("Failed to seal session message");
+    }
+    return envelope;
+}
+
+std::string SessionKeyCache::open(const std::string& envelope,
+                                  const std::string& recipientPrivateKey,
+                                  const std::string& recipientPublicKey) {
+    if (!isEnvelope(envelope)) {
+        throw std::runtime_error("Not a session message");
+    }
+    
+    SessionId id;
+    std::memcpy(id.data(), envelope.data() + sizeof(MAGIC), id.size());
+    const uint32_t epoch = readUint32(envelope, sizeof(MAGIC) + 8);
+    const uint32_t counter = readUint32(envelope, sizeof(MAGIC) + 12);
+    const size_t senderKeyLength = static_cast<uint8_t>(envelope[FIXED_HEADER_SIZE - 1]);
+    const size_t headerSize = FIXED_HEADER_SIZE + senderKeyLength;
+    if (envelope.size() < headerSize + TAG_SIZE) {
+        throw std::runtime_error("Truncated session message");
+    }
+    const std::string senderPublicKey = envelope.substr(FIXED_HEADER_SIZE, senderKeyLength);
+    
+    std::string sessionKey = senderPublicKey + '|' + recipientPublicKey + '|';
+    sessionKey.append(reinterpret_cast<const char*>(id.data()), id.size());
+    
+    // Catch a cached session up to this message's epoch; earlier epochs
+    // have been ratcheted away and are re-derived from the long-term keys
+    std::vector<uint8_t> key;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = receiving.find(sessionKey);
+        if (it != receiving.end()) {
+            Session& session = it->second;
+            if (Clock::now() - session.established >= sessionLifetime) {
+                wipe(session.epochKey);
+                receiving.erase(it);
+            } else if (epoch >= session.epoch && epoch - session.epoch <= MAX_EPOCH_SKIP) {
+                while (session.epoch < epoch) {
+                    ratchet(session.epochKey);
+                    session.epoch++;
+                }
+                key = messageKey(session.epochKey, counter);
+            }
+        }
+    }
+    
+    if (key.empty()) {
+        if (epoch > MAX_EPOCH_SKIP) {
+            throw std::runtime_error("Session epoch out of range");
+        }
+        
+        std::vector<uint8_t> secret = Encryption::deriveSharedSecret(recipientPrivateKey, senderPublicKey);
+        std::vector<uint8_t> epochKey = initialEpochKey(secret, id, senderPublicKey, recipientPublicKey);
+        wipe(secret);
+        for (uint32_t i = 0; i < epoch; i++) {
+            ratchet(epochKey);
+        }
+        key = messageKey(epochKey, counter);
+        
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = receiving.find(sessionKey);
+        if (it == receiving.end()) {
+            const auto now = Clock::now();
+            evictLocked(receiving, now);
+            receiving.emplace(sessionKey, Session{id, std::move(epochKey), epoch, 0, 0, now});
+        } else if (it->second.epoch < epoch) {
+            wipe(it->second.epochKey);
+            it->second.epochKey = std::move(epochKey);
+            it->second.epoch = epoch;
+        } else {
+            wipe(epochKey);
+        }
+    }
+    
+    const size_t cipherLength = envelope.size() - headerSize - TAG_SIZE;
+    const auto* in = reinterpret_cast<const uint8_t*>(envelope.data());
+    uint8_t tag[TAG_SIZE];
+    std::memcpy(tag, in + headerSize + cipherLength, TAG_SIZE);
+    
+    std::string plaintext(cipherLength, '\0');
+    auto* out = reinterpret_cast<uint8_t*>(&plaintext[0]);
+    auto nonce = messageNonce(epoch, counter);
+    EVP_CIPHER_CTX* ctx = threadCipherContext();
+    int length = 0;
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, key.data(), nonce.data()) == 1 &&
+              EVP_DecryptUpdate(ctx, nullptr, &length, in, headerSize) == 1 &&
+              (cipherLength == 0 ||
+               EVP_DecryptUpdate(ctx, out, &length, in + headerSize, cipherLength) == 1) &&
+              EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, tag) == 1 &&
+              EVP_DecryptFinal_ex(ctx, out + cipherLength, &length) == 1;
+    wipe(key);
+    if (!ok) {
+        throw std::runtime_error("Session message failed authentication");
+    }
+    return plaintext;
+}
+
+bool SessionKeyCache::isEnvelope(const std::string& data) {
+    return data.size() >= FIXED_HEADER_SIZE + TAG_SIZE &&
+           std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+size_t SessionKeyCache::size() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return sending.size() + receiving.size();
+}
+
+void SessionKeyCache::clear() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (auto& [pairKey, session] : sending) wipe(session.epochKey);
+    for (auto& [sessionKey, session] : receiving) wipe(session.epochKey);
+    sending.clear();
+    receiving.clear();
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// Symmetric session keys for pairs of keys that exchange many messages.
+// The expensive ECDH agreement runs once per session; every message after
+// that is sealed with AES-256-GCM under a key taken from a hash ratchet.
+//
+// A session has a random id and a chain of epoch keys. Each epoch key is
+// the HMAC of the previous one, and the old key is erased once the chain
+// moves past it, so a leaked cache cannot decrypt earlier epochs. A
+// sending session is retired after its lifetime or message budget. The
+// next message starts a new session with a new id, so message keys are
+// never reused.
+//
+// Envelope: magic(4) sessionId(8) epoch(4, BE) counter(4, BE)
+//           senderKeyLength(1) senderPublicKey ciphertext tag(16)
+class SessionKeyCache {
+public:
+    static constexpr uint32_t DEFAULT_MESSAGES_PER_EPOCH = 256;
+    static constexpr uint32_t DEFAULT_MAX_SESSION_MESSAGES = 1 << 16;
+    static constexpr std::chrono::seconds DEFAULT_SESSION_LIFETIME{3600};
+    static constexpr size_t DEFAULT_MAX_SESSIONS = 4096;
+    
+    // A receiver catches up at most this many epochs on a cached session
+    static constexpr uint32_t MAX_EPOCH_SKIP = 1024;
+    
+private:
+    using Clock = std::chrono::steady_clock;
+    using SessionId = std::array<uint8_t, 8>;
+    
+    struct Session {
+        SessionId id;
+        std::vector<uint8_t> epochKey;
+        uint32_t epoch;
+        uint32_t counter;           // Next message index within the epoch
+        uint32_t messageCount;
+        Clock::time_point established;
+    };
+    
+    uint32_t messagesPerEpoch;
+    uint32_t maxSessionMessages;
+    std::chrono::seconds sessionLifetime;
+    size_t maxSessions;
+    
+    // Sending sessions keyed by sender||recipient; receiving sessions by
+    // sender||recipient||sessionId
+    std::unordered_map<std::string, Session> sending;
+    std::unordered_map<std::string, Session> receiving;
+    std::mutex cacheMutex;
+    
+public:
+    SessionKeyCache(uint32_t messagesPerEpochIn = DEFAULT_MESSAGES_PER_EPOCH,
+                    std::chrono::seconds sessionLifetimeIn = DEFAULT_SESSION_LIFETIME,
+                    size_t maxSessionsIn = DEFAULT_MAX_SESSIONS,
+                    uint32_t maxSessionMessagesIn = DEFAULT_MAX_SESSION_MESSAGES);
+    
+    SessionKeyCache(const SessionKeyCache&) = delete;
+    SessionKeyCache& operator=(const SessionKeyCache&) = delete;
+    
+    // Thread-safe; ECDH and AEAD work runs outside the cache lock
+    std::string seal(const std::string& message,
+                     const std::string& senderPrivateKey,
+                     const std::string& senderPublicKey,
+                     const std::string& recipientPublicKey);
+    std::string open(const std::string& envelope,
+                     const std::string& recipientPrivateKey,
+                     const std::string& recipientPublicKey);
+    
+    static bool isEnvelope(const std::string& data);
+    
+    size_t size();
+    void clear();
+    
+private:
+    static std::vector<uint8_t> initialEpochKey(const std::vector<uint8_t>& sharedSecret,
+                                                const SessionId& id,
+                                                const std::string& senderPublicKey,
+                                                const std::string& recipientPublicKey);
+    static void ratchet(std::vector<uint8_t>& epochKey);
+    static std::vector<uint8_t> messageKey(const std::vector<uint8_t>& epochKey, uint32_t counter);
+    
+    void evictLocked(std::unordered_map<std::string, Session>& sessions, Clock::time_point now);
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "signature_cache.hpp"
+#include "hash.hpp"
+#include "encryption.hpp"
+#include <functional>
+#include <mutex>
+
+namespace {
+    // Fields are length-prefixed so no choice of field contents can make
+    // two different tuples encode to the same preimage
+    void putU32(std::string& out, uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out += static_cast<char>(value >> shift);
+        }
+    }
+    
+    void putField(std::string& out, const std::string& value) {
+        putU32(out, static_cast<uint32_t>(value.size()));
+        out += value;
+    }
+}
+
+SignatureCache::SignatureCache(size_t maxEntries)
+    : maxEntriesPerShard(maxEntries / SHARD_COUNT),
+      salt(Encryption::generatePrivateKey()) {
+}
+
+SignatureCache& SignatureCache::getInstance() {
+    static SignatureCache instance(DEFAULT_MAX_ENTRIES);
+    return instance;
+}
+
+std::string SignatureCache::computeEntry(const std::string& txHash,
+                                         uint32_t inputIndex,
+                                         const std::string& publicKey,
+                                         const std::string& signature) const {
+    std::string preimage;
+    preimage.reserve(txHash.size() + publicKey.size() + signature.size() + 16);
+    putField(preimage, txHash);
+    putU32(preimage, inputIndex);
+    putField(preimage, publicKey);
+    putField(preimage, signature);
+    return SHA256::hashWithSalt(preimage, salt);
+}
+
+SignatureCache::Shard& SignatureCache::shardFor(const std::string& entry) {
+    return shards[std::hash<std::string>{}(entry) % SHARD_COUNT];
+}
+
+const SignatureCache::Shard& SignatureCache::shardFor(const std::string& entry) const {
+    return shards[std::hash<std::string>{}(entry) % SHARD_COUNT];
+}
+
+bool SignatureCache::contains(const std::string& entry) const {
+    const Shard& shard = shardFor(entry);
+    std::shared_lock<std::shared_mutex> lock(shard.shardMutex);
+    return shard.entries.count(entry) > 0;
+}
+
+void SignatureCache::insert(const std::string& entry) {
+    Shard& shard = shardFor(entry);
+    std::unique_lock<std::shared_mutex> lock(shard.shardMutex);
+    
+    if (shard.entries.size() >= maxEntriesPerShard && !shard.entries.empty()) {
+        // Entries are salted digests, so the first bucket is effectively a
+        // random victim
+        shard.entries.erase(shard.entries.begin());
+    }
+    shard.entries.insert(entry);
+}
+
+void SignatureCache::erase(const std::string& entry) {
+    Shard& shard = shardFor(entry);
+    std::unique_lock<std::shared_mutex> lock(shard.shardMutex);
+    shard.entries.erase(entry);
+}
+
+size_t SignatureCache::size() const {
+    size_t total = 0;
+    for (const auto& shard : shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.shardMutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
\ No newline at end of file
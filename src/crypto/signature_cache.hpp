@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <array>
+#include <unordered_set>
+#include <shared_mutex>
+
+// Concurrent cache of signatures that have already been verified, shared
+// by mempool admission and block validation so a signature is checked
+// with ECDSA once per node rather than once per validation pass.
+class SignatureCache {
+private:
+    static constexpr size_t SHARD_COUNT = 32;
+    static constexpr size_t DEFAULT_MAX_ENTRIES = 1 << 18;
+    
+    struct Shard {
+        std::unordered_set<std::string> entries;
+        mutable std::shared_mutex shardMutex;
+    };
+    
+    std::array<Shard, SHARD_COUNT> shards;
+    size_t maxEntriesPerShard;
+    
+    // Random per process, so peers cannot craft entries that collide
+    std::string salt;
+    
+    SignatureCache(size_t maxEntries);
+    
+public:
+    static SignatureCache& getInstance();
+    
+    // Entries commit to the (txid, input index) pair together with the key
+    // and signature bytes, so a changed witness never hits a stale entry
+    std::string computeEntry(const std::string& txHash,
+                             uint32_t inputIndex,
+                             const std::string& publicKey,
+                             const std::string& signature) const;
+    
+    bool contains(const std::string& entry) const;
+    void insert(const std::string& entry);
+    void erase(const std::string& entry);
+    size_t size() const;
+    
+private:
+    Shard& shardFor(const std::string& entry);
+    const Shard& shardFor(const std::string& entry) const;
+};
\ No newline at end of file
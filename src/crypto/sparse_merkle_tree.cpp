@@ -0,0 +1,136 @@
+#include "sparse_merkle_tree.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+SparseMerkleTree::SparseMerkleTree(NodeStore& nodesIn) : nodes(nodesIn) {
+}
+
+const std::string& SparseMerkleTree::emptyRoot() {
+    static const std::string empty(64, '0');
+    return empty;
+}
+
+std::string SparseMerkleTree::keyPath(const std::string& key) {
+    return SHA256::hash(key);
+}
+
+std::string SparseMerkleTree::leafHash(const std::string& path, const std::string& value) {
+    // Prefixes keep leaves and interior nodes in separate hash domains
+    return SHA256::hash("L" + path + SHA256::hash(value));
+}
+
+std::string SparseMerkleTree::parentHash(const std::string& left, const std::string& right) {
+    return SHA256::hash("N" + left + right);
+}
+
+bool SparseMerkleTree::pathBit(const std::string& path, size_t depth) {
+    // Paths are hex digests; depth 0 is the most significant bit
+    char c = path[depth / 4];
+    int nibble = (c >= '0' && c <= '9') ? c - '0' : c - 'a' + 10;
+    return (nibble >> (3 - depth % 4)) & 1;
+}
+
+std::string SparseMerkleTree::update(const std::string& root,
+                                     const std::vector<std::pair<std::string, std::string>>& updates) {
+    std::vector<PendingLeaf> leaves;
+    leaves.reserve(updates.size());
+    for (const auto& [key, value] : updates) {
+        leaves.push_back({keyPath(key), value});
+    }
+
+    // Sorted paths put each subtree's updates in one contiguous range; for
+    // repeated keys the last update wins
+    std::stable_sort(leaves.begin(), leaves.end(),
+                     [](const PendingLeaf& a, const PendingLeaf& b) { return a.path < b.path; });
+    std::vector<PendingLeaf> unique;
+    unique.reserve(leaves.size());
+    for (size_t i = 0; i < leaves.size(); i++) {
+        if (i + 1 < leaves.size() && leaves[i + 1].path == leaves[i].path) continue;
+        unique.push_back(std::move(leaves[i]));
+    }
+
+    return updateSubtree(root, 0, unique.begin(), unique.end());
+}
+
+bool SparseMerkleTree::get(const std::string& root, const std::string& key, std::string& value) const {
+    const std::string path = keyPath(key);
+    std::string nodeHash = root;
+    std::string encoded;
+
+    for (size_t depth = 0; depth <= DEPTH && nodeHash != emptyRoot(); depth++) {
+        if (!nodes.getNode(nodeHash, encoded) || encoded.empty()) {
+            throw std::runtime_error("Missing state tree node: " + nodeHash);
+        }
+        
+        const size_t hashSize = nodeHash.size();
+        if (encoded[0] == 'L') {
+            if (encoded.compare(1, hashSize, path) != 0) {
+                return false;
+            }
+            value = encoded.substr(1 + hashSize);
+            return true;
+        }
+        
+        nodeHash = pathBit(path, depth) ? encoded.substr(1 + hashSize, hashSize)
+                                        : encoded.substr(1, hashSize);
+    }
+    return false;
+}
+
+std::string SparseMerkleTree::putLeaf(const PendingLeaf& leaf) {
+    // The value is kept in the leaf so any historical root can be read
+    std::string hash = leafHash(leaf.path, leaf.value);
+    nodes.putNode(hash, "L" + leaf.path + leaf.value);
+    return hash;
+}
+
+std::string SparseMerkleTree::updateSubtree(const std::string& nodeHash,
+                                            size_t depth,
+                                            std::vector<PendingLeaf>::const_iterator begin,
+                                            std::vector<PendingLeaf>::const_iterator end) {
+    if (begin == end) {
+        return nodeHash;
+    }
+
+    std::string left = emptyRoot();
+    std::string right = emptyRoot();
+
+    if (nodeHash == emptyRoot()) {
+        if (end - begin == 1) {
+            return putLeaf(*begin);
+        }
+    } else {
+        std::string encoded;
+        if (!nodes.getNode(nodeHash, encoded) || encoded.empty()) {
+            throw std::runtime_error("Missing state tree node: " + nodeHash);
+        }
+
+        const size_t hashSize = nodeHash.size();
+        if (encoded[0] == 'L') {
+            const std::string path = encoded.substr(1, hashSize);
+            if (end - begin == 1 && begin->path == path) {
+                return putLeaf(*begin);
+            }
+            // Push the existing leaf down until it parts ways with the updates
+            (pathBit(path, depth) ? right : left) = nodeHash;
+        } else {
+            left = encoded.substr(1, hashSize);
+            right = encoded.substr(1 + hashSize, hashSize);
+        }
+    }
+
+    if (depth >= DEPTH) {
+        throw std::runtime_error("State tree path collision");
+    }
+
+    auto split = std::partition_point(begin, end,
+        [depth](const PendingLeaf& leaf) { return !pathBit(leaf.path, depth); });
+
+    left = updateSubtree(left, depth + 1, begin, split);
+    right = updateSubtree(right, depth + 1, split, end);
+
+    std::string hash = parentHash(left, right);
+    nodes.putNode(hash, "N" + left + right);
+    return hash;
+}
\ No newline at end of file
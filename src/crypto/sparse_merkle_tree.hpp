@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Sparse Merkle tree over 256-bit key paths (SHA256 of the key). A subtree
+// holding a single leaf is represented by that leaf, so a lookup or update
+// touches about log2(n) nodes instead of 256. Nodes are content-addressed
+// and never modified: every root ever produced stays readable and an
+// update only hashes the paths it touches.
+class SparseMerkleTree {
+public:
+    static constexpr size_t DEPTH = 256;
+
+    // Backing store for encoded nodes:
+    //   leaf:     'L' || key path || value
+    //   interior: 'N' || left child hash || right child hash
+    class NodeStore {
+    public:
+        virtual ~NodeStore() = default;
+        virtual bool getNode(const std::string& hash, std::string& encoded) = 0;
+        virtual void putNode(const std::string& hash, const std::string& encoded) = 0;
+    };
+
+    explicit SparseMerkleTree(NodeStore& nodesIn);
+
+    static const std::string& emptyRoot();
+
+    // Applies (key, value) updates to the tree rooted at root and returns
+    // the new root. Updates sharing a path prefix share its rehashing.
+    std::string update(const std::string& root,
+                       const std::vector<std::pair<std::string, std::string>>& updates);
+
+    // Reads a key as of root. Any root ever returned by update() can be
+    // read, concurrently with updates, as long as the store is thread-safe.
+    bool get(const std::string& root, const std::string& key, std::string& value) const;
+
+    static std::string keyPath(const std::string& key);
+    static std::string leafHash(const std::string& path, const std::string& value);
+
+private:
+    struct PendingLeaf {
+        std::string path;
+        std::string value;
+    };
+
+    NodeStore& nodes;
+
+    std::string updateSubtree(const std::string& nodeHash,
+                              size_t depth,
+                              std::vector<PendingLeaf>::const_iterator begin,
+                              std::vector<PendingLeaf>::const_iterator end);
+
+    std::string putLeaf(const PendingLeaf& leaf);
+    static std::string parentHash(const std::string& left, const std::string& right);
+    static bool pathBit(const std::string& path, size_t depth);
+};
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "stream_cipher.hpp"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <stdexcept>
+#include <algorithm>
+#include <unistd.h>
+
+namespace {
+    constexpr size_t NONCE_SIZE = 12;
+
+    std::array<uint8_t, NONCE_SIZE> chunkNonce(const uint8_t* prefix, uint32_t index, bool isFinal) {
+        std::array<uint8_t, NONCE_SIZE> nonce{};
+        std::copy(prefix, prefix + StreamCipher::NONCE_PREFIX_SIZE, nonce.begin());
+        nonce[7] = static_cast<uint8_t>(index >> 24);
+        nonce[8] = static_cast<uint8_t>(index >> 16);
+        nonce[9] = static_cast<uint8_t>(index >> 8);
+        nonce[10] = static_cast<uint8_t>(index);
+        nonce[11] = isFinal ? 1 : 0;
+        return nonce;
+    }
+
+    void validateKey(const std::vector<uint8_t>& key) {
+        if (key.size() != StreamCipher::KEY_SIZE) {
+            throw std::invalid_argument("Stream cipher key must be 32 bytes");
+        }
+    }
+
+    void writeFully(int fd, const uint8_t* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = write(fd, data, length);
+            if (n <= 0) {
+                throw std::runtime_error("Failed to write stream output");
+            }
+            data += n;
+            length -= n;
+        }
+    }
+
+    template<typename Stage>
+    void pumpFd(int inFd, Stage& stage, size_t bufferSize) {
+        std::vector<uint8_t> buffer(bufferSize);
+        while (true) {
+            ssize_t n = read(inFd, buffer.data(), buffer.size());
+            if (n < 0) {
+                throw std::runtime_error("Failed to read stream input");
+            }
+            if (n == 0) break;
+            stage.update(buffer.data(), static_cast<size_t>(n));
+        }
+        stage.finish();
+    }
+}
+
+StreamEncryptor::StreamEncryptor(const std::vector<uint8_t>& key,
+                                 StreamCipher::Sink sinkIn,
+                                 size_t chunkSizeIn)
+    : ctx(nullptr),
+      chunkSize(chunkSizeIn),
+      chunkIndex(0),
+      headerWritten(false),
+      finished(false),
+      sink(std::move(sinkIn)) {
+    validateKey(key);
+    if (chunkSize == 0 || chunkSize > StreamCipher::MAX_CHUNK_SIZE) {
+        throw std::invalid_argument("Invalid stream chunk size");
+    }
+
+    // The key schedule is set up once; each chunk only supplies a nonce
+    ctx = EVP_CIPHER_CTX_new();
+    if (!ctx ||
+        EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1 ||
+        EVP_EncryptInit_ex(ctx, nullptr, nullptr, key.data(), nullptr) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        throw std::runtime_error("Failed to initialize stream cipher");
+    }
+
+    pending.reserve(chunkSize);
+    sealed.reserve(chunkSize + StreamCipher::TAG_SIZE);
+    reset();
+}
+
+StreamEncryptor::~StreamEncryptor() {
+    EVP_CIPHER_CTX_free(ctx);
+}
+
+void StreamEncryptor::reset() {
+    header[0] = StreamCipher::VERSION;
+    for (int i = 0; i < 4; i++) {
+        header[1 + i] = static_cast<uint8_t>((chunkSize >> (8 * i)) & 0xff);
+    }
+    if (RAND_bytes(header.data() + 5, StreamCipher::NONCE_PREFIX_SIZE) != 1) {
+        throw std::runtime_error("Failed to generate stream nonce");
+    }
+
+    pending.clear();
+    chunkIndex = 0;
+    headerWritten = false;
+    finished = false;
+}
+
+void StreamEncryptor::update(const uint8_t* data, size_t length) {
+    if (finished) {
+        throw std::runtime_error("Stream already finished");
+    }
+    if (!headerWritten) {
+        sink(header.data(), header.size());
+        headerWritten = true;
+    }
+
+    // A full chunk is only sealed once more data follows it, since the
+    // last chunk must carry the final flag
+    size_t offset = 0;
+    if (!pending.empty()) {
+        size_t take = std::min(chunkSize - pending.size(), length);
+        pending.insert(pending.end(), data, data + take);
+        offset = take;
+        if (pending.size() == chunkSize && offset < length) {
+            sealChunk(pending.data(), pending.size(), false);
+            pending.clear();
+        }
+    }
+
+    // Whole chunks go straight from the input without buffering
+    while (length - offset > chunkSize) {
+        sealChunk(data + offset, chunkSize, false);
+        offset += chunkSize;
+    }
+    pending.insert(pending.end(), data + offset, data + length);
+}
+
+void StreamEncryptor::finish() {
+    if (finished) {
+        throw std::runtime_error("Stream already finished");
+    }
+    if (!headerWritten) {
+        sink(header.data(), header.size());
+        headerWritten = true;
+    }
+
+    sealChunk(pending.data(), pending.size(), true);
+    pending.clear();
+    finished = true;
+}
+
+void StreamEncryptor::sealChunk(const uint8_t* data, size_t length, bool isFinal) {
+    auto nonce = chunkNonce(header.data() + 5, chunkIndex, isFinal);
+    int outLength = 0;
+    int finalLength = 0;
+    sealed.resize(length + StreamCipher::TAG_SIZE);
+
+    if (EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce.data()) != 1 ||
+        EVP_EncryptUpdate(ctx, nullptr, &outLength, header.data(), header.size()) != 1 ||
+        (length > 0 && EVP_EncryptUpdate(ctx, sealed.data(), &outLength, data, length) != 1) ||
+        EVP_EncryptFinal_ex(ctx, sealed.data() + length, &finalLength) != 1 ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, StreamCipher::TAG_SIZE,
+                            sealed.data() + length) != 1) {
+        throw std::runtime_error("Failed to encrypt stream chunk");
+    }
+
+    sink(sealed.data(), sealed.size());
+
+    if (chunkIndex == UINT32_MAX) {
+        throw std::runtime_error("Stream exceeds the maximum chunk count");
+    }
+    chunkIndex++;
+}
+
+StreamDecryptor::StreamDecryptor(const std::vector<uint8_t>& keyIn, StreamCipher::Sink sinkIn)
+    : ctx(nullptr),
+      headerBytes(0),
+      chunkSize(0),
+      chunkIndex(0),
+      finished(false),
+      sink(std::move(sinkIn)) {
+    validateKey(keyIn);
+
+    ctx = EVP_CIPHER_CTX_new();
+    if (!ctx ||
+        EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) != 1 ||
+        EVP_DecryptInit_ex(ctx, nullptr, nullptr, keyIn.data(), nullptr) != 1) {
+        EVP_CIPHER_CTX_free(ctx);
+        throw std::runtime_error("Failed to initialize stream cipher");
+    }
+}
+
+StreamDecryptor::~StreamDecryptor() {
+    EVP_CIPHER_CTX_free(ctx);
+}
+
+void StreamDecryptor::update(const uint8_t* data, size_t length) {
+    if (finished) {
+        throw std::runtime_error("Stream already finished");
+    }
+
+    size_t offset = 0;
+    if (headerBytes < header.size()) {
+        size_t take = std::min(header.size() - headerBytes, length);
+        std::copy(data, data + take, header.begin() + headerBytes);
+        headerBytes += take;
+        offset = take;
+        if (headerBytes < header.size()) {
+            return;
+        }
+
+        if (header[0] != StreamCipher::VERSION) {
+            throw std::runtime_error("Unsupported stream version");
+        }
+        chunkSize = 0;
+        for (int i = 0; i < 4; i++) {
+            chunkSize |= static_cast<size_t>(header[1 + i]) << (8 * i);
+        }
+        if (chunkSize == 0 || chunkSize > StreamCipher::MAX_CHUNK_SIZE) {
+            throw std::runtime_error("Invalid stream chunk size");
+        }
+        pending.reserve(chunkSize + StreamCipher::TAG_SIZE);
+        opened.reserve(chunkSize);
+    }
+
+    // Same hold-back rule as encryption: a full sealed chunk may still be
+    // the final one until more data arrives
+    const size_t sealedSize = chunkSize + StreamCipher::TAG_SIZE;
+    if (!pending.empty()) {
+        size_t take = std::min(sealedSize - pending.size(), length - offset);
+        pending.insert(pending.end(), data + offset, data + offset + take);
+        offset += take;
+        if (pending.size() == sealedSize && offset < length) {
+            openChunk(pending.data(), pending.size(), false);
+            pending.clear();
+        }
+    }
+
+    while (length - offset > sealedSize) {
+        openChunk(data + offset, sealedSize, false);
+        offset += sealedSize;
+    }
+    pending.insert(pending.end(), data + offset, data + length);
+}
+
+void StreamDecryptor::finish() {
+    if (finished) {
+        throw std::runtime_error("Stream already finished");
+    }
+    if (headerBytes < header.size() || pending.size() < StreamCipher::TAG_SIZE) {
+        throw std::runtime_error("Truncated stream");
+    }
+
+    openChunk(pending.data(), pending.size(), true);
+    pending.clear();
+    finished = true;
+}
+
+void StreamDecryptor::openChunk(const uint8_t* data, size_t length, bool isFinal) {
+    const size_t cipherLength = length - StreamCipher::TAG_SIZE;
+    auto nonce = chunkNonce(header.data() + 5, chunkIndex, isFinal);
+    int outLength = 0;
+    int finalLength = 0;
+    uint8_t tag[StreamCipher::TAG_SIZE];
+    std::copy(data + cipherLength, data + length, tag);
+    opened.resize(cipherLength);
+
+    if (EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce.data()) != 1 ||
+        EVP_DecryptUpdate(ctx, nullptr, &outLength, header.data(), header.size()) != 1 ||
+        (cipherLength > 0 && EVP_DecryptUpdate(ctx, opened.data(), &outLength, data, cipherLength) != 1) ||
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, StreamCipher::TAG_SIZE, tag) != 1 ||
+        EVP_DecryptFinal_ex(ctx, opened.data() + cipherLength, &finalLength) != 1) {
+        throw std::runtime_error("Stream chunk failed authentication");
+    }
+
+    sink(opened.data(), opened.size());
+
+    if (chunkIndex == UINT32_MAX) {
+        throw std::runtime_error("Stream exceeds the maximum chunk count");
+    }
+    chunkIndex++;
+}
+
+std::vector<uint8_t> StreamCipher::seal(const std::string& plaintext,
+                                        const std::vector<uint8_t>& key,
+                                        size_t chunkSize) {
+    std::vector<uint8_t> payload;
+    size_t chunks = plaintext.size() / chunkSize + 1;
+    payload.reserve(HEADER_SIZE + plaintext.size() + chunks * TAG_SIZE);
+
+    StreamEncryptor encryptor(key, [&payload](const uint8_t* data, size_t length) {
+        payload.insert(payload.end(), data, data + length);
+    }, chunkSize);
+    encryptor.update(plaintext);
+    encryptor.finish();
+    return payload;
+}
+
+std::string StreamCipher::open(const std::vector<uint8_t>& payload,
+                               const std::vector<uint8_t>& key) {
+    std::string plaintext;
+    plaintext.reserve(payload.size());
+
+    StreamDecryptor decryptor(key, [&plaintext](const uint8_t* data, size_t length) {
+        plaintext.append(reinterpret_cast<const char*>(data), length);
+    });
+    decryptor.update(payload.data(), payload.size());
+    decryptor.finish();
+    return plaintext;
+}
+
+void StreamCipher::encryptFd(int inFd, int outFd,
+                             const std::vector<uint8_t>& key,
+                             size_t chunkSize) {
+    StreamEncryptor encryptor(key, [outFd](const uint8_t* data, size_t length) {
+        writeFully(outFd, data, length);
+    }, chunkSize);
+    pumpFd(inFd, encryptor, chunkSize);
+}
+
+void StreamCipher::decryptFd(int inFd, int outFd, const std::vector<uint8_t>& key) {
+    StreamDecryptor decryptor(key, [outFd](const uint8_t* data, size_t length) {
+        writeFully(outFd, data, length);
+    });
+    pumpFd(inFd, decryptor, DEFAULT_CHUNK_SIZE);
+}
\ No newline at end of file
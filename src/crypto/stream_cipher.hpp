@@ -0,0 +1,115 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <array>
+#include <cstdint>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+// Chunked AES-256-GCM streaming (STREAM construction). A payload is a
+// header followed by fixed-size sealed chunks, each ciphertext || tag:
+//
+//   header: version(1) chunkSize(4, LE) noncePrefix(7)
+//   nonce:  noncePrefix(7) chunkIndex(4, BE) finalFlag(1)
+//
+// The chunk index and final flag in the nonce make reordering, dropping
+// or truncating chunks fail authentication; the header is bound to every
+// chunk as associated data. Memory use is bounded by the chunk size, and
+// each chunk is released as soon as it authenticates.
+class StreamCipher {
+public:
+    static constexpr size_t KEY_SIZE = 32;
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr size_t NONCE_PREFIX_SIZE = 7;
+    static constexpr size_t HEADER_SIZE = 1 + 4 + NONCE_PREFIX_SIZE;
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+    static constexpr uint8_t VERSION = 1;
+
+    using Sink = std::function<void(const uint8_t* data, size_t length)>;
+
+    // One-shot helpers over in-memory payloads
+    static std::vector<uint8_t> seal(const std::string& plaintext,
+                                     const std::vector<uint8_t>& key,
+                                     size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    static std::string open(const std::vector<uint8_t>& payload,
+                            const std::vector<uint8_t>& key);
+
+    // Streams between file descriptors in bounded memory
+    static void encryptFd(int inFd, int outFd,
+                          const std::vector<uint8_t>& key,
+                          size_t chunkSize = DEFAULT_CHUNK_SIZE);
+    static void decryptFd(int inFd, int outFd, const std::vector<uint8_t>& key);
+};
+
+// Encrypting stage: plaintext in through update(), sealed bytes out
+// through the sink. One cipher context and key schedule serve every chunk
+// and, after reset(), every following payload.
+class StreamEncryptor {
+private:
+    EVP_CIPHER_CTX* ctx;
+    size_t chunkSize;
+    std::array<uint8_t, StreamCipher::HEADER_SIZE> header;
+    std::vector<uint8_t> pending;
+    std::vector<uint8_t> sealed;
+    uint32_t chunkIndex;
+    bool headerWritten;
+    bool finished;
+    StreamCipher::Sink sink;
+
+public:
+    StreamEncryptor(const std::vector<uint8_t>& key,
+                    StreamCipher::Sink sinkIn,
+                    size_t chunkSizeIn = StreamCipher::DEFAULT_CHUNK_SIZE);
+    ~StreamEncryptor();
+
+    StreamEncryptor(const StreamEncryptor&) = delete;
+    StreamEncryptor& operator=(const StreamEncryptor&) = delete;
+
+    void update(const uint8_t* data, size_t length);
+    void update(const std::string& data) {
+        update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    }
+
+    // Seals the final chunk; must be called exactly once per payload
+    void finish();
+
+    // Starts a new payload under the same key with a fresh nonce prefix
+    void reset();
+
+private:
+    void sealChunk(const uint8_t* data, size_t length, bool isFinal);
+};
+
+// Decrypting stage: sealed bytes in through update(), authenticated
+// plaintext out through the sink chunk by chunk. Throws std::runtime_error
+// on any authentication or framing failure; plaintext already emitted for
+// earlier chunks is authentic but the payload as a whole is not.
+class StreamDecryptor {
+private:
+    EVP_CIPHER_CTX* ctx;
+    std::array<uint8_t, StreamCipher::HEADER_SIZE> header;
+    size_t headerBytes;
+    size_t chunkSize;
+    std::vector<uint8_t> pending;
+    std::vector<uint8_t> opened;
+    uint32_t chunkIndex;
+    bool finished;
+    StreamCipher::Sink sink;
+
+public:
+    StreamDecryptor(const std::vector<uint8_t>& keyIn, StreamCipher::Sink sinkIn);
+    ~StreamDecryptor();
+
+    StreamDecryptor(const StreamDecryptor&) = delete;
+    StreamDecryptor& operator=(const StreamDecryptor&) = delete;
+
+    void update(const uint8_t* data, size_t length);
+
+    // Verifies the final chunk; a payload cut short fails here
+    void finish();
+
+private:
+    void openChunk(const uint8_t* data, size_t length, bool isFinal);
+};
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "block_downloader.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+BlockDownloader::BlockDownloader(const std::string& tipHashIn,
+                                 uint64_t tipHeight,
+                                 RequestFn requestBlocksIn,
+                                 CommitFn commitBlockIn,
+                                 Config configIn)
+    : config(configIn),
+      requestBlocks(std::move(requestBlocksIn)),
+      commitBlock(std::move(commitBlockIn)),
+      startHeight(tipHeight + 1),
+      tipHash(tipHashIn),
+      nextRequestHeight(tipHeight + 1),
+      commitHeight(tipHeight + 1) {
+    if (config.windowSize == 0 || config.batchSize == 0 || config.maxBatchesPerPeer == 0) {
+        throw std::invalid_argument("Download window, batch size and per-peer limit must be positive");
+    }
+}
+
+bool BlockDownloader::addHeaders(const std::vector<BlockHeader>& newHeaders) {
+    const std::string target(config.difficulty, '0');
+    bool valid = true;
+    std::vector<Batch> batches;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        for (const BlockHeader& header : newHeaders) {
+            const uint64_t height = startHeight + headers.size();
+            if (header.index != height ||
+                header.previousHash != tipHash ||
+                header.hash.compare(0, target.size(), target) != 0 ||
+                header.calculateHash() != header.hash ||
+                heightByHash.count(header.hash)) {
+                valid = false;
+                break;
+            }
+
+            heightByHash.emplace(header.hash, height);
+            tipHash = header.hash;
+            headers.push_back(header);
+        }
+        batches = scheduleLocked(Clock::now());
+    }
+
+    issue(batches);
+    return valid;
+}
+
+void BlockDownloader::addPeer(const std::string& peerId) {
+    std::vector<Batch> batches;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (!peers.emplace(peerId, PeerState()).second) {
+            return;
+        }
+        batches = scheduleLocked(Clock::now());
+    }
+    issue(batches);
+}
+
+void BlockDownloader::removePeer(const std::string& peerId) {
+    std::vector<Batch> batches;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        dropPeerLocked(peerId);
+        batches = scheduleLocked(Clock::now());
+    }
+    issue(batches);
+}
+
+bool BlockDownloader::onBlock(const std::string& peerId, Block block) {
+    std::vector<Batch> batches;
+    bool accepted = false;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        auto known = heightByHash.find(block.getHash());
+        if (known == heightByHash.end()) {
+            return false;
+        }
+
+        // Only heights still wanted are accepted, which also bounds the
+        // reorder buffer by the window. A stalled peer's late delivery is
+        // still wanted: the height is queued for retry or out to another
+        // peer.
+        const uint64_t height = known->second;
+        auto request = inFlight.find(height);
+        if (request == inFlight.end() && !retry.count(height)) {
+            return false;
+        }
+
+        const BlockHeader& header = headers[height - startHeight];
+        auto peer = peers.find(peerId);
+        if (block.calculateHash() != header.hash || !block.hasValidMerkleRoot()) {
+            if (request != inFlight.end() && request->second.peerId == peerId) {
+                releaseLocked(height);
+                retry.insert(height);
+            }
+            if (peer != peers.end() && ++peer->second.strikes >= config.maxStrikes) {
+                dropPeerLocked(peerId);
+            }
+        } else {
+            releaseLocked(height);
+            retry.erase(height);
+            if (peer != peers.end()) {
+                peer->second.strikes = 0;
+                peer->second.delivered++;
+            }
+            reorderBuffer.emplace(height, std::move(block));
+            accepted = true;
+        }
+
+        batches = scheduleLocked(Clock::now());
+    }
+
+    issue(batches);
+    if (accepted) {
+        commitReady();
+    }
+    return accepted;
+}
+
+void BlockDownloader::tick(Clock::time_point now) {
+    std::vector<Batch> batches;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+
+        // With the window exhausted everything waits on the lowest missing
+        // height, so that one request is reassigned at half the timeout
+        const bool windowFull = nextRequestHeight >= commitHeight + config.windowSize;
+        const Clock::duration headOfLineTimeout = config.stallTimeout / 2;
+
+        std::set<std::string> stalledPeers;
+        for (auto it = inFlight.begin(); it != inFlight.end();) {
+            const Clock::duration age = now - it->second.sentAt;
+            const bool blocksWindow = windowFull && it->first == commitHeight && age >= headOfLineTimeout;
+            if (age < config.stallTimeout && !blocksWindow) {
+                ++it;
+                continue;
+            }
+
+            auto peer = peers.find(it->second.peerId);
+            if (peer != peers.end()) {
+                peer->second.inFlight--;
+                stalledPeers.insert(peer->first);
+            }
+            retry.insert(it->first);
+            it = inFlight.erase(it);
+        }
+
+        for (const std::string& peerId : stalledPeers) {
+            if (++peers[peerId].strikes >= config.maxStrikes) {
+                dropPeerLocked(peerId);
+            }
+        }
+
+        batches = scheduleLocked(now);
+    }
+    issue(batches);
+}
+
+std::string BlockDownloader::getHeaderTipHash() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return tipHash;
+}
+
+uint64_t BlockDownloader::getHeaderHeight() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return startHeight + headers.size();
+}
+
+uint64_t BlockDownloader::getCommitHeight() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return commitHeight;
+}
+
+size_t BlockDownloader::getBufferedCount() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return reorderBuffer.size();
+}
+
+size_t BlockDownloader::getPeerCount() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return peers.size();
+}
+
+bool BlockDownloader::isComplete() const {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return commitHeight == startHeight + headers.size();
+}
+
+std::vector<BlockDownloader::Batch> BlockDownloader::scheduleLocked(Clock::time_point now) {
+    std::vector<Batch> batches;
+    if (peers.empty()) {
+        return batches;
+    }
+
+    // Peers that have not stalled recently are served first, so retried
+    // heights tend to go to a different peer than the one that lost them
+    std::vector<std::pair<const std::string, PeerState>*> order;
+    order.reserve(peers.size());
+    for (auto& entry : peers) {
+        order.push_back(&entry);
+    }
+    std::sort(order.begin(), order.end(), [](const auto* a, const auto* b) {
+        if (a->second.strikes != b->second.strikes) {
+            return a->second.strikes < b->second.strikes;
+        }
+        return a->second.inFlight < b->second.inFlight;
+    });
+
+    // Round-robin one batch at a time so work spreads across all peers
+    const size_t peerLimit = config.batchSize * config.maxBatchesPerPeer;
+    bool assigned = true;
+    while (assigned) {
+        assigned = false;
+        for (auto* entry : order) {
+            PeerState& peer = entry->second;
+            if (peer.inFlight >= peerLimit) {
+                continue;
+            }
+
+            const size_t batchLimit = std::min(config.batchSize, peerLimit - peer.inFlight);
+            std::vector<std::string> hashes;
+            uint64_t height;
+            while (hashes.size() < batchLimit && nextHeightLocked(height)) {
+                inFlight[height] = {entry->first, now};
+                hashes.push_back(headers[height - startHeight].hash);
+            }
+            if (hashes.empty()) {
+                return batches;
+            }
+
+            peer.inFlight += hashes.size();
+            batches.emplace_back(entry->first, std::move(hashes));
+            assigned = true;
+        }
+    }
+
+    return batches;
+}
+
+bool BlockDownloader::nextHeightLocked(uint64_t& height) {
+    // Retries are always below nextRequestHeight, so they come first and
+    // the window only advances once nothing earlier is missing
+    if (!retry.empty()) {
+        height = *retry.begin();
+        retry.erase(retry.begin());
+        return true;
+    }
+
+    const uint64_t windowEnd = std::min<uint64_t>(commitHeight + config.windowSize,
+                                                  startHeight + headers.size());
+    if (nextRequestHeight >= windowEnd) {
+        return false;
+    }
+
+    height = nextRequestHeight++;
+    return true;
+}
+
+void BlockDownloader::releaseLocked(uint64_t height) {
+    auto request = inFlight.find(height);
+    if (request == inFlight.end()) {
+        return;
+    }
+
+    auto peer = peers.find(request->second.peerId);
+    if (peer != peers.end()) {
+        peer->second.inFlight--;
+    }
+    inFlight.erase(request);
+}
+
+void BlockDownloader::dropPeerLocked(const std::string& peerId) {
+    for (auto it = inFlight.begin(); it != inFlight.end();) {
+        if (it->second.peerId == peerId) {
+            retry.insert(it->first);
+            it = inFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    peers.erase(peerId);
+}
+
+void BlockDownloader::issue(const std::vector<Batch>& batches) {
+    std::vector<std::string> failedPeers;
+    for (const auto& [peerId, hashes] : batches) {
+        try {
+            requestBlocks(peerId, hashes);
+        } catch (const std::exception&) {
+            failedPeers.push_back(peerId);
+        }
+    }
+
+    // Their requests go back to the queue for the remaining peers
+    for (const std::string& peerId : failedPeers) {
+        removePeer(peerId);
+    }
+}
+
+void BlockDownloader::commitReady() {
+    // Blocks are taken from the buffer only under the commit lock, so
+    // concurrent callers can never hand them on out of order
+    std::lock_guard<std::mutex> commitLock(commitMutex);
+    while (true) {
+        std::vector<Block> ready;
+        std::vector<Batch> batches;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            while (!reorderBuffer.empty() && reorderBuffer.begin()->first == commitHeight) {
+                ready.push_back(std::move(reorderBuffer.begin()->second));
+                reorderBuffer.erase(reorderBuffer.begin());
+                commitHeight++;
+            }
+            if (ready.empty()) {
+                return;
+            }
+
+            // The window moved forward
+            batches = scheduleLocked(Clock::now());
+        }
+
+        issue(batches);
+        for (Block& block : ready) {
+            commitBlock(std::move(block));
+        }
+    }
+}
\ No newline at end of file
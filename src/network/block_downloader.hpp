@@ -0,0 +1,127 @@
+#pragma once
+#include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include "../core/block.hpp"
+
+// Headers-first catch-up. The header chain is fetched and checked first;
+// bodies are then requested by hash in small batches from every peer at
+// once, within a sliding window ahead of the commit point. Bodies that
+// arrive out of order wait in a reorder buffer and are handed on strictly
+// in height order. Batches a peer has not delivered within the stall
+// timeout go back to the queue for another peer, and a peer that keeps
+// stalling is dropped.
+//
+// The downloader does no I/O itself: requests go out through RequestFn
+// and in-order blocks through CommitFn, both called without the internal
+// lock held.
+class BlockDownloader {
+public:
+    using Clock = std::chrono::steady_clock;
+    using RequestFn = std::function<void(const std::string& peerId,
+                                         const std::vector<std::string>& blockHashes)>;
+    using CommitFn = std::function<void(Block&& block)>;
+
+    struct Config {
+        size_t windowSize = 1024;           // Heights past the commit point in flight or buffered
+        size_t batchSize = 16;              // Blocks per request
+        size_t maxBatchesPerPeer = 4;       // Outstanding requests per peer
+        std::chrono::milliseconds stallTimeout{5000};
+        uint32_t maxStrikes = 3;            // Consecutive stalls before a peer is dropped
+        uint32_t difficulty = 0;            // Leading zeros every header hash must have
+    };
+
+private:
+    struct PeerState {
+        size_t inFlight = 0;                // Heights requested and not yet delivered
+        uint32_t strikes = 0;
+        uint64_t delivered = 0;
+    };
+
+    struct Request {
+        std::string peerId;
+        Clock::time_point sentAt;
+    };
+
+    using Batch = std::pair<std::string, std::vector<std::string>>;
+
+    Config config;
+    RequestFn requestBlocks;
+    CommitFn commitBlock;
+
+    // Headers for heights startHeight, startHeight + 1, ...
+    const uint64_t startHeight;
+    std::vector<BlockHeader> headers;
+    std::unordered_map<std::string, uint64_t> heightByHash;
+    std::string tipHash;
+
+    std::unordered_map<std::string, PeerState> peers;
+    std::map<uint64_t, Request> inFlight;
+    std::set<uint64_t> retry;               // Heights taken back from stalled or lost peers
+    std::map<uint64_t, Block> reorderBuffer;
+    uint64_t nextRequestHeight;             // Lowest height never requested
+    uint64_t commitHeight;                  // Next height to hand to CommitFn
+
+    mutable std::mutex stateMutex;
+
+    // Serializes CommitFn calls so blocks leave in height order
+    std::mutex commitMutex;
+
+public:
+    // The chain tip is the last block already held: its hash and height
+    BlockDownloader(const std::string& tipHashIn,
+                    uint64_t tipHeight,
+                    RequestFn requestBlocksIn,
+                    CommitFn commitBlockIn,
+                    Config configIn);
+    BlockDownloader(const std::string& tipHashIn,
+                    uint64_t tipHeight,
+                    RequestFn requestBlocksIn,
+                    CommitFn commitBlockIn)
+        : BlockDownloader(tipHashIn, tipHeight, std::move(requestBlocksIn),
+                          std::move(commitBlockIn), Config()) {}
+
+    BlockDownloader(const BlockDownloader&) = delete;
+    BlockDownloader& operator=(const BlockDownloader&) = delete;
+
+    // Extends the header chain. Headers must continue from the current
+    // header tip; returns false and keeps nothing past the first header
+    // that does not link or does not hash correctly.
+    bool addHeaders(const std::vector<BlockHeader>& newHeaders);
+
+    void addPeer(const std::string& peerId);
+
+    // Requests outstanding at the peer are reassigned
+    void removePeer(const std::string& peerId);
+
+    // Accepts a body from a peer. Returns false for blocks that are not
+    // wanted or do not match their header; a mismatch counts against the
+    // peer and the height is requested again.
+    bool onBlock(const std::string& peerId, Block block);
+
+    // Reassigns stalled requests and tops up every peer's requests
+    void tick(Clock::time_point now = Clock::now());
+
+    // Hash to ask peers for headers after
+    std::string getHeaderTipHash() const;
+    uint64_t getHeaderHeight() const;
+
+    // Next height to be committed
+    uint64_t getCommitHeight() const;
+    size_t getBufferedCount() const;
+    size_t getPeerCount() const;
+    bool isComplete() const;
+
+private:
+    std::vector<Batch> scheduleLocked(Clock::time_point now);
+    bool nextHeightLocked(uint64_t& height);
+    void releaseLocked(uint64_t height);
+    void dropPeerLocked(const std::string& peerId);
+    void issue(const std::vector<Batch>& batches);
+    void commitReady();
+};
\ No newline at end of file
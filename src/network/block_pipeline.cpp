@@ -0,0 +1,170 @@
+#include "block_pipeline.hpp"
+#include "../utils/tracer.hpp"
+
+BlockPipeline::BlockPipeline(std::shared_ptr<Blockchain> blockchainIn, CommitCallback onCommitIn)
+    : blockchain(std::move(blockchainIn)),
+      onCommit(std::move(onCommitIn)),
+      nextSequence(0),
+      delivering(false),
+      tasks(ThreadPool::getInstance()) {
+}
+
+BlockPipeline::~BlockPipeline() {
+    tasks.wait();
+}
+
+std::future<bool> BlockPipeline::submit(Block block, bool relay) {
+    std::shared_ptr<PipelineEntry> entry;
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        entry = std::make_shared<PipelineEntry>(nextSequence++, std::move(block), relay);
+        entries[entry->sequence] = entry;
+    }
+    
+    std::future<bool> result = entry->result.get_future();
+    tasks.run([this, entry]() { runStatelessStage(entry); });
+    return result;
+}
+
+size_t BlockPipeline::getInFlightCount() {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    return entries.size();
+}
+
+void BlockPipeline::runStatelessStage(std::shared_ptr<PipelineEntry> entry) {
+    // Needs no chain state, so any number of blocks can be here at once
+    bool valid = blockchain->validateBlockStateless(entry->block);
+    
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        entry->stage = valid ? Stage::STATELESS_OK : Stage::FAILED;
+        advance();
+    }
+    deliverCommitted();
+}
+
+void BlockPipeline::runConsensusStage(std::shared_ptr<PipelineEntry> entry) {
+    bool approved = blockchain->reachConsensus(entry->block);
+    
+    {
+        std::lock_guard<std::mutex> lock(pipelineMutex);
+        
+        // A rollback may already have discarded this entry
+        if (entry->stage == Stage::SPECULATIVE) {
+            if (approved) {
+                entry->stage = Stage::CONSENSUS_OK;
+            } else {
+                rollbackFrom(entry->sequence);
+            }
+        }
+        advance();
+    }
+    deliverCommitted();
+}
+
+void BlockPipeline::advance() {
+    // Ordered state checks: every earlier block must have settled first
+    for (auto& [sequence, entry] : entries) {
+        if (entry->stage == Stage::STATELESS) break;
+        if (entry->stage != Stage::STATELESS_OK) continue;
+        
+        if (!blockchain->validateBlockState(entry->block, &overlay)) {
+            entry->stage = Stage::FAILED;
+            continue;
+        }
+        
+        // Apply speculatively so the next block is checked against it
+        blockchain->collectBalanceDeltas(entry->block, entry->balanceDeltas);
+        for (const auto& [address, delta] : entry->balanceDeltas) {
+            overlay.balanceDeltas[address] += delta;
+        }
+        overlay.tipHash = entry->block.getHash();
+        entry->stage = Stage::SPECULATIVE;
+        
+        tasks.run([this, entry]() { runConsensusStage(entry); });
+    }
+    
+    // In-order commit from the front of the pipeline
+    while (!entries.empty()) {
+        std::shared_ptr<PipelineEntry> front = entries.begin()->second;
+        
+        if (front->stage == Stage::FAILED) {
+            front->result.set_value(false);
+        } else if (front->stage == Stage::CONSENSUS_OK) {
+            blockchain->commitBlock(front->block);
+            front->height = blockchain->getChainLength() - 1;
+            
+            // Now part of the chain, so drop it from the overlay
+            removeFromOverlay(*front);
+            if (overlay.tipHash == front->block.getHash()) {
+                overlay.tipHash.clear();
+            }
+            committedQueue.push_back(front);
+        } else {
+            break;
+        }
+        
+        entries.erase(entries.begin());
+    }
+}
+
+void BlockPipeline::rollbackFrom(uint64_t sequence) {
+    // Everything speculatively stacked on the rejected block is invalid too
+    std::string newTip;
+    for (auto& [entrySequence, entry] : entries) {
+        bool applied = entry->stage == Stage::SPECULATIVE || entry->stage == Stage::CONSENSUS_OK;
+        if (!applied) continue;
+        
+        if (entrySequence < sequence) {
+            newTip = entry->block.getHash();
+            continue;
+        }
+        
+        removeFromOverlay(*entry);
+        entry->stage = Stage::FAILED;
+    }
+    
+    // An empty tip falls back to the committed chain tip
+    overlay.tipHash = newTip;
+}
+
+void BlockPipeline::removeFromOverlay(const PipelineEntry& entry) {
+    for (const auto& [address, delta] : entry.balanceDeltas) {
+        double& aggregate = overlay.balanceDeltas[address];
+        aggregate -= delta;
+        if (aggregate == 0) {
+            overlay.balanceDeltas.erase(address);
+        }
+    }
+}
+
+void BlockPipeline::deliverCommitted() {
+    std::unique_lock<std::mutex> lock(pipelineMutex);
+    if (delivering) {
+        // The thread already delivering will pick up what was queued
+        return;
+    }
+    delivering = true;
+    
+    while (!committedQueue.empty()) {
+        std::shared_ptr<PipelineEntry> entry = std::move(committedQueue.front());
+        committedQueue.pop_front();
+        lock.unlock();
+        
+        {
+            TRACE_SPAN("pipeline.relay", Tracer::traceIdFor(entry->block.getHash()));
+            if (onCommit) {
+                // The block is committed either way; a failing callback
+                // must not stall delivery of the blocks behind it
+                try {
+                    onCommit(entry->block, entry->height, entry->relay);
+                } catch (const std::exception&) {
+                }
+            }
+        }
+        entry->result.set_value(true);
+        
+        lock.lock();
+    }
+    delivering = false;
+}
\ No newline at end of file
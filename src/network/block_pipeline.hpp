@@ -0,0 +1,85 @@
+#pragma once
+#include <map>
+#include <deque>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <functional>
+#include "../core/blockchain.hpp"
+#include "../utils/thread_pool.hpp"
+
+// Staged block acceptance. Blocks move through
+//   stateless checks + signature batch -> state check -> consensus -> commit -> relay
+// and different blocks can occupy different stages at once. Stateless work
+// runs in any order; state checks run in submission order against a
+// speculative overlay of the blocks ahead of the chain tip, and commits
+// are applied strictly in order.
+class BlockPipeline {
+public:
+    // Called once per committed block with the height it was committed at
+    // and whether it was submitted for relay, one block at a time and in
+    // commit order
+    using CommitCallback = std::function<void(const Block&, uint64_t height, bool relay)>;
+    
+private:
+    enum class Stage {
+        STATELESS,      // Hash and signature checks running
+        STATELESS_OK,   // Waiting for its turn at the state check
+        SPECULATIVE,    // Applied to the overlay, consensus running
+        CONSENSUS_OK,   // Waiting for its turn to commit
+        FAILED
+    };
+    
+    struct PipelineEntry {
+        uint64_t sequence;
+        Block block;
+        Stage stage;
+        uint64_t height;        // Chain height, set when committed
+        bool relay;
+        std::unordered_map<std::string, double> balanceDeltas;
+        std::promise<bool> result;
+        
+        PipelineEntry(uint64_t sequenceIn, Block blockIn, bool relayIn)
+            : sequence(sequenceIn), block(std::move(blockIn)), stage(Stage::STATELESS), height(0), relay(relayIn) {}
+    };
+    
+    std::shared_ptr<Blockchain> blockchain;
+    CommitCallback onCommit;
+    
+    // Guards the entries, the overlay and all access to blockchain state
+    std::mutex pipelineMutex;
+    std::map<uint64_t, std::shared_ptr<PipelineEntry>> entries;
+    StateOverlay overlay;
+    uint64_t nextSequence;
+    
+    // Committed blocks waiting for their callback. Whichever thread finds
+    // delivering unset drains the queue, so callbacks never overlap.
+    std::deque<std::shared_ptr<PipelineEntry>> committedQueue;
+    bool delivering;
+    
+    ThreadPool::TaskGroup tasks;
+    
+public:
+    BlockPipeline(std::shared_ptr<Blockchain> blockchainIn, CommitCallback onCommitIn);
+    ~BlockPipeline();
+    
+    // Resolves to true once the block is committed, false if it is
+    // rejected. Blocks the network already has, such as those fetched
+    // during catch-up, are submitted with relay unset.
+    std::future<bool> submit(Block block, bool relay = true);
+    
+    size_t getInFlightCount();
+    
+private:
+    void runStatelessStage(std::shared_ptr<PipelineEntry> entry);
+    void runConsensusStage(std::shared_ptr<PipelineEntry> entry);
+    
+    // Moves entries through the ordered stages and queues newly committed
+    // blocks for delivery; called with the lock held
+    void advance();
+    void rollbackFrom(uint64_t sequence);
+    void removeFromOverlay(const PipelineEntry& entry);
+    
+    // Runs the queued callbacks unlocked; takes and releases the lock itself
+    void deliverCommitted();
+};
\ No newline at end of file
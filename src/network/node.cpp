@@ -1,25 +1,63 @@
 #include "node.hpp"
+#include "p2p_network.hpp"
+#include "protocol.hpp"
+#include "../utils/tracer.hpp"
+#include "../utils/thread_pool.hpp"
 #include <chrono>
 #include <algorithm>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t MEMORY_POOL_SIZE = 500000;
+    constexpr std::chrono::seconds MEMORY_POOL_MAX_AGE{3600};
+    constexpr size_t TRANSACTION_QUEUE_CAPACITY = 1 << 16;
+    
+    // Longest the validation thread sleeps with nothing pending, so it
+    // notices isValidating changes
+    constexpr std::chrono::milliseconds IDLE_WAKE_INTERVAL{1000};
+    
+    // The sync thread checks for stalled downloads every tick and starts a
+    // new sync round every interval
+    constexpr std::chrono::milliseconds SYNC_TICK_INTERVAL{200};
+    constexpr std::chrono::seconds SYNC_INTERVAL{30};
+    constexpr std::chrono::seconds HEADERS_TIMEOUT{10};
+}
 
 Node::Node(const std::string& nodeIdIn, uint16_t port)
     : nodeId(nodeIdIn),
       blockchain(std::make_shared<Blockchain>()),
       wallet(std::make_shared<Wallet>()),
-      network(std::make_unique<P2PNetwork>(nodeId, port)),
-      running(false) {
-    
-    state = {false, false, 0, std::time(nullptr)};
-}
+      network(std::make_unique<P2PNetwork>(
+          nodeId, port, blockchain,
+          [this](const std::string& peerId, const std::vector<BlockHeader>& headers) {
+              onHeadersReceived(peerId, headers);
+          },
+          [this](const std::string& peerId, Block block) { onBlockReceived(peerId, std::move(block)); })),
+      messageIndex(std::make_unique<MessageIndex>(nodeIdIn + "_messages.log")),
+      memoryPool(std::make_unique<MemoryPool>(MEMORY_POOL_SIZE)),
+      state{false, false, 0, std::time(nullptr)},
+      blockPipeline(std::make_unique<BlockPipeline>(
+          blockchain, [this](const Block& block, uint64_t height, bool relay) {
+              onBlockCommitted(block, height, relay);
+          })),
+      running(false),
+      pendingTransactions(TRANSACTION_QUEUE_CAPACITY),
+      awaitingHeaders(false),
+      syncRound(0) {}
 
 Node::~Node() {
     stop();
+    
+    if (Tracer::getInstance()->isEnabled()) {
+        Tracer::getInstance()->flush();
+    }
 }
 
 void Node::start() {
     if (running) return;
     
     running = true;
+    pendingTransactions.resume();
     network->start();
     
     // Start validation and sync threads
@@ -30,36 +68,196 @@ void Node::start() {
     syncBlockchain();
 }
 
+void Node::stop() {
+    if (!running.exchange(false)) return;
+    
+    pendingTransactions.interrupt();
+    if (validationThread.joinable()) validationThread.join();
+    if (syncThread.joinable()) syncThread.join();
+    network->stop();
+}
+
 void Node::validationLoop() {
+    using Clock = std::chrono::steady_clock;
+    
+    // Sleeps until a transaction arrives or the block deadline passes. A
+    // block is cut when the pool reaches the count or byte trigger, or
+    // when the oldest pending transaction has waited MAX_BLOCK_DELAY.
+    Clock::time_point blockDeadline = Clock::time_point::max();
     while (running) {
-        if (state.isValidating) {
-            // Process pending transactions
-            processTransactions();
-            
-            // Create new block if enough transactions
-            if (pendingTransactions.size() >= blockchain->getMinTransactionsPerBlock()) {
+        pendingTransactions.waitUntil(std::min(blockDeadline, Clock::now() + IDLE_WAKE_INTERVAL));
+        if (!running) break;
+        
+        processTransactions();
+        if (!state.isValidating) continue;
+        
+        const Clock::time_point now = Clock::now();
+        if (memoryPool->size() == 0) {
+            blockDeadline = Clock::time_point::max();
+            continue;
+        }
+        if (blockDeadline == Clock::time_point::max()) {
+            blockDeadline = now + MAX_BLOCK_DELAY;
+        }
+        
+        if (memoryPool->size() >= blockchain->getMinTransactionsPerBlock() ||
+            memoryPool->getTotalBytes() >= MAX_BLOCK_BYTES ||
+            now >= blockDeadline) {
+            try {
                 createAndBroadcastBlock();
+            } catch (const std::exception& e) {
+                // Rejected transactions have been evicted; anything else
+                // stays pooled for the next attempt
             }
+            blockDeadline = memoryPool->size() > 0 ? Clock::now() + MAX_BLOCK_DELAY
+                                                   : Clock::time_point::max();
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 }
 
 void Node::syncLoop() {
+    using Clock = std::chrono::steady_clock;
+    
+    // start() has already begun the first round
+    Clock::time_point nextSync = Clock::now() + SYNC_INTERVAL;
     while (running) {
-        if (!state.isSynced()) {
+        const Clock::time_point now = Clock::now();
+        
+        // Requests a peer has sat on are reassigned here
+        if (std::shared_ptr<BlockDownloader> downloader = currentDownloader()) {
+            downloader->tick(now);
+        }
+        updateSyncState();
+        
+        if (now >= nextSync) {
             syncBlockchain();
+            handleOrphanBlocks();
+            
+            // Age expiry scans the whole pool, so it runs here rather than
+            // on every insert
+            memoryPool->cleanup(static_cast<uint32_t>(MEMORY_POOL_MAX_AGE.count()));
+            
+            // Update node state
+            state.lastUpdate = std::time(nullptr);
+            nextSync = now + SYNC_INTERVAL;
         }
         
-        // Handle orphan blocks
-        handleOrphanBlocks();
+        std::this_thread::sleep_for(SYNC_TICK_INTERVAL);
+    }
+}
+
+void Node::syncBlockchain() {
+    const std::vector<std::string> peerIds = network->getPeerIds();
+    if (peerIds.empty()) return;
+    
+    // Blocks from the last round still in the pipeline would be fetched
+    // again from a stale tip
+    if (blockPipeline->getInFlightCount() > 0) return;
+    
+    std::shared_ptr<BlockDownloader> downloader;
+    std::string headersPeer;
+    {
+        std::lock_guard<std::mutex> lock(syncMutex);
+        if (blockDownloader && !blockDownloader->isComplete()) return;
+        if (blockDownloader && awaitingHeaders &&
+            std::chrono::steady_clock::now() < headersDeadline) return;
         
-        // Update node state
-        state.lastUpdate = std::time(nullptr);
+        blockDownloader = std::make_shared<BlockDownloader>(
+            blockchain->getLatestBlock().getHash(),
+            blockchain->getChainLength() - 1,
+            [this](const std::string& peerId, const std::vector<std::string>& blockHashes) {
+                network->requestBlocks(peerId, blockHashes);
+            },
+            [this](Block&& block) { queueBlock(std::move(block), false); });
+        awaitingHeaders = true;
+        headersDeadline = std::chrono::steady_clock::now() + HEADERS_TIMEOUT;
+        state.isSyncing = true;
         
-        std::this_thread::sleep_for(std::chrono::seconds(30));
+        // Headers come from one peer per round, rotating so a peer that
+        // withholds them is only asked every few rounds
+        headersPeer = peerIds[syncRound++ % peerIds.size()];
+        downloader = blockDownloader;
+    }
+    
+    for (const std::string& peerId : peerIds) {
+        downloader->addPeer(peerId);
+    }
+    requestHeadersFrom(headersPeer, *downloader);
+}
+
+void Node::sendMessage(const ProtocolMessage& message) {
+    network->processMessage(message);
+}
+
+void Node::onHeadersReceived(const std::string& peerId, const std::vector<BlockHeader>& headers) {
+    std::shared_ptr<BlockDownloader> downloader = currentDownloader();
+    if (!downloader) return;
+    
+    // Bodies for these heights are requested from every peer as soon as
+    // the headers are accepted
+    if (!downloader->addHeaders(headers)) {
+        downloader->removePeer(peerId);
+        std::lock_guard<std::mutex> lock(syncMutex);
+        awaitingHeaders = false;
+        return;
+    }
+    
+    if (headers.size() >= NetworkProtocol::MAX_HEADERS_PER_MESSAGE) {
+        {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            headersDeadline = std::chrono::steady_clock::now() + HEADERS_TIMEOUT;
+        }
+        requestHeadersFrom(peerId, *downloader);
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(syncMutex);
+    awaitingHeaders = false;
+}
+
+void Node::onBlockReceived(const std::string& peerId, Block block) {
+    std::shared_ptr<BlockDownloader> downloader = currentDownloader();
+    if (downloader && !downloader->isComplete()) {
+        // The downloader hands blocks to the pipeline in height order
+        downloader->onBlock(peerId, std::move(block));
+        return;
+    }
+    
+    queueBlock(std::move(block));
+}
+
+void Node::requestHeadersFrom(const std::string& peerId, BlockDownloader& downloader) {
+    try {
+        network->requestHeaders(peerId, downloader.getHeaderTipHash(),
+                                NetworkProtocol::MAX_HEADERS_PER_MESSAGE);
+    } catch (const std::exception&) {
+        // The peer is gone; the next round asks another one
+        downloader.removePeer(peerId);
+        std::lock_guard<std::mutex> lock(syncMutex);
+        awaitingHeaders = false;
+    }
+}
+
+void Node::updateSyncState() {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    
+    // A peer that never answers must not leave the node syncing; the
+    // next round asks another one
+    if (awaitingHeaders && std::chrono::steady_clock::now() >= headersDeadline) {
+        awaitingHeaders = false;
     }
+    state.isSyncing = blockDownloader && (awaitingHeaders || !blockDownloader->isComplete());
+}
+
+std::shared_ptr<BlockDownloader> Node::currentDownloader() const {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    return blockDownloader;
+}
+
+bool Node::isSynced() const {
+    // Written by the sync thread, read from pipeline and caller threads
+    std::lock_guard<std::mutex> lock(syncMutex);
+    return !state.isSyncing;
 }
 
 void Node::submitTransaction(const Transaction& transaction) {
@@ -67,31 +265,124 @@ void Node::submitTransaction(const Transaction& transaction) {
         throw std::runtime_error("Invalid transaction");
     }
     
-    // Add to pending transactions
-    pendingTransactions.push(transaction);
+    // Add to pending transactions; the push wakes the validation thread
+    if (!pendingTransactions.tryPush(transaction)) {
+        throw std::runtime_error("Transaction queue full");
+    }
     
     // Broadcast to network
     network->broadcastTransaction(transaction);
 }
 
-void Node::validateAndAddBlock(const Block& block) {
-    if (!blockchain->validateBlock(block)) {
-        throw std::runtime_error("Invalid block");
+void Node::processTransactions() {
+    // Move submitted transactions into the pool, where they are ranked
+    // for the next block
+    Transaction next(TransactionType::FINANCIAL);
+    while (pendingTransactions.tryPop(next)) {
+        memoryPool->addTransaction(next);
+    }
+}
+
+void Node::createAndBroadcastBlock() {
+    std::shared_ptr<const BlockTemplate> blockTemplate =
+        memoryPool->buildTemplate(MAX_BLOCK_BYTES, MAX_BLOCK_GAS);
+    if (blockTemplate->transactions.empty()) {
+        return;
     }
     
+    const std::string tipHash = blockchain->getLatestBlock().getHash();
+    Block block(static_cast<uint32_t>(blockchain->getChainLength()),
+                blockTemplate->transactions,
+                tipHash);
+    
+    // Committing removes the block's transactions from the pool and
+    // relays the block
     try {
-        blockchain->addBlock(block);
-        state.lastBlockHeight = blockchain->getChainLength();
-        
-        // Remove processed transactions from pending queue
-        for (const auto& tx : block.getTransactions()) {
-            removePendingTransaction(tx.getHash());
-        }
-        
-        // Broadcast block to network
-        broadcastBlock(block);
+        validateAndAddBlock(block);
     } catch (const std::exception& e) {
-        // Handle block addition failure
-        std::cerr << "Failed to add block: " << e.what() << std::endl;
+        // With the tip unchanged the block failed on its contents. Only
+        // the transactions at fault are evicted, with their descendants,
+        // and the rest stay pooled for the next template. If none fails
+        // on its own the validators refused the block as a whole, and
+        // nothing is evicted.
+        if (blockchain->getLatestBlock().getHash() == tipHash) {
+            for (const std::string& txHash : findUnminableTransactions(blockTemplate->transactions, tipHash)) {
+                memoryPool->removeTransaction(txHash);
+            }
+        }
+        throw;
     }
-} 
\ No newline at end of file
+}
+
+std::vector<std::string> Node::findUnminableTransactions(const std::vector<Transaction>& transactions,
+                                                         const std::string& tipHash) const {
+    // Replays the template one transaction at a time on top of the tip,
+    // in template order so each spend is checked against the balances
+    // the transactions before it leave. A transaction that fails its own
+    // checks or overspends is skipped, and its effects never applied.
+    std::vector<std::string> unminable;
+    StateOverlay overlay;
+    const uint32_t index = static_cast<uint32_t>(blockchain->getChainLength());
+    
+    for (const Transaction& transaction : transactions) {
+        Block single(index, {transaction}, tipHash);
+        if (!transaction.isValid() || !blockchain->validateBlockState(single, &overlay)) {
+            unminable.push_back(transaction.getHash());
+            continue;
+        }
+        blockchain->collectBalanceDeltas(single, overlay.balanceDeltas);
+    }
+    return unminable;
+}
+
+void Node::validateAndAddBlock(const Block& block) {
+    const uint64_t traceId = Tracer::traceIdFor(block.getHash());
+    TRACE_SPAN("node.validateAndAddBlock", traceId);
+    
+    if (ThreadPool::getInstance().isWorkerThread()) {
+        throw std::logic_error("validateAndAddBlock must not block a pool worker");
+    }
+    
+    // The pipeline validates once, runs consensus and commits in order
+    if (!blockPipeline->submit(block).get()) {
+        throw std::runtime_error("Invalid block");
+    }
+}
+
+void Node::queueBlock(Block block, bool relay) {
+    // Fire-and-forget during catch-up so several blocks overlap in the
+    // pipeline; rejections surface through the commit callback not firing
+    blockPipeline->submit(std::move(block), relay);
+}
+
+MessageIndex::Page Node::getMessages(const std::string& recipient,
+                                     uint64_t sinceHeight,
+                                     const std::string& cursor,
+                                     size_t limit) const {
+    return messageIndex->query(recipient, sinceHeight, cursor, limit);
+}
+
+MessageIndex::Page Node::getGroupMessages(const std::string& publicKey,
+                                          uint64_t sinceHeight,
+                                          const std::string& cursor,
+                                          size_t limit) const {
+    return messageIndex->queryGroup(publicKey, sinceHeight, cursor, limit);
+}
+
+void Node::onBlockCommitted(const Block& block, uint64_t height, bool relay) {
+    // The pipeline hands over the height the block was committed at; the
+    // chain may already be longer by the time this runs
+    state.lastBlockHeight = height + 1;
+    messageIndex->indexBlock(block, height);
+    
+    // Confirmed transactions leave the pool, along with anything that
+    // conflicts with them
+    memoryPool->removeForBlock(block.getTransactions());
+    
+    // Blocks fetched during catch-up are already known to the network
+    if (!relay) return;
+    
+    // Broadcast block to network
+    TRACE_SPAN("node.relayBlock", Tracer::traceIdFor(block.getHash()));
+    broadcastBlock(block);
+}
\ No newline at end of file
@@ -1,32 +1,64 @@
 #pragma once
-#include <queue>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include "../core/blockchain.hpp"
+#include "../core/message_index.hpp"
 #include "../wallet/wallet.hpp"
+#include "../utils/memory_pool.hpp"
+#include "../utils/mpsc_queue.hpp"
+#include "block_pipeline.hpp"
+#include "block_downloader.hpp"
+#include "protocol.hpp"
+
+class P2PNetwork;
 
 class Node {
+public:
+    // Block template budgets
+    static constexpr size_t MAX_BLOCK_BYTES = 1 << 20;
+    static constexpr uint64_t MAX_BLOCK_GAS = 30000000;
+    
+    // A block is cut once pending transactions have waited this long,
+    // even if neither the count nor the byte trigger has fired
+    static constexpr std::chrono::milliseconds MAX_BLOCK_DELAY{1000};
+    
 private:
     std::string nodeId;
     std::shared_ptr<Blockchain> blockchain;
     std::shared_ptr<Wallet> wallet;
     std::unique_ptr<P2PNetwork> network;
+    std::unique_ptr<MessageIndex> messageIndex;
+    std::unique_ptr<MemoryPool> memoryPool;
     
     struct NodeState {
-        bool isSyncing;
+        bool isSyncing;             // Guarded by syncMutex
         bool isValidating;
         uint64_t lastBlockHeight;
         std::time_t lastUpdate;
     } state;
     
+    // Declared after everything onBlockCommitted touches, so it is
+    // destroyed first and its destructor drains in-flight commits while
+    // those members are still alive
+    std::unique_ptr<BlockPipeline> blockPipeline;
+    
     // Threading
     std::thread validationThread;
     std::thread syncThread;
     std::atomic<bool> running;
     
-    // Message queues
-    std::queue<Block> pendingBlocks;
-    std::queue<Transaction> pendingTransactions;
+    // Submitted transactions: any thread produces, the validation thread
+    // consumes
+    BoundedMpscQueue<Transaction> pendingTransactions;
+    
+    // Catch-up state; the downloader is replaced for each sync round
+    mutable std::mutex syncMutex;
+    std::shared_ptr<BlockDownloader> blockDownloader;
+    bool awaitingHeaders;
+    std::chrono::steady_clock::time_point headersDeadline;
+    size_t syncRound;
     
 public:
     Node(const std::string& nodeIdIn, uint16_t port);
@@ -38,17 +70,39 @@ public:
     
     // Blockchain operations
     void syncBlockchain();
+    // Blocks until the pipeline has committed or rejected the block.
+    // Pipeline stages run on the shared thread pool, so this throws
+    // std::logic_error when called from a pool worker instead of tying the
+    // worker up; use queueBlock there.
     void validateAndAddBlock(const Block& block);
+    void queueBlock(Block block, bool relay = true);
     void broadcastBlock(const Block& block);
     
     // Transaction handling
     void submitTransaction(const Transaction& transaction);
     void processTransactions();
     
+    // Delivery point for messages from peers
+    void sendMessage(const ProtocolMessage& message);
+    
+    // Sync traffic from peers
+    void onHeadersReceived(const std::string& peerId, const std::vector<BlockHeader>& headers);
+    void onBlockReceived(const std::string& peerId, Block block);
+    
     // Validation
     void startValidating();
     void stopValidating();
     
+    // Inbox queries, answered from the recipient index
+    MessageIndex::Page getMessages(const std::string& recipient,
+                                   uint64_t sinceHeight,
+                                   const std::string& cursor = "",
+                                   size_t limit = MessageIndex::DEFAULT_PAGE_SIZE) const;
+    MessageIndex::Page getGroupMessages(const std::string& publicKey,
+                                        uint64_t sinceHeight,
+                                        const std::string& cursor = "",
+                                        size_t limit = MessageIndex::DEFAULT_PAGE_SIZE) const;
+    
     // State management
     NodeState getState() const;
     bool isSynced() const;
@@ -56,5 +110,12 @@ public:
 private:
     void validationLoop();
     void syncLoop();
+    void requestHeadersFrom(const std::string& peerId, BlockDownloader& downloader);
+    void updateSyncState();
+    std::shared_ptr<BlockDownloader> currentDownloader() const;
     void handleOrphanBlocks();
+    void onBlockCommitted(const Block& block, uint64_t height, bool relay);
+    void createAndBroadcastBlock();
+    std::vector<std::string> findUnminableTransactions(const std::vector<Transaction>& transactions,
+                                                       const std::string& tipHash) const;
 }; 
\ No newline at end of file
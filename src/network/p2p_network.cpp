@@ -1,10 +1,18 @@
 #include "p2p_network.hpp"
+#include "../utils/tracer.hpp"
 #include <chrono>
 #include <algorithm>
 
-P2PNetwork::P2PNetwork(const std::string& nodeIdIn, uint16_t portIn)
+P2PNetwork::P2PNetwork(const std::string& nodeIdIn,
+                       uint16_t portIn,
+                       std::shared_ptr<const Blockchain> blockchainIn,
+                       HeadersHandler onHeadersIn,
+                       BlockHandler onBlockIn)
     : nodeId(nodeIdIn),
       port(portIn),
+      blockchain(std::move(blockchainIn)),
+      onHeaders(std::move(onHeadersIn)),
+      onBlock(std::move(onBlockIn)),
       isRunning(false) {
     state = {0, 0, 0.0, 0};
 }
@@ -55,9 +63,111 @@ void P2PNetwork::broadcastMessage(const Message& message) {
     }
 }
 
+std::vector<std::string> P2PNetwork::getPeerIds() {
+    std::lock_guard<std::mutex> lock(networkMutex);
+    
+    std::vector<std::string> peerIds;
+    peerIds.reserve(peers.size());
+    for (const auto& [peerId, peer] : peers) {
+        peerIds.push_back(peerId);
+    }
+    return peerIds;
+}
+
+void P2PNetwork::requestHeaders(const std::string& peerId, const std::string& fromHash, uint32_t maxHeaders) {
+    sendToPeer(peerId, NetworkProtocol::createHeadersRequest(fromHash, maxHeaders));
+}
+
+void P2PNetwork::requestBlocks(const std::string& peerId, const std::vector<std::string>& blockHashes) {
+    sendToPeer(peerId, NetworkProtocol::createBlocksRequest(blockHashes));
+}
+
+bool P2PNetwork::isPeer(const std::string& peerId) {
+    std::lock_guard<std::mutex> lock(networkMutex);
+    return peers.count(peerId) > 0;
+}
+
+void P2PNetwork::sendToPeer(const std::string& peerId, const ProtocolMessage& message) {
+    std::shared_ptr<Node> peer;
+    {
+        std::lock_guard<std::mutex> lock(networkMutex);
+        auto it = peers.find(peerId);
+        if (it == peers.end()) {
+            throw std::runtime_error("Unknown peer: " + peerId);
+        }
+        peer = it->second;
+        state.messageCount++;
+    }
+    
+    // Stamped so the peer knows whom to answer, and sent unlocked since
+    // the answer can arrive before this returns
+    ProtocolMessage outgoing = message;
+    outgoing.sender = nodeId;
+    
+    // Failures propagate so the caller can hand the work to another peer
+    peer->sendMessage(outgoing);
+}
+
+void P2PNetwork::processMessage(const ProtocolMessage& message) {
+    if (!isPeer(message.sender)) return;
+    
+    try {
+        switch (message.type) {
+            case MessageType::HEADERS_REQUEST:
+                serveHeaders(message);
+                break;
+                
+            case MessageType::BLOCKS_REQUEST:
+                serveBlocks(message);
+                break;
+                
+            case MessageType::HEADERS_RESPONSE:
+                if (onHeaders) {
+                    onHeaders(message.sender, NetworkProtocol::parseHeaders(message));
+                }
+                break;
+                
+            case MessageType::BLOCK_RESPONSE:
+                if (onBlock) {
+                    Tracer::Span span("p2p.handleBlockResponse", "block", 0);
+                    Block block = NetworkProtocol::parseBlock(message);
+                    span.setTraceId(Tracer::traceIdFor(block.getHash()));
+                    onBlock(message.sender, std::move(block));
+                }
+                break;
+                
+            default:
+                break;
+        }
+    } catch (const std::exception&) {
+        // Malformed, or the peer left before the reply went out
+    }
+}
+
+void P2PNetwork::serveHeaders(const ProtocolMessage& request) {
+    std::string fromHash;
+    uint32_t maxHeaders;
+    NetworkProtocol::parseHeadersRequest(request, fromHash, maxHeaders);
+    
+    // An empty reply tells the peer there is nothing past fromHash here,
+    // so it stops waiting rather than timing out
+    sendToPeer(request.sender, NetworkProtocol::createHeadersResponse(
+        blockchain->getHeadersAfter(fromHash, maxHeaders)));
+}
+
+void P2PNetwork::serveBlocks(const ProtocolMessage& request) {
+    // Hashes this node does not have are skipped; the requester's
+    // downloader reassigns them once its request times out
+    for (const std::string& hash : NetworkProtocol::parseBlocksRequest(request)) {
+        if (std::optional<Block> block = blockchain->findBlock(hash)) {
+            sendToPeer(request.sender, NetworkProtocol::createBlockResponse(*block));
+        }
+    }
+}
+
 void P2PNetwork::handleIncomingMessages() {
     while (!messageQueue.empty()) {
-        Message message = messageQueue.front();
+        Message message = std::move(messageQueue.front());
         messageQueue.pop();
         
         switch (message.getType()) {
@@ -65,9 +175,15 @@ void P2PNetwork::handleIncomingMessages() {
                 processTransaction(message.getTransaction());
                 break;
                 
-            case MessageType::BLOCK:
-                processBlock(message.getBlock());
+            case MessageType::BLOCK: {
+                // Opened before decoding so the span covers it; the trace
+                // ID follows once the block's hash is known
+                Tracer::Span span("p2p.handleBlockMessage", "block", 0);
+                Block block = message.getBlock();
+                span.setTraceId(Tracer::traceIdFor(block.getHash()));
+                processBlock(block);
                 break;
+            }
                 
             case MessageType::PEER_DISCOVERY:
                 handlePeerDiscovery(message);
@@ -4,13 +4,24 @@
 #include <queue>
 #include <mutex>
 #include <thread>
+#include <memory>
+#include <functional>
 #include "node.hpp"
+#include "protocol.hpp"
 #include "../core/blockchain.hpp"
 
 class P2PNetwork {
+public:
+    // Sync replies from peers, handed to the node once decoded
+    using HeadersHandler = std::function<void(const std::string& peerId, const std::vector<BlockHeader>& headers)>;
+    using BlockHandler = std::function<void(const std::string& peerId, Block block)>;
+    
 private:
     std::string nodeId;
     uint16_t port;
+    std::shared_ptr<const Blockchain> blockchain;   // Serves peers' sync requests
+    HeadersHandler onHeaders;
+    BlockHandler onBlock;
     std::unordered_map<std::string, std::shared_ptr<Node>> peers;
     std::queue<Message> messageQueue;
     std::mutex networkMutex;
@@ -26,7 +37,11 @@ private:
     } state;
     
 public:
-    P2PNetwork(const std::string& nodeIdIn, uint16_t portIn);
+    P2PNetwork(const std::string& nodeIdIn,
+               uint16_t portIn,
+               std::shared_ptr<const Blockchain> blockchainIn,
+               HeadersHandler onHeadersIn,
+               BlockHandler onBlockIn);
     ~P2PNetwork();
     
     // Core networking
@@ -40,9 +55,16 @@ public:
     bool addPeer(const std::string& peerId, const std::string& address);
     void removePeer(const std::string& peerId);
     void synchronizeWithPeers();
+    std::vector<std::string> getPeerIds();
+    
+    // Headers-first sync; both throw if the peer is gone
+    void requestHeaders(const std::string& peerId, const std::string& fromHash, uint32_t maxHeaders);
+    void requestBlocks(const std::string& peerId, const std::vector<std::string>& blockHashes);
     
-    // Message handling
-    void processMessage(const Message& message);
+    // Message handling. Sync requests are answered from the chain and
+    // sync replies go to the handlers; messages from unknown peers or that
+    // fail to decode are dropped.
+    void processMessage(const ProtocolMessage& message);
     void handleIncomingMessages();
     
     // Network optimization
@@ -53,4 +75,8 @@ public:
 private:
     void runNetworkLoop();
     void validatePeerConnection(const std::string& peerId);
+    bool isPeer(const std::string& peerId);
+    void sendToPeer(const std::string& peerId, const ProtocolMessage& message);
+    void serveHeaders(const ProtocolMessage& request);
+    void serveBlocks(const ProtocolMessage& request);
 }; 
\ No newline at end of file
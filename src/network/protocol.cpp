@@ -1,8 +1,82 @@
 #include "protocol.hpp"
 #include "../crypto/encryption.hpp"
 #include <sstream>
+#include <algorithm>
+#include <stdexcept>
 #include <json/json.h> // Using JsonCpp for serialization
 
+namespace {
+    Json::Value headerToJson(const BlockHeader& header) {
+        Json::Value entry;
+        entry["index"] = header.index;
+        entry["timestamp"] = Json::Value::Int64(header.timestamp);
+        entry["previousHash"] = header.previousHash;
+        entry["merkleRoot"] = header.merkleRoot;
+        entry["nonce"] = header.nonce;
+        entry["hash"] = header.hash;
+        return entry;
+    }
+    
+    BlockHeader headerFromJson(const Json::Value& entry) {
+        BlockHeader header;
+        header.index = entry["index"].asUInt();
+        header.timestamp = static_cast<time_t>(entry["timestamp"].asInt64());
+        header.previousHash = entry["previousHash"].asString();
+        header.merkleRoot = entry["merkleRoot"].asString();
+        header.nonce = entry["nonce"].asUInt();
+        header.hash = entry["hash"].asString();
+        return header;
+    }
+    
+    // Checks the type and parses the JSON payload, throwing with what
+    // on either failure
+    Json::Value parsePayload(const ProtocolMessage& message, MessageType type, const char* what) {
+        if (message.type != type) {
+            throw std::invalid_argument(std::string("Not a ") + what);
+        }
+        
+        Json::Value payload;
+        Json::Reader reader;
+        if (!reader.parse(message.payload, payload) || !payload.isObject()) {
+            throw std::runtime_error(std::string("Failed to parse ") + what);
+        }
+        return payload;
+    }
+    
+    // Transactions are binary-encoded, and JSON strings must be text
+    std::string toHex(const std::string& bytes) {
+        static const char hexDigits[] = "0123456789abcdef";
+        std::string hex(2 * bytes.size(), '0');
+        for (size_t i = 0; i < bytes.size(); i++) {
+            const uint8_t byte = static_cast<uint8_t>(bytes[i]);
+            hex[2 * i] = hexDigits[byte >> 4];
+            hex[2 * i + 1] = hexDigits[byte & 0x0f];
+        }
+        return hex;
+    }
+    
+    std::string fromHex(const std::string& hex) {
+        auto nibble = [](char c) -> int {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            return -1;
+        };
+        if (hex.size() % 2 != 0) {
+            throw std::runtime_error("Odd-length hex string");
+        }
+        std::string bytes(hex.size() / 2, '\0');
+        for (size_t i = 0; i < bytes.size(); i++) {
+            const int high = nibble(hex[2 * i]);
+            const int low = nibble(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                throw std::runtime_error("Invalid hex digit");
+            }
+            bytes[i] = static_cast<char>((high << 4) | low);
+        }
+        return bytes;
+    }
+}
+
 std::string ProtocolMessage::serialize() const {
     Json::Value root;
     root["type"] = static_cast<int>(type);
@@ -81,6 +155,146 @@ ProtocolMessage NetworkProtocol::createBlockRequest(uint64_t height) {
     return message;
 }
 
+ProtocolMessage NetworkProtocol::createHeadersRequest(const std::string& fromHash, uint32_t maxHeaders) {
+    Json::Value payload;
+    payload["fromHash"] = fromHash;
+    payload["maxHeaders"] = std::min(maxHeaders, MAX_HEADERS_PER_MESSAGE);
+    
+    Json::FastWriter writer;
+    
+    ProtocolMessage message;
+    message.type = MessageType::HEADERS_REQUEST;
+    message.payload = writer.write(payload);
+    message.timestamp = std::time(nullptr);
+    
+    return message;
+}
+
+void NetworkProtocol::parseHeadersRequest(const ProtocolMessage& message, std::string& fromHash, uint32_t& maxHeaders) {
+    Json::Value payload = parsePayload(message, MessageType::HEADERS_REQUEST, "headers request");
+    if (!payload["fromHash"].isString() || !payload["maxHeaders"].isUInt()) {
+        throw std::runtime_error("Failed to parse headers request");
+    }
+    
+    fromHash = payload["fromHash"].asString();
+    maxHeaders = std::min(payload["maxHeaders"].asUInt(), MAX_HEADERS_PER_MESSAGE);
+}
+
+ProtocolMessage NetworkProtocol::createHeadersResponse(const std::vector<BlockHeader>& headers) {
+    if (headers.size() > MAX_HEADERS_PER_MESSAGE) {
+        throw std::invalid_argument("Too many headers for one message");
+    }
+    
+    Json::Value list(Json::arrayValue);
+    for (const BlockHeader& header : headers) {
+        list.append(headerToJson(header));
+    }
+    
+    Json::Value payload;
+    payload["headers"] = list;
+    
+    Json::FastWriter writer;
+    
+    ProtocolMessage message;
+    message.type = MessageType::HEADERS_RESPONSE;
+    message.payload = writer.write(payload);
+    message.timestamp = std::time(nullptr);
+    
+    return message;
+}
+
+std::vector<BlockHeader> NetworkProtocol::parseHeaders(const ProtocolMessage& message) {
+    Json::Value payload = parsePayload(message, MessageType::HEADERS_RESPONSE, "headers response");
+    if (!payload["headers"].isArray()) {
+        throw std::runtime_error("Failed to parse headers");
+    }
+    
+    const Json::Value& list = payload["headers"];
+    if (list.size() > MAX_HEADERS_PER_MESSAGE) {
+        throw std::runtime_error("Too many headers in message");
+    }
+    
+    std::vector<BlockHeader> headers;
+    headers.reserve(list.size());
+    for (const Json::Value& entry : list) {
+        headers.push_back(headerFromJson(entry));
+    }
+    
+    return headers;
+}
+
+ProtocolMessage NetworkProtocol::createBlocksRequest(const std::vector<std::string>& blockHashes) {
+    Json::Value hashes(Json::arrayValue);
+    for (const std::string& hash : blockHashes) {
+        hashes.append(hash);
+    }
+    
+    Json::Value payload;
+    payload["hashes"] = hashes;
+    
+    Json::FastWriter writer;
+    
+    ProtocolMessage message;
+    message.type = MessageType::BLOCKS_REQUEST;
+    message.payload = writer.write(payload);
+    message.timestamp = std::time(nullptr);
+    
+    return message;
+}
+
+std::vector<std::string> NetworkProtocol::parseBlocksRequest(const ProtocolMessage& message) {
+    Json::Value payload = parsePayload(message, MessageType::BLOCKS_REQUEST, "blocks request");
+    const Json::Value& list = payload["hashes"];
+    if (!list.isArray()) {
+        throw std::runtime_error("Failed to parse blocks request");
+    }
+    if (list.size() > MAX_HEADERS_PER_MESSAGE) {
+        throw std::runtime_error("Too many blocks requested");
+    }
+    
+    std::vector<std::string> hashes;
+    hashes.reserve(list.size());
+    for (const Json::Value& hash : list) {
+        hashes.push_back(hash.asString());
+    }
+    return hashes;
+}
+
+ProtocolMessage NetworkProtocol::createBlockResponse(const Block& block) {
+    Json::Value transactions(Json::arrayValue);
+    for (const Transaction& tx : block.getTransactions()) {
+        transactions.append(toHex(tx.serialize()));
+    }
+    
+    Json::Value payload;
+    payload["header"] = headerToJson(block.getHeader());
+    payload["transactions"] = transactions;
+    
+    Json::FastWriter writer;
+    
+    ProtocolMessage message;
+    message.type = MessageType::BLOCK_RESPONSE;
+    message.payload = writer.write(payload);
+    message.timestamp = std::time(nullptr);
+    
+    return message;
+}
+
+Block NetworkProtocol::parseBlock(const ProtocolMessage& message) {
+    Json::Value payload = parsePayload(message, MessageType::BLOCK_RESPONSE, "block response");
+    const Json::Value& list = payload["transactions"];
+    if (!payload["header"].isObject() || !list.isArray()) {
+        throw std::runtime_error("Failed to parse block");
+    }
+    
+    std::vector<Transaction> transactions;
+    transactions.reserve(list.size());
+    for (const Json::Value& entry : list) {
+        transactions.push_back(Transaction::deserialize(fromHex(entry.asString())));
+    }
+    return Block(headerFromJson(payload["header"]), std::move(transactions));
+}
+
 ProtocolMessage NetworkProtocol::createTransactionBroadcast(const Transaction& tx) {
     Json::Value payload;
     payload["hash"] = tx.getHash();
@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include "../core/block.hpp"
 
 enum class MessageType {
     HANDSHAKE,
@@ -13,7 +14,10 @@ enum class MessageType {
     CONTRACT_DEPLOYMENT,
     CONTRACT_EXECUTION,
     SYNC_REQUEST,
-    SYNC_RESPONSE
+    SYNC_RESPONSE,
+    HEADERS_REQUEST,
+    HEADERS_RESPONSE,
+    BLOCKS_REQUEST
 };
 
 struct ProtocolMessage {
@@ -33,6 +37,7 @@ public:
     static constexpr uint16_t DEFAULT_PORT = 8333;
     static constexpr size_t MAX_MESSAGE_SIZE = 1024 * 1024; // 1MB
     static constexpr uint32_t PROTOCOL_VERSION = 1;
+    static constexpr uint32_t MAX_HEADERS_PER_MESSAGE = 2000;
     
     struct HandshakeData {
         uint32_t version;
@@ -43,6 +48,20 @@ public:
     
     static ProtocolMessage createHandshake(const HandshakeData& data);
     static ProtocolMessage createBlockRequest(uint64_t height);
+    
+    // Headers-first sync: headers after fromHash, then bodies by hash.
+    // The parse functions throw on a message of the wrong type or one that
+    // does not decode.
+    static ProtocolMessage createHeadersRequest(const std::string& fromHash, uint32_t maxHeaders);
+    static void parseHeadersRequest(const ProtocolMessage& message, std::string& fromHash, uint32_t& maxHeaders);
+    static ProtocolMessage createHeadersResponse(const std::vector<BlockHeader>& headers);
+    static std::vector<BlockHeader> parseHeaders(const ProtocolMessage& message);
+    static ProtocolMessage createBlocksRequest(const std::vector<std::string>& blockHashes);
+    static std::vector<std::string> parseBlocksRequest(const ProtocolMessage& message);
+    
+    // One block per response, so a peer can answer a request in pieces
+    static ProtocolMessage createBlockResponse(const Block& block);
+    static Block parseBlock(const ProtocolMessage& message);
     static ProtocolMessage createTransactionBroadcast(const Transaction& tx);
     static ProtocolMessage createValidationRequest(const Block& block);
 }; 
\ No newline at end of file
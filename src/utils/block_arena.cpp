@@ -0,0 +1,53 @@
+#include "block_arena.hpp"
+#include <atomic>
+
+namespace {
+    std::atomic<uint64_t> nextArenaId{1};
+
+    thread_local BlockArena* boundArena = nullptr;
+
+    // Last resource handed out on this thread, keyed by arena id rather
+    // than address so a new arena at a reused address never hits it
+    thread_local uint64_t cachedArenaId = 0;
+    thread_local std::pmr::memory_resource* cachedResource = nullptr;
+}
+
+BlockArena::BlockArena() : id(nextArenaId.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+BlockArena::Scope::Scope(BlockArena* arena) : previous(boundArena) {
+    boundArena = arena;
+}
+
+BlockArena::Scope::~Scope() {
+    boundArena = previous;
+}
+
+BlockArena* BlockArena::currentArena() {
+    return boundArena;
+}
+
+std::pmr::memory_resource* BlockArena::current() {
+    return boundArena ? boundArena->resourceForThisThread() : std::pmr::get_default_resource();
+}
+
+std::pmr::memory_resource* BlockArena::resourceForThisThread() {
+    if (cachedArenaId == id) {
+        return cachedResource;
+    }
+
+    std::pmr::memory_resource* resource;
+    {
+        std::lock_guard<std::mutex> lock(resourcesMutex);
+        auto& slot = resources[std::this_thread::get_id()];
+        if (!slot) {
+            slot = std::make_unique<std::pmr::monotonic_buffer_resource>(
+                INITIAL_CHUNK_SIZE, std::pmr::new_delete_resource());
+        }
+        resource = slot.get();
+    }
+
+    cachedArenaId = id;
+    cachedResource = resource;
+    return resource;
+}
\ No newline at end of file
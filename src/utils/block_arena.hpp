@@ -0,0 +1,51 @@
+#pragma once
+#include <memory_resource>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <cstdint>
+
+// Monotonic arena for the short-lived temporaries of validating or
+// executing one block. Each thread working on the block allocates from
+// its own monotonic_buffer_resource, so allocation never contends, and
+// everything is released in one step when the arena is destroyed.
+//
+// Code opts in by allocating from BlockArena::current(), which falls back
+// to the default resource outside any arena. Tasks started through
+// ThreadPool::TaskGroup inherit the arena of the thread that queued them.
+class BlockArena {
+private:
+    static constexpr size_t INITIAL_CHUNK_SIZE = 64 * 1024;
+
+    uint64_t id;
+    std::unordered_map<std::thread::id, std::unique_ptr<std::pmr::monotonic_buffer_resource>> resources;
+    std::mutex resourcesMutex;
+
+public:
+    // Binds an arena (or none) to the calling thread for its lifetime;
+    // scopes nest and restore the previous binding
+    class Scope {
+    private:
+        BlockArena* previous;
+
+    public:
+        explicit Scope(BlockArena* arena);
+        explicit Scope(BlockArena& arena) : Scope(&arena) {}
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    BlockArena();
+
+    BlockArena(const BlockArena&) = delete;
+    BlockArena& operator=(const BlockArena&) = delete;
+
+    static BlockArena* currentArena();
+    static std::pmr::memory_resource* current();
+
+private:
+    std::pmr::memory_resource* resourceForThisThread();
+};
\ No newline at end of file
@@ -3,12 +3,13 @@
 #include <list>
 #include <mutex>
 #include <memory>
+#include "../core/block.hpp"
 
 template<typename K, typename V>
 class LRUCache {
 private:
     size_t capacity;
-    std::list<K> lruList;
+    mutable std::list<K> lruList;
     std::unordered_map<K, std::pair<V, typename std::list<K>::iterator>> cache;
     mutable std::mutex cacheMutex;
     
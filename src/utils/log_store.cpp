@@ -0,0 +1,343 @@
+#include "log_store.hpp"
+#include <mutex>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    void writeUint32(std::string& buffer, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+        }
+    }
+
+    uint32_t readUint32(const unsigned char* data) {
+        return static_cast<uint32_t>(data[0]) |
+               (static_cast<uint32_t>(data[1]) << 8) |
+               (static_cast<uint32_t>(data[2]) << 16) |
+               (static_cast<uint32_t>(data[3]) << 24);
+    }
+
+    uint64_t readUint64(const unsigned char* data) {
+        return static_cast<uint64_t>(readUint32(data)) |
+               (static_cast<uint64_t>(readUint32(data + 4)) << 32);
+    }
+
+    void patchUint(std::string& buffer, size_t position, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            buffer[position + i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    bool readFully(int fd, char* data, size_t length, uint64_t offset) {
+        while (length > 0) {
+            ssize_t n = pread(fd, data, length, static_cast<off_t>(offset));
+            if (n <= 0) return false;
+            data += n;
+            length -= n;
+            offset += n;
+        }
+        return true;
+    }
+
+    bool writeFully(int fd, const char* data, size_t length) {
+        while (length > 0) {
+            ssize_t n = write(fd, data, length);
+            if (n <= 0) return false;
+            data += n;
+            length -= n;
+        }
+        return true;
+    }
+}
+
+LogStore::LogStore(const std::string& pathIn)
+    : path(pathIn),
+      fd(-1),
+      endOffset(0),
+      deadBytes(0) {
+    open();
+}
+
+LogStore::~LogStore() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+void LogStore::open() {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open log store: " + path);
+    }
+    recover();
+}
+
+void LogStore::recover() {
+    directory.clear();
+    endOffset = 0;
+    deadBytes = 0;
+
+    const off_t fileSize = lseek(fd, 0, SEEK_END);
+    if (fileSize < 0) {
+        throw std::runtime_error("Failed to read log store: " + path);
+    }
+
+    uint64_t offset = 0;
+    std::string body;
+    std::vector<std::pair<std::string, Location>> records;
+    while (offset + BATCH_HEADER_SIZE <= static_cast<uint64_t>(fileSize)) {
+        unsigned char header[BATCH_HEADER_SIZE];
+        if (!readFully(fd, reinterpret_cast<char*>(header), BATCH_HEADER_SIZE, offset)) break;
+
+        const uint32_t recordCount = readUint32(header);
+        const uint64_t length = readUint64(header + 4);
+        const uint32_t expected = readUint32(header + 12);
+        const uint64_t bodyOffset = offset + BATCH_HEADER_SIZE;
+        if (length > static_cast<uint64_t>(fileSize) - bodyOffset) break;
+
+        body.resize(length);
+        if (length > 0 && !readFully(fd, &body[0], body.size(), bodyOffset)) break;
+        if (checksum(body.data(), body.size()) != expected) break;
+        if (!parseBatch(body, recordCount, bodyOffset, records)) break;
+
+        for (auto& [key, location] : records) {
+            auto it = directory.find(key);
+            if (it != directory.end()) {
+                deadBytes += HEADER_SIZE + key.size() + it->second.length;
+                it->second = location;
+            } else {
+                directory.emplace(std::move(key), location);
+            }
+        }
+        offset = bodyOffset + length;
+    }
+
+    // A crash mid-append leaves a torn batch at the tail; drop all of it
+    // so the next append starts on a batch boundary
+    if (offset < static_cast<uint64_t>(fileSize)) {
+        if (ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+            throw std::runtime_error("Failed to truncate log store: " + path);
+        }
+    }
+    endOffset = offset;
+    lseek(fd, static_cast<off_t>(endOffset), SEEK_SET);
+}
+
+bool LogStore::get(const std::string& key, std::string& value) const {
+    std::shared_lock<std::shared_mutex> lock(storeMutex);
+
+    auto it = directory.find(key);
+    if (it == directory.end()) {
+        return false;
+    }
+
+    value.resize(it->second.length);
+    if (it->second.length == 0) {
+        return true;
+    }
+    if (!readFully(fd, &value[0], it->second.length, it->second.offset)) {
+        throw std::runtime_error("Failed to read log store: " + path);
+    }
+    return true;
+}
+
+bool LogStore::contains(const std::string& key) const {
+    std::shared_lock<std::shared_mutex> lock(storeMutex);
+    return directory.count(key) > 0;
+}
+
+std::vector<std::string> LogStore::keysWithPrefix(const std::string& prefix) const {
+    std::shared_lock<std::shared_mutex> lock(storeMutex);
+
+    std::vector<std::string> keys;
+    for (const auto& entry : directory) {
+        if (entry.first.compare(0, prefix.size(), prefix) == 0) {
+            keys.push_back(entry.first);
+        }
+    }
+    return keys;
+}
+
+void LogStore::put(const std::string& key, const std::string& value) {
+    writeBatch({{key, value}}, false);
+}
+
+void LogStore::writeBatch(const std::vector<std::pair<std::string, std::string>>& records,
+                          bool syncToDisk) {
+    if (records.empty()) {
+        return;
+    }
+
+    std::string buffer;
+    size_t total = BATCH_HEADER_SIZE;
+    for (const auto& [key, value] : records) {
+        total += HEADER_SIZE + key.size() + value.size();
+    }
+    buffer.reserve(total);
+    buffer.append(BATCH_HEADER_SIZE, '\0');
+
+    std::unique_lock<std::shared_mutex> lock(storeMutex);
+    uint64_t offset = endOffset + BATCH_HEADER_SIZE;
+    std::vector<std::pair<const std::string*, Location>> locations;
+    locations.reserve(records.size());
+    for (const auto& [key, value] : records) {
+        encodeRecord(buffer, key, value);
+        locations.push_back({&key, {offset + HEADER_SIZE + key.size(),
+                                    static_cast<uint32_t>(value.size())}});
+        offset += HEADER_SIZE + key.size() + value.size();
+    }
+    sealBatch(buffer, 0, static_cast<uint32_t>(records.size()));
+
+    appendLocked(buffer);
+    if (syncToDisk && fdatasync(fd) != 0) {
+        throw std::runtime_error("Failed to sync log store: " + path);
+    }
+
+    // Only publish the new locations once the bytes are in the file
+    for (const auto& [key, location] : locations) {
+        auto it = directory.find(*key);
+        if (it != directory.end()) {
+            deadBytes += HEADER_SIZE + key->size() + it->second.length;
+            it->second = location;
+        } else {
+            directory.emplace(*key, location);
+        }
+    }
+}
+
+void LogStore::appendLocked(const std::string& buffer) {
+    if (!writeFully(fd, buffer.data(), buffer.size())) {
+        // Roll back a partial append so the log stays parseable
+        if (ftruncate(fd, static_cast<off_t>(endOffset)) == 0) {
+            lseek(fd, static_cast<off_t>(endOffset), SEEK_SET);
+        }
+        throw std::runtime_error("Failed to append to log store: " + path);
+    }
+    endOffset += buffer.size();
+}
+
+void LogStore::compact() {
+    std::unique_lock<std::shared_mutex> lock(storeMutex);
+
+    const std::string compactPath = path + ".compact";
+    int compactFd = ::open(compactPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (compactFd < 0) {
+        throw std::runtime_error("Failed to open log store: " + compactPath);
+    }
+
+    // The live records are rewritten as a series of batches of about 1MB;
+    // the rename below makes the whole rewrite atomic
+    std::string buffer(BATCH_HEADER_SIZE, '\0');
+    uint32_t recordCount = 0;
+    std::string value;
+    for (const auto& [key, location] : directory) {
+        value.resize(location.length);
+        if (location.length > 0 &&
+            !readFully(fd, &value[0], location.length, location.offset)) {
+            close(compactFd);
+            throw std::runtime_error("Failed to read log store: " + path);
+        }
+        encodeRecord(buffer, key, value);
+        recordCount++;
+
+        if (buffer.size() >= (1 << 20)) {
+            sealBatch(buffer, 0, recordCount);
+            if (!writeFully(compactFd, buffer.data(), buffer.size())) {
+                close(compactFd);
+                throw std::runtime_error("Failed to write log store: " + compactPath);
+            }
+            buffer.assign(BATCH_HEADER_SIZE, '\0');
+            recordCount = 0;
+        }
+    }
+
+    if (recordCount > 0) {
+        sealBatch(buffer, 0, recordCount);
+    } else {
+        buffer.clear();
+    }
+    if (!writeFully(compactFd, buffer.data(), buffer.size()) || fdatasync(compactFd) != 0) {
+        close(compactFd);
+        throw std::runtime_error("Failed to write log store: " + compactPath);
+    }
+    close(compactFd);
+
+    if (std::rename(compactPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to replace log store: " + path);
+    }
+
+    close(fd);
+    fd = -1;
+    open();
+}
+
+size_t LogStore::size() const {
+    std::shared_lock<std::shared_mutex> lock(storeMutex);
+    return directory.size();
+}
+
+uint64_t LogStore::getDeadBytes() const {
+    std::shared_lock<std::shared_mutex> lock(storeMutex);
+    return deadBytes;
+}
+
+void LogStore::encodeRecord(std::string& buffer, const std::string& key, const std::string& value) {
+    writeUint32(buffer, static_cast<uint32_t>(key.size()));
+    writeUint32(buffer, static_cast<uint32_t>(value.size()));
+
+    const size_t start = buffer.size();
+    buffer.append(4, '\0');
+    buffer += key;
+    buffer += value;
+
+    // Patch the checksum in once key and value are contiguous
+    uint32_t sum = checksum(buffer.data() + start + 4, key.size() + value.size());
+    for (int i = 0; i < 4; i++) {
+        buffer[start + i] = static_cast<char>((sum >> (8 * i)) & 0xff);
+    }
+}
+
+void LogStore::sealBatch(std::string& buffer, size_t start, uint32_t recordCount) {
+    const size_t bodyStart = start + BATCH_HEADER_SIZE;
+    const size_t length = buffer.size() - bodyStart;
+    patchUint(buffer, start, recordCount, 4);
+    patchUint(buffer, start + 4, length, 8);
+    patchUint(buffer, start + 12, checksum(buffer.data() + bodyStart, length), 4);
+}
+
+bool LogStore::parseBatch(const std::string& body, uint32_t recordCount, uint64_t bodyOffset,
+                          std::vector<std::pair<std::string, Location>>& records) const {
+    records.clear();
+    records.reserve(recordCount);
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(body.data());
+    size_t position = 0;
+    while (position + HEADER_SIZE <= body.size()) {
+        const uint64_t keyLength = readUint32(data + position);
+        const uint64_t valueLength = readUint32(data + position + 4);
+        const uint32_t expected = readUint32(data + position + 8);
+        const size_t recordStart = position + HEADER_SIZE;
+        if (keyLength + valueLength > body.size() - recordStart) return false;
+        if (checksum(body.data() + recordStart, keyLength + valueLength) != expected) return false;
+
+        records.emplace_back(body.substr(recordStart, keyLength),
+                             Location{bodyOffset + recordStart + keyLength,
+                                      static_cast<uint32_t>(valueLength)});
+        position = recordStart + keyLength + valueLength;
+    }
+
+    return position == body.size() && records.size() == recordCount;
+}
+
+uint32_t LogStore::checksum(const char* data, size_t length) {
+    // FNV-1a; only needs to catch torn writes, not adversarial input
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
\ No newline at end of file
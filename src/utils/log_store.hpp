@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+
+// Append-only key-value log (Bitcask layout). Values live on disk; only a
+// key -> (offset, length) directory is kept in memory, rebuilt by scanning
+// the log on open. Overwrites append a new record and leave the old one
+// as dead space until compact() rewrites the live records.
+//
+// Records are written in framed batches, and recovery applies a batch
+// only if all of it made it to disk, so a crash never leaves a
+// writeBatch() partly applied.
+class LogStore {
+private:
+    struct Location {
+        uint64_t offset;    // Offset of the value bytes
+        uint32_t length;
+    };
+
+    // Record layout: keyLength(4) valueLength(4) checksum(4) key value
+    static constexpr size_t HEADER_SIZE = 12;
+
+    // Batch layout: recordCount(4) length(8) checksum(4) records, where
+    // length and checksum cover the records
+    static constexpr size_t BATCH_HEADER_SIZE = 16;
+
+    std::string path;
+    int fd;
+    uint64_t endOffset;
+    uint64_t deadBytes;
+    std::unordered_map<std::string, Location> directory;
+    mutable std::shared_mutex storeMutex;
+
+public:
+    explicit LogStore(const std::string& pathIn);
+    ~LogStore();
+
+    LogStore(const LogStore&) = delete;
+    LogStore& operator=(const LogStore&) = delete;
+
+    // Reads are safe from any number of threads alongside one writer
+    bool get(const std::string& key, std::string& value) const;
+    bool contains(const std::string& key) const;
+    std::vector<std::string> keysWithPrefix(const std::string& prefix) const;
+
+    void put(const std::string& key, const std::string& value);
+
+    // Appends every record with a single write; with syncToDisk the batch
+    // is durable when this returns
+    void writeBatch(const std::vector<std::pair<std::string, std::string>>& records,
+                    bool syncToDisk = true);
+
+    // Rewrites the log with only the latest record for each key
+    void compact();
+
+    size_t size() const;
+    uint64_t getDeadBytes() const;
+
+private:
+    void open();
+    void recover();
+    void appendLocked(const std::string& buffer);
+    static void encodeRecord(std::string& buffer, const std::string& key, const std::string& value);
+    static void sealBatch(std::string& buffer, size_t start, uint32_t recordCount);
+    bool parseBatch(const std::string& body, uint32_t recordCount, uint64_t bodyOffset,
+                    std::vector<std::pair<std::string, Location>>& records) const;
+    static uint32_t checksum(const char* data, size_t length);
+};
\ No newline at end of file
@@ -1,48 +1,403 @@
 #include "memory_pool.hpp"
 #include <algorithm>
+#include <ctime>
+
+size_t MemoryPool::Package::virtualSize() const {
+    return std::max<size_t>(bytes, (gas + GAS_PER_BYTE - 1) / GAS_PER_BYTE);
+}
+
+MemoryPool::Package& MemoryPool::Package::operator+=(const Package& other) {
+    fee += other.fee;
+    bytes += other.bytes;
+    gas += other.gas;
+    return *this;
+}
+
+MemoryPool::Package& MemoryPool::Package::operator-=(const Package& other) {
+    fee -= other.fee;
+    bytes -= other.bytes;
+    gas -= other.gas;
+    return *this;
+}
+
+MemoryPool::MemoryPool(size_t maxSizeIn)
+    : maxSize(maxSizeIn),
+      totalBytes(0),
+      version(0),
+      templateVersion(0),
+      templateMaxBytes(0),
+      templateMaxGas(0) {
+}
+
+MemoryPool::Package MemoryPool::packageOf(const Transaction& tx) {
+    // Contract calls offer their full gas allowance on top of the fee
+    Package package;
+    package.fee = tx.getFee() + tx.getGasPrice() * static_cast<double>(tx.getGasLimit());
+    package.bytes = tx.getSerializedSize();
+    package.gas = tx.getGasLimit();
+    return package;
+}
+
+std::string MemoryPool::outputKey(const TransactionInput& input) {
+    return input.previousTxHash + ":" + std::to_string(input.outputIndex);
+}
 
 bool MemoryPool::addTransaction(const Transaction& tx, uint32_t priority) {
     std::lock_guard<std::mutex> lock(poolMutex);
+    const std::string& txHash = tx.getHash();
+    
+    if (entries.count(txHash) > 0) {
+        return false;
+    }
     
-    if (isFull()) {
-        cleanup();
-        if (isFull()) {
+    // Contract calls must prepay their gas limit
+    if (!tx.hasValidFee()) {
+        return false;
+    }
+    
+    // First spender wins; a conflicting spend is refused
+    for (const auto& input : tx.getInputs()) {
+        if (spentOutputs.count(outputKey(input)) > 0) {
             return false;
         }
     }
     
-    PoolEntry entry{tx, std::time(nullptr), priority};
-    pool.push_back(entry);
+    PoolEntry entry{tx, std::time(nullptr), priority, packageOf(tx), {}, 1, {}, {}};
+    for (const auto& input : tx.getInputs()) {
+        if (entries.count(input.previousTxHash) > 0) {
+            entry.parents.insert(input.previousTxHash);
+        }
+    }
     
-    // Sort by priority
-    std::sort(pool.begin(), pool.end(),
-              [](const PoolEntry& a, const PoolEntry& b) {
-                  return a.priority > b.priority;
-              });
+    std::unordered_set<std::string> ancestors;
+    for (const auto& parent : entry.parents) {
+        if (ancestors.insert(parent).second) {
+            collectAncestors(parent, ancestors);
+        }
+    }
+    if (ancestors.size() >= MAX_ANCESTORS) {
+        return false;
+    }
     
+    entry.withAncestors = entry.own;
+    for (const auto& ancestor : ancestors) {
+        entry.withAncestors += entries.at(ancestor).own;
+    }
+    entry.ancestorCount = 1 + ancestors.size();
+    
+    // A full pool makes room by evicting its lowest-ranked package, and
+    // only for a transaction that outranks it. Age expiry is left to
+    // cleanup(), run periodically by the owner.
+    if (entries.size() >= maxSize) {
+        if (byAncestorScore.empty()) {
+            return false;
+        }
+        const ScoreKey lowest = *byAncestorScore.rbegin();
+        if (entry.withAncestors.feeRate() <= lowest.feeRate || ancestors.count(lowest.txHash) > 0) {
+            return false;
+        }
+        
+        std::unordered_set<std::string> evicted{lowest.txHash};
+        collectDescendants(lowest.txHash, evicted);
+        removeEntries(evicted);
+    }
+    
+    for (const auto& parent : entry.parents) {
+        entries.at(parent).children.insert(txHash);
+    }
+    for (const auto& input : tx.getInputs()) {
+        spentOutputs[outputKey(input)] = txHash;
+    }
+    
+    totalBytes += entry.own.bytes;
+    auto inserted = entries.emplace(txHash, std::move(entry)).first;
+    byAncestorScore.insert(scoreKey(txHash, inserted->second));
+    version++;
     return true;
 }
 
 std::vector<Transaction> MemoryPool::getHighestPriorityTransactions(size_t count) {
     std::lock_guard<std::mutex> lock(poolMutex);
-    std::vector<Transaction> result;
     
-    count = std::min(count, pool.size());
+    std::vector<const PoolEntry*> ranked;
+    ranked.reserve(entries.size());
+    for (const auto& [txHash, entry] : entries) {
+        ranked.push_back(&entry);
+    }
+    
+    count = std::min(count, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                      [](const PoolEntry* a, const PoolEntry* b) {
+                          return a->priority > b->priority;
+                      });
+    
+    std::vector<Transaction> result;
+    result.reserve(count);
     for (size_t i = 0; i < count; ++i) {
-        result.push_back(pool[i].transaction);
+        result.push_back(ranked[i]->transaction);
     }
     
     return result;
 }
 
+void MemoryPool::collectAncestors(const std::string& txHash,
+                                  std::unordered_set<std::string>& ancestors) const {
+    std::vector<const std::string*> stack{&txHash};
+    while (!stack.empty()) {
+        const PoolEntry& entry = entries.at(*stack.back());
+        stack.pop_back();
+        for (const auto& parent : entry.parents) {
+            if (ancestors.insert(parent).second) {
+                stack.push_back(&parent);
+            }
+        }
+    }
+}
+
+void MemoryPool::collectDescendants(const std::string& txHash,
+                                    std::unordered_set<std::string>& descendants) const {
+    std::vector<const std::string*> stack{&txHash};
+    while (!stack.empty()) {
+        const PoolEntry& entry = entries.at(*stack.back());
+        stack.pop_back();
+        for (const auto& child : entry.children) {
+            if (descendants.insert(child).second) {
+                stack.push_back(&child);
+            }
+        }
+    }
+}
+
+void MemoryPool::removeEntries(const std::unordered_set<std::string>& hashes) {
+    // Caller holds poolMutex. Descendants that stay lose every removed
+    // ancestor from their packages; this walks the graph before any of it
+    // is unlinked, so a descendant is reached through each removed ancestor
+    // whatever order the set is visited in.
+    for (const auto& txHash : hashes) {
+        auto it = entries.find(txHash);
+        if (it == entries.end()) continue;
+        const PoolEntry& entry = it->second;
+        
+        std::unordered_set<std::string> descendants;
+        collectDescendants(txHash, descendants);
+        for (const auto& descendantHash : descendants) {
+            if (hashes.count(descendantHash) > 0) continue;
+            PoolEntry& descendant = entries.at(descendantHash);
+            byAncestorScore.erase(scoreKey(descendantHash, descendant));
+            descendant.withAncestors -= entry.own;
+            descendant.ancestorCount--;
+            byAncestorScore.insert(scoreKey(descendantHash, descendant));
+        }
+    }
+    
+    for (const auto& txHash : hashes) {
+        auto it = entries.find(txHash);
+        if (it == entries.end()) continue;
+        PoolEntry& entry = it->second;
+        
+        for (const auto& parent : entry.parents) {
+            auto parentIt = entries.find(parent);
+            if (parentIt != entries.end()) parentIt->second.children.erase(txHash);
+        }
+        for (const auto& child : entry.children) {
+            auto childIt = entries.find(child);
+            if (childIt != entries.end()) childIt->second.parents.erase(txHash);
+        }
+        for (const auto& input : entry.transaction.getInputs()) {
+            auto spent = spentOutputs.find(outputKey(input));
+            if (spent != spentOutputs.end() && spent->second == txHash) {
+                spentOutputs.erase(spent);
+            }
+        }
+        
+        byAncestorScore.erase(scoreKey(txHash, entry));
+        totalBytes -= entry.own.bytes;
+    }
+    
+    for (const auto& txHash : hashes) {
+        entries.erase(txHash);
+    }
+    version++;
+}
+
+void MemoryPool::removeTransaction(const std::string& txHash) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (entries.count(txHash) == 0) {
+        return;
+    }
+    
+    std::unordered_set<std::string> doomed{txHash};
+    collectDescendants(txHash, doomed);
+    removeEntries(doomed);
+}
+
+void MemoryPool::removeForBlock(const std::vector<Transaction>& transactions) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    
+    std::unordered_set<std::string> confirmed;
+    std::unordered_set<std::string> conflicting;
+    for (const auto& tx : transactions) {
+        if (entries.count(tx.getHash()) > 0) {
+            confirmed.insert(tx.getHash());
+        }
+        
+        // Pool transactions double-spending a confirmed input can never
+        // be mined, nor can anything built on them
+        for (const auto& input : tx.getInputs()) {
+            auto spent = spentOutputs.find(outputKey(input));
+            if (spent != spentOutputs.end() && spent->second != tx.getHash() &&
+                conflicting.insert(spent->second).second) {
+                collectDescendants(spent->second, conflicting);
+            }
+        }
+    }
+    
+    removeEntries(confirmed);
+    for (auto it = conflicting.begin(); it != conflicting.end();) {
+        it = entries.count(*it) > 0 ? std::next(it) : conflicting.erase(it);
+    }
+    if (!conflicting.empty()) {
+        removeEntries(conflicting);
+    }
+}
+
 void MemoryPool::cleanup(uint32_t maxAgeSeconds) {
+    std::lock_guard<std::mutex> lock(poolMutex);
     time_t now = std::time(nullptr);
     
-    pool.erase(
-        std::remove_if(pool.begin(), pool.end(),
-                      [now, maxAgeSeconds](const PoolEntry& entry) {
-                          return (now - entry.timestamp) > maxAgeSeconds;
-                      }),
-        pool.end()
-    );
-} 
\ No newline at end of file
+    std::unordered_set<std::string> expired;
+    for (const auto& [txHash, entry] : entries) {
+        if ((now - entry.timestamp) > maxAgeSeconds && expired.insert(txHash).second) {
+            collectDescendants(txHash, expired);
+        }
+    }
+    
+    if (!expired.empty()) {
+        removeEntries(expired);
+    }
+}
+
+std::shared_ptr<const BlockTemplate> MemoryPool::buildTemplate(size_t maxBytes, uint64_t maxGas) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (cachedTemplate && templateVersion == version &&
+        templateMaxBytes == maxBytes && templateMaxGas == maxGas) {
+        return cachedTemplate;
+    }
+    
+    auto result = std::make_shared<BlockTemplate>();
+    std::unordered_set<std::string> included;
+    std::unordered_set<std::string> failed;
+    
+    // Entries whose ancestors are partly in the template, re-scored on
+    // what is still left to include
+    std::unordered_map<std::string, Package> modified;
+    std::set<ScoreKey> modifiedScores;
+    
+    auto mainIt = byAncestorScore.begin();
+    size_t consecutiveFailures = 0;
+    
+    while (true) {
+        while (mainIt != byAncestorScore.end() &&
+               (included.count(mainIt->txHash) > 0 || modified.count(mainIt->txHash) > 0 ||
+                failed.count(mainIt->txHash) > 0)) {
+            ++mainIt;
+        }
+        if (mainIt == byAncestorScore.end() && modifiedScores.empty()) {
+            break;
+        }
+        
+        const bool fromModified = !modifiedScores.empty() &&
+            (mainIt == byAncestorScore.end() || *modifiedScores.begin() < *mainIt);
+        const std::string candidate = fromModified ? modifiedScores.begin()->txHash : mainIt->txHash;
+        const Package package = fromModified ? modified.at(candidate)
+                                             : entries.at(candidate).withAncestors;
+        if (fromModified) {
+            modifiedScores.erase(modifiedScores.begin());
+        } else {
+            ++mainIt;
+        }
+        
+        if (result->totalBytes + package.bytes > maxBytes || result->totalGas + package.gas > maxGas) {
+            failed.insert(candidate);
+            if (++consecutiveFailures >= MAX_CONSECUTIVE_FAILURES) {
+                break;
+            }
+            continue;
+        }
+        consecutiveFailures = 0;
+        
+        // The candidate and whichever of its ancestors are not in yet,
+        // parents first
+        std::unordered_set<std::string> ancestors;
+        collectAncestors(candidate, ancestors);
+        std::vector<const std::string*> members;
+        for (const auto& ancestor : ancestors) {
+            if (included.count(ancestor) == 0) {
+                members.push_back(&ancestor);
+            }
+        }
+        members.push_back(&candidate);
+        std::sort(members.begin(), members.end(), [this](const std::string* a, const std::string* b) {
+            return entries.at(*a).ancestorCount < entries.at(*b).ancestorCount;
+        });
+        
+        for (const std::string* member : members) {
+            const PoolEntry& entry = entries.at(*member);
+            included.insert(*member);
+            result->transactions.push_back(entry.transaction);
+            result->totalFees += entry.own.fee;
+            result->totalBytes += entry.own.bytes;
+            result->totalGas += entry.own.gas;
+            
+            auto modifiedIt = modified.find(*member);
+            if (modifiedIt != modified.end()) {
+                modifiedScores.erase({modifiedIt->second.feeRate(), *member});
+                modified.erase(modifiedIt);
+            }
+        }
+        
+        for (const std::string* member : members) {
+            const PoolEntry& entry = entries.at(*member);
+            std::unordered_set<std::string> descendants;
+            collectDescendants(*member, descendants);
+            for (const auto& descendant : descendants) {
+                if (included.count(descendant) > 0) continue;
+                
+                auto [it, isNew] = modified.try_emplace(descendant, entries.at(descendant).withAncestors);
+                if (!isNew) {
+                    modifiedScores.erase({it->second.feeRate(), descendant});
+                }
+                it->second -= entry.own;
+                if (failed.count(descendant) == 0) {
+                    modifiedScores.insert({it->second.feeRate(), descendant});
+                }
+            }
+        }
+    }
+    
+    cachedTemplate = result;
+    templateVersion = version;
+    templateMaxBytes = maxBytes;
+    templateMaxGas = maxGas;
+    return result;
+}
+
+bool MemoryPool::contains(const std::string& txHash) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return entries.count(txHash) > 0;
+}
+
+size_t MemoryPool::size() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return entries.size();
+}
+
+size_t MemoryPool::getTotalBytes() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return totalBytes;
+}
+
+bool MemoryPool::isFull() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return entries.size() >= maxSize;
+}
\ No newline at end of file
@@ -1,29 +1,129 @@
 #pragma once
 #include <vector>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <mutex>
 #include <memory>
+#include <algorithm>
 #include "../core/transaction.hpp"
 
+// Transactions selected for the next block, in an order where every
+// transaction follows the in-pool transactions it spends
+struct BlockTemplate {
+    std::vector<Transaction> transactions;
+    double totalFees = 0;
+    size_t totalBytes = 0;
+    uint64_t totalGas = 0;
+};
+
+// Pending transactions, ranked for block assembly by ancestor package
+// fee rate. A transaction that spends another pool transaction is only
+// worth including together with it, so each entry carries the fee, size
+// and gas of itself plus all its in-pool ancestors, kept up to date as
+// entries come and go. Size and gas are folded into one virtual size,
+// so the two budgets are priced together.
 class MemoryPool {
+public:
+    // Gas that costs as much block space as one byte
+    static constexpr uint64_t GAS_PER_BYTE = 16;
+    
 private:
+    struct Package {
+        double fee = 0;
+        size_t bytes = 0;
+        uint64_t gas = 0;
+        
+        size_t virtualSize() const;
+        double feeRate() const { return fee / static_cast<double>(std::max<size_t>(1, virtualSize())); }
+        
+        Package& operator+=(const Package& other);
+        Package& operator-=(const Package& other);
+    };
+    
     struct PoolEntry {
         Transaction transaction;
         time_t timestamp;
         uint32_t priority;
+        Package own;
+        Package withAncestors;
+        size_t ancestorCount;               // Including itself
+        std::unordered_set<std::string> parents;
+        std::unordered_set<std::string> children;
     };
     
-    std::vector<PoolEntry> pool;
-    std::mutex poolMutex;
+    // Best package fee rate first; hash breaks ties deterministically
+    struct ScoreKey {
+        double feeRate;
+        std::string txHash;
+        
+        bool operator<(const ScoreKey& other) const {
+            if (feeRate != other.feeRate) return feeRate > other.feeRate;
+            return txHash < other.txHash;
+        }
+    };
+    
+    std::unordered_map<std::string, PoolEntry> entries;
+    std::set<ScoreKey> byAncestorScore;
+    
+    // "txHash:index" -> pool transaction spending that output
+    std::unordered_map<std::string, std::string> spentOutputs;
+    mutable std::mutex poolMutex;
     size_t maxSize;
+    size_t totalBytes;
+    
+    // Bumped on every change so an unchanged pool reuses its last template
+    uint64_t version;
+    mutable uint64_t templateVersion;
+    mutable size_t templateMaxBytes;
+    mutable uint64_t templateMaxGas;
+    mutable std::shared_ptr<const BlockTemplate> cachedTemplate;
     
 public:
-    MemoryPool(size_t maxSizeIn = 5000) : maxSize(maxSizeIn) {}
+    // Stops filling a template after this many packages in a row fail to fit
+    static constexpr size_t MAX_CONSECUTIVE_FAILURES = 1000;
+    
+    // Longer in-pool chains are refused, bounding per-entry bookkeeping
+    static constexpr size_t MAX_ANCESTORS = 25;
     
+    MemoryPool(size_t maxSizeIn = 5000);
+    
+    // Refuses duplicates, conflicting spends, contract calls that do not
+    // prepay their gas and chains past MAX_ANCESTORS. When full, evicts the
+    // lowest-ranked package to make room, or refuses a transaction that
+    // does not outrank it.
     bool addTransaction(const Transaction& tx, uint32_t priority = 1);
     std::vector<Transaction> getHighestPriorityTransactions(size_t count);
+    
+    // Drops a transaction and everything that spends it
     void removeTransaction(const std::string& txHash);
+    
+    // Drops transactions confirmed by a block; their in-pool descendants
+    // stay and no longer count them as ancestors
+    void removeForBlock(const std::vector<Transaction>& transactions);
+    
+    // Drops transactions older than maxAgeSeconds, with their descendants.
+    // Scans the whole pool, so it is meant for a timer, not every insert.
     void cleanup(uint32_t maxAgeSeconds = 3600);
     
-    size_t size() const { return pool.size(); }
-    bool isFull() const { return pool.size() >= maxSize; }
-}; 
\ No newline at end of file
+    // Greedy selection by ancestor package fee rate within the byte and
+    // gas budgets. Walks only as far down the ranking as the budgets need.
+    std::shared_ptr<const BlockTemplate> buildTemplate(size_t maxBytes, uint64_t maxGas) const;
+    
+    bool contains(const std::string& txHash) const;
+    size_t size() const;
+    size_t getTotalBytes() const;
+    bool isFull() const;
+    
+private:
+    static Package packageOf(const Transaction& tx);
+    static std::string outputKey(const TransactionInput& input);
+    
+    void collectAncestors(const std::string& txHash, std::unordered_set<std::string>& ancestors) const;
+    void collectDescendants(const std::string& txHash, std::unordered_set<std::string>& descendants) const;
+    void removeEntries(const std::unordered_set<std::string>& hashes);
+    
+    ScoreKey scoreKey(const std::string& txHash, const PoolEntry& entry) const {
+        return {entry.withAncestors.feeRate(), txHash};
+    }
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded multi-producer single-consumer queue. Producers claim slots with
+// one CAS on a ring of sequence-numbered cells (Vyukov's bounded queue),
+// so neither side takes a lock on the fast path. The consumer can block
+// until an item arrives or a deadline passes; producers only touch the
+// mutex to wake it when it has announced that it is asleep.
+template<typename T>
+class BoundedMpscQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        std::optional<T> value;
+    };
+    
+    static constexpr size_t CACHE_LINE = 64;
+    
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(CACHE_LINE) std::atomic<size_t> enqueuePos;
+    alignas(CACHE_LINE) std::atomic<size_t> dequeuePos;    // Written by the consumer only
+    
+    alignas(CACHE_LINE) std::atomic<bool> consumerWaiting;
+    std::atomic<bool> interrupted;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    
+public:
+    // Capacity is rounded up to a power of two
+    explicit BoundedMpscQueue(size_t capacityIn)
+        : enqueuePos(0),
+          dequeuePos(0),
+          consumerWaiting(false),
+          interrupted(false) {
+        size_t capacity = 2;
+        while (capacity < capacityIn) {
+            capacity <<= 1;
+        }
+        cells.reset(new Cell[capacity]);
+        mask = capacity - 1;
+        for (size_t i = 0; i < capacity; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    BoundedMpscQueue(const BoundedMpscQueue&) = delete;
+    BoundedMpscQueue& operator=(const BoundedMpscQueue&) = delete;
+    
+    // Fails without blocking when the queue is full
+    bool tryPush(T item) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        
+        cell->value.emplace(std::move(item));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        
+        // Pairs with the fence in waitUntil: either the consumer sees this
+        // item or we see that it is waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumerWaiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            wakeCondition.notify_one();
+        }
+        return true;
+    }
+    
+    // Consumer thread only
+    bool tryPop(T& item) {
+        const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = &cells[pos & mask];
+        if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        
+        item = std::move(*cell->value);
+        cell->value.reset();
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+    
+    // Consumer thread only. Blocks until an item is available, the
+    // deadline passes or interrupt() is called; returns whether an item
+    // is available.
+    template<typename Clock, typename Duration>
+    bool waitUntil(const std::chrono::time_point<Clock, Duration>& deadline) {
+        if (hasItem()) {
+            return true;
+        }
+        
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        consumerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        while (!hasItem() && !interrupted.load(std::memory_order_acquire)) {
+            if (wakeCondition.wait_until(lock, deadline) == std::cv_status::timeout) {
+                break;
+            }
+        }
+        
+        consumerWaiting.store(false, std::memory_order_relaxed);
+        return hasItem();
+    }
+    
+    // Wakes the consumer for good, e.g. on shutdown
+    void interrupt() {
+        interrupted.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondition.notify_all();
+    }
+    
+    void resume() {
+        interrupted.store(false, std::memory_order_release);
+    }
+    
+    bool isInterrupted() const { return interrupted.load(std::memory_order_acquire); }
+    size_t capacity() const { return mask + 1; }
+    
+    // Approximate while producers are active
+    size_t size() const {
+        const size_t tail = dequeuePos.load(std::memory_order_relaxed);
+        const size_t head = enqueuePos.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+    
+private:
+    bool hasItem() const {
+        const size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+};
\ No newline at end of file
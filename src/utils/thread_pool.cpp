@@ -0,0 +1,248 @@
+#include "thread_pool.hpp"
+#include "block_arena.hpp"
+#include <algorithm>
+#include <exception>
+
+namespace {
+    // Pool and worker index owning the current thread, if it is a worker
+    thread_local const void* currentPool = nullptr;
+    thread_local size_t currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : nextQueue(0),
+      queuedTasks(0),
+      running(true) {
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    
+    for (size_t i = 0; i < threadCount; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wakeCondition.notify_all();
+    
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+ThreadPool& ThreadPool::getInstance() {
+    static ThreadPool instance;
+    return instance;
+}
+
+bool ThreadPool::isWorkerThread() const {
+    return currentPool == this;
+}
+
+size_t ThreadPool::currentQueueIndex() {
+    if (currentPool == this) {
+        return currentWorker;
+    }
+    return nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+}
+
+void ThreadPool::submit(Task task) {
+    WorkerQueue& queue = *queues[currentQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.queueMutex);
+        queue.tasks.push_front(std::move(task));
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        queuedTasks.fetch_add(1, std::memory_order_release);
+    }
+    wakeCondition.notify_one();
+}
+
+void ThreadPool::forEachBatch(size_t count, size_t batchSize,
+                              const std::function<void(size_t first, size_t last)>& body) {
+    batchSize = std::max<size_t>(batchSize, 1);
+    
+    // Group tasks swallow exceptions, so the first one is carried out here
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+    
+    TaskGroup group(*this);
+    for (size_t first = 0; first < count; first += batchSize) {
+        group.run([&, first]() {
+            try {
+                body(first, std::min(first + batchSize, count));
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!firstError) {
+                    firstError = std::current_exception();
+                }
+                group.cancel();
+            }
+        });
+    }
+    group.wait();
+    
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+bool ThreadPool::popTask(size_t preferredQueue, Task& task) {
+    // Own queue first (LIFO for cache locality), then steal FIFO from peers
+    for (size_t i = 0; i < queues.size(); i++) {
+        WorkerQueue& queue = *queues[(preferredQueue + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.queueMutex);
+        
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        
+        if (i == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+    
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = index;
+    
+    while (true) {
+        Task task;
+        if (popTask(index, task)) {
+            task();
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this] {
+            return !running || queuedTasks.load(std::memory_order_acquire) > 0;
+        });
+        
+        if (!running && queuedTasks.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+ThreadPool::TaskGroup::TaskGroup(ThreadPool& poolIn)
+    : pool(poolIn),
+      state(std::make_shared<State>()),
+      detached(false) {
+}
+
+ThreadPool::TaskGroup::~TaskGroup() {
+    if (!detached) {
+        wait();
+    }
+}
+
+void ThreadPool::TaskGroup::run(Task task) {
+    // Tasks allocate from the arena of the block that queued them
+    BlockArena* arena = BlockArena::currentArena();
+    
+    {
+        std::lock_guard<std::mutex> lock(state->groupMutex);
+        state->pending.push_back({std::move(task), arena});
+        state->outstanding++;
+    }
+    
+    // Each pool entry runs whichever of the group's tasks is next; it finds
+    // nothing if wait() already ran them on the waiting thread
+    pool.submit([groupState = state]() {
+        runNext(*groupState);
+    });
+}
+
+void ThreadPool::TaskGroup::cancel() {
+    // A detaching waiter may destroy the group as soon as the flag is set
+    std::shared_ptr<State> groupState = state;
+    
+    std::lock_guard<std::mutex> lock(groupState->groupMutex);
+    groupState->cancelled.store(true, std::memory_order_release);
+    groupState->groupCondition.notify_all();
+}
+
+bool ThreadPool::TaskGroup::runNext(State& groupState) {
+    QueuedTask next;
+    {
+        std::lock_guard<std::mutex> lock(groupState.groupMutex);
+        if (groupState.pending.empty()) {
+            return false;
+        }
+        next = std::move(groupState.pending.front());
+        groupState.pending.pop_front();
+    }
+    
+    if (!groupState.cancelled.load(std::memory_order_acquire)) {
+        BlockArena::Scope arenaScope(next.arena);
+        try {
+            next.task();
+        } catch (...) {
+            // Tasks report results through their own captured state
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(groupState.groupMutex);
+    if (--groupState.outstanding == 0) {
+        groupState.groupCondition.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::TaskGroup::wait() {
+    while (true) {
+        if (runNext(*state)) {
+            continue;
+        }
+        
+        // Everything left is running on other threads
+        std::unique_lock<std::mutex> lock(state->groupMutex);
+        state->groupCondition.wait(lock, [this] {
+            return state->outstanding == 0 || !state->pending.empty();
+        });
+        if (state->outstanding == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::TaskGroup::waitUntilCancelled() {
+    while (!isCancelled()) {
+        if (runNext(*state)) {
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(state->groupMutex);
+        state->groupCondition.wait(lock, [this] {
+            return state->outstanding == 0 || !state->pending.empty() ||
+                   state->cancelled.load(std::memory_order_acquire);
+        });
+        if (state->outstanding == 0) {
+            return;
+        }
+    }
+    
+    // Unstarted tasks are skipped by the pool entries that still hold the state
+    detached = true;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class BlockArena;
+
+// Persistent work-stealing thread pool. Each worker owns a deque; tasks
+// submitted from a worker go to its own deque, idle workers steal from
+// the back of their peers'.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+    
+    // Set of related tasks that can be cancelled and waited on together.
+    // Tasks that have not started when the group is cancelled are skipped.
+    class TaskGroup {
+    private:
+        struct QueuedTask {
+            Task task;
+            BlockArena* arena;
+        };
+        
+        // Shared with the pool entries that run the tasks, which may still
+        // be queued after the group is gone
+        struct State {
+            std::deque<QueuedTask> pending;
+            size_t outstanding = 0;
+            std::atomic<bool> cancelled{false};
+            std::mutex groupMutex;
+            std::condition_variable groupCondition;
+        };
+        
+        ThreadPool& pool;
+        std::shared_ptr<State> state;
+        bool detached;
+        
+    public:
+        explicit TaskGroup(ThreadPool& poolIn);
+        ~TaskGroup();
+        
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+        
+        void run(Task task);
+        void cancel();
+        bool isCancelled() const { return state->cancelled.load(std::memory_order_acquire); }
+        
+        // Blocks until every task has finished or been skipped. The calling
+        // thread runs the group's own unstarted tasks meanwhile, so waiting
+        // from inside a pool task cannot deadlock, and never picks up
+        // unrelated pool work that might need locks the caller holds.
+        void wait();
+        
+        // Like wait(), but returns as soon as the group is cancelled rather
+        // than waiting for tasks already running; those must own everything
+        // they touch. The destructor then no longer blocks either.
+        void waitUntilCancelled();
+        
+    private:
+        // Runs the group's oldest unstarted task, if any
+        static bool runNext(State& state);
+    };
+    
+private:
+    struct WorkerQueue {
+        std::deque<Task> tasks;
+        std::mutex queueMutex;
+    };
+    
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue;
+    std::atomic<size_t> queuedTasks;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    bool running;
+    
+public:
+    explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Process-wide pool shared by validation, consensus and execution
+    static ThreadPool& getInstance();
+    
+    void submit(Task task);
+    
+    // Runs body(first, last) over [0, count) in batches of batchSize and
+    // returns once all are done. The first exception a batch throws
+    // cancels the batches not yet started and is rethrown here.
+    void forEachBatch(size_t count, size_t batchSize,
+                      const std::function<void(size_t first, size_t last)>& body);
+    
+    size_t getThreadCount() const { return workers.size(); }
+    
+    // True on this pool's own worker threads
+    bool isWorkerThread() const;
+    
+private:
+    void workerLoop(size_t index);
+    bool popTask(size_t preferredQueue, Task& task);
+    size_t currentQueueIndex();
+};
\ No newline at end of file
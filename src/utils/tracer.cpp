@@ -0,0 +1,152 @@
+#include "tracer.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+
+Tracer::Tracer()
+    : enabled(false),
+      maxEvents(DEFAULT_MAX_EVENTS),
+      flushedEvents(0),
+      epoch(std::chrono::steady_clock::now()) {
+    const char* path = std::getenv(TRACE_FILE_ENV);
+    if (path != nullptr && *path != '\0') {
+        enable(path);
+    }
+}
+
+Tracer* Tracer::getInstance() {
+    // Never destroyed, so spans closing during static destruction still
+    // have a tracer to record into
+    static Tracer* instance = new Tracer();
+    return instance;
+}
+
+void Tracer::enable(const std::string& path, size_t maxEventsIn) {
+    std::lock_guard<std::mutex> flushLock(flushMutex);
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    outputPath = path;
+    flushedEvents = 0;
+    maxEvents = maxEventsIn;
+    events.reserve(std::min<size_t>(maxEvents, 4096));
+    enabled.store(true, std::memory_order_release);
+}
+
+void Tracer::disable() {
+    enabled.store(false, std::memory_order_release);
+}
+
+uint64_t Tracer::traceIdFor(const std::string& blockHash) {
+    // Block hashes are hex digests, so the leading 16 characters are
+    // already uniformly distributed
+    uint64_t id = 0;
+    for (size_t i = 0; i < blockHash.size() && i < 16; i++) {
+        char c = blockHash[i];
+        uint64_t nibble = (c >= '0' && c <= '9') ? c - '0' :
+                          (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                          (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0;
+        id = (id << 4) | nibble;
+    }
+    return id;
+}
+
+void Tracer::record(const char* name, const char* category, uint64_t traceId,
+                    std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end) {
+    TraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.traceId = traceId;
+    event.startMicros = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch).count();
+    event.durationMicros = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    event.threadId = currentThreadId();
+
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    if (events.size() >= maxEvents) {
+        // Drop rather than grow without bound on long runs
+        return;
+    }
+    events.push_back(std::move(event));
+}
+
+bool Tracer::flush() {
+    std::lock_guard<std::mutex> flushLock(flushMutex);
+    
+    std::vector<TraceEvent> pending;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(eventsMutex);
+        pending.swap(events);
+        path = outputPath;
+    }
+
+    if (path.empty()) {
+        return false;
+    }
+
+    const bool firstFlush = flushedEvents == 0;
+    std::ofstream out(path, firstFlush ? std::ios::trunc : std::ios::app);
+    if (!out.is_open()) {
+        return false;
+    }
+
+    const int pid = static_cast<int>(getpid());
+    if (firstFlush) {
+        out << "[";
+    }
+    for (const TraceEvent& event : pending) {
+        std::stringstream traceId;
+        traceId << std::hex << std::setw(16) << std::setfill('0') << event.traceId;
+
+        if (flushedEvents++ > 0) out << ",";
+        out << "\n{\"name\":\"" << escapeJson(event.name) << "\""
+            << ",\"cat\":\"" << escapeJson(event.category) << "\""
+            << ",\"ph\":\"X\""
+            << ",\"ts\":" << event.startMicros
+            << ",\"dur\":" << event.durationMicros
+            << ",\"pid\":" << pid
+            << ",\"tid\":" << event.threadId
+            << ",\"args\":{\"traceId\":\"" << traceId.str() << "\"}}";
+    }
+    out.flush();
+
+    return out.good();
+}
+
+uint32_t Tracer::currentThreadId() {
+    // Dense per-thread IDs keep the trace viewer's thread lanes readable
+    static std::atomic<uint32_t> nextThreadId{1};
+    thread_local uint32_t threadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+    return threadId;
+}
+
+std::string Tracer::escapeJson(const std::string& input) {
+    std::string escaped;
+    escaped.reserve(input.size());
+    for (char c : input) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+Tracer::Span::Span(const char* nameIn, const char* categoryIn, uint64_t traceIdIn)
+    : name(nameIn),
+      category(categoryIn),
+      traceId(traceIdIn),
+      active(Tracer::getInstance()->isEnabled()) {
+    if (active) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+Tracer::Span::~Span() {
+    if (active) {
+        Tracer::getInstance()->record(name, category, traceId, start,
+                                      std::chrono::steady_clock::now());
+    }
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+// Lightweight span tracer exported as Chrome trace-event JSON
+// (load the output file in chrome://tracing or Perfetto). Off by default;
+// set BLOCKCHAIN_TRACE_FILE to the output path to trace from startup, or
+// call enable(). The file uses the array form of the format, whose closing
+// bracket is optional, so each flush appends to what earlier ones wrote.
+class Tracer {
+private:
+    struct TraceEvent {
+        std::string name;
+        std::string category;
+        uint64_t traceId;
+        uint64_t startMicros;
+        uint64_t durationMicros;
+        uint32_t threadId;
+    };
+
+    std::vector<TraceEvent> events;
+    std::mutex eventsMutex;
+    std::atomic<bool> enabled;
+    std::string outputPath;
+    size_t maxEvents;
+    
+    // Serializes flushes so events land in the file in flush order
+    std::mutex flushMutex;
+    size_t flushedEvents;
+    std::chrono::steady_clock::time_point epoch;
+
+    Tracer();
+
+public:
+    static constexpr size_t DEFAULT_MAX_EVENTS = 1 << 20;
+    static constexpr const char* TRACE_FILE_ENV = "BLOCKCHAIN_TRACE_FILE";
+
+    class Span {
+    private:
+        const char* name;
+        const char* category;
+        uint64_t traceId;
+        std::chrono::steady_clock::time_point start;
+        bool active;
+
+    public:
+        Span(const char* nameIn, const char* categoryIn, uint64_t traceIdIn);
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+        
+        // For spans opened before the ID is known, e.g. ahead of decoding
+        // the block it derives from
+        void setTraceId(uint64_t traceIdIn) { traceId = traceIdIn; }
+    };
+
+    static Tracer* getInstance();
+
+    // Trace lifecycle
+    void enable(const std::string& path, size_t maxEventsIn = DEFAULT_MAX_EVENTS);
+    void disable();
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    
+    // Writes the recorded events out and clears them. The first flush
+    // after enable() starts a new file; later ones append to it.
+    bool flush();
+
+    // Derive a stable trace ID from a block hash so every stage can
+    // correlate its spans without threading extra state through the API
+    static uint64_t traceIdFor(const std::string& blockHash);
+
+private:
+    void record(const char* name, const char* category, uint64_t traceId,
+                std::chrono::steady_clock::time_point start,
+                std::chrono::steady_clock::time_point end);
+    static uint32_t currentThreadId();
+    static std::string escapeJson(const std::string& input);
+};
+
+// Macro for scoped spans; the variable name includes the line number so
+// several spans can be opened in the same scope
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name, traceId) \
+    Tracer::Span TRACE_CONCAT(traceSpan_, __LINE__)(name, "block", traceId)
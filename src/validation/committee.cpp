@@ -0,0 +1,66 @@
+#include "committee.hpp"
+#include "../crypto/hash.hpp"
+#include <algorithm>
+#include <cmath>
+
+std::string CommitteeSelector::deriveSeed(const std::string& previousBlockHash) {
+    return SHA256::hashWithSalt(previousBlockHash, "committee");
+}
+
+double CommitteeSelector::selectionWeight(const Validator& validator) {
+    // Stake scaled by reputation (0-100), so misbehaving validators are
+    // picked less often even with a large stake
+    return validator.getStakingAmount() * (validator.getReputation() / 100.0);
+}
+
+double CommitteeSelector::uniformFromHash(const std::string& seed, const std::string& address) {
+    // 52 bits of the digest map exactly onto a double in (0, 1)
+    std::string digest = SHA256::hash(seed + address);
+    uint64_t bits = std::stoull(digest.substr(0, 13), nullptr, 16);
+    return (static_cast<double>(bits) + 0.5) / static_cast<double>(1ULL << 52);
+}
+
+std::vector<std::shared_ptr<Validator>> CommitteeSelector::selectCommittee(
+    const std::vector<std::shared_ptr<Validator>>& validators,
+    const std::string& seed,
+    size_t committeeSize) {
+    
+    struct Candidate {
+        double key;
+        std::shared_ptr<Validator> validator;
+    };
+    
+    // Efraimidis-Spirakis: key = ln(u) / w, the committeeSize largest keys
+    // form a weighted sample without replacement
+    std::vector<Candidate> candidates;
+    candidates.reserve(validators.size());
+    for (const auto& validator : validators) {
+        double weight = selectionWeight(*validator);
+        if (weight <= 0) continue;
+        
+        double u = uniformFromHash(seed, validator->getAddress());
+        candidates.push_back({std::log(u) / weight, validator});
+    }
+    
+    auto byKey = [](const Candidate& a, const Candidate& b) {
+        if (a.key != b.key) return a.key > b.key;
+        return a.validator->getAddress() < b.validator->getAddress();
+    };
+    
+    size_t selected = std::min(committeeSize, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + selected, candidates.end(), byKey);
+    
+    std::vector<std::shared_ptr<Validator>> committee;
+    committee.reserve(selected);
+    for (size_t i = 0; i < selected; i++) {
+        committee.push_back(candidates[i].validator);
+    }
+    
+    // Canonical order so vote vectors line up across nodes
+    std::sort(committee.begin(), committee.end(),
+              [](const std::shared_ptr<Validator>& a, const std::shared_ptr<Validator>& b) {
+                  return a->getAddress() < b->getAddress();
+              });
+    
+    return committee;
+}
\ No newline at end of file
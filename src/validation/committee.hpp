@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "validator.hpp"
+
+// Deterministic stake- and reputation-weighted committee sampling.
+// Every node derives the same committee for a block from public data
+// (the previous block hash and the validator set), so the selection can
+// be checked by anyone.
+class CommitteeSelector {
+public:
+    static constexpr size_t DEFAULT_COMMITTEE_SIZE = 16;
+    
+    // Seed is taken from the parent block so it is fixed before the block
+    // is proposed and cannot be ground by the proposer
+    static std::string deriveSeed(const std::string& previousBlockHash);
+    
+    // Weighted sampling without replacement; returns at most committeeSize
+    // validators in a canonical order
+    static std::vector<std::shared_ptr<Validator>> selectCommittee(
+        const std::vector<std::shared_ptr<Validator>>& validators,
+        const std::string& seed,
+        size_t committeeSize);
+    
+    static double selectionWeight(const Validator& validator);
+    
+private:
+    static double uniformFromHash(const std::string& seed, const std::string& address);
+};
\ No newline at end of file
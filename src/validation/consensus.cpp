@@ -1,54 +1,125 @@
 #include "consensus.hpp"
+#include "../utils/tracer.hpp"
+#include "../utils/block_arena.hpp"
 #include <algorithm>
 #include <chrono>
+#include <atomic>
 
 ConsensusManager::ConsensusManager(ConsensusType typeIn, uint32_t requiredValidatorsIn)
     : type(typeIn),
       requiredValidators(requiredValidatorsIn),
-      consensusThreshold(75) {
+      consensusThreshold(75),
+      committeeSize(CommitteeSelector::DEFAULT_COMMITTEE_SIZE),
+      votePool(ThreadPool::getInstance()),
+      consensusHistory(CONSENSUS_HISTORY_SIZE),
+      roundCounter(0) {
+    for (auto& slot : consensusHistory) {
+        slot = std::make_shared<ConsensusRound>();
+    }
 }
 
 bool ConsensusManager::achieveConsensus(const Block& block) {
-    if (activeValidators.size() < requiredValidators) {
+    const uint64_t traceId = Tracer::traceIdFor(block.getHash());
+    TRACE_SPAN("consensus.achieveConsensus", traceId);
+    
+    if (activeValidators.empty() || activeValidators.size() < requiredValidators) {
         return false;
     }
     
-    ConsensusRound round;
-    round.roundNumber = consensusHistory.size();
-    round.blockHash = block.getHash();
-    
-    // Collect votes from validators
-    collectValidatorVotes(block);
+    std::vector<std::shared_ptr<Validator>> voters = selectVoters(block);
+    if (voters.empty()) {
+        return false;
+    }
     
-    // Calculate consensus
-    uint32_t positiveVotes = 0;
-    for (const auto& [_, vote] : round.validatorVotes) {
-        if (vote) positiveVotes++;
+    // Reuse a preallocated slot, whose vote vector keeps its capacity,
+    // unless late votes from an earlier round still hold it
+    std::shared_ptr<ConsensusRound>& slot = consensusHistory[roundCounter % CONSENSUS_HISTORY_SIZE];
+    if (slot.use_count() > 1) {
+        slot = std::make_shared<ConsensusRound>();
     }
+    std::shared_ptr<ConsensusRound> round = slot;
+    round->roundNumber = roundCounter++;
+    round->blockHash = block.getHash();
+    round->validatorVotes.assign(voters.size(), VoteState::PENDING);
+    round->isComplete = false;
     
-    double consensusPercentage = (positiveVotes * 100.0) / activeValidators.size();
-    round.isComplete = true;
-    consensusHistory.push_back(round);
+    // Collect votes from validators
+    bool approved;
+    {
+        TRACE_SPAN("consensus.collectVotes", traceId);
+        approved = collectValidatorVotes(block, std::move(voters), round);
+    }
     
-    return consensusPercentage >= consensusThreshold;
+    round->isComplete = true;
+    return approved;
 }
 
-void ConsensusManager::collectValidatorVotes(const Block& block) {
-    std::vector<std::future<bool>> validatorFutures;
-    
-    // Parallel validation
-    for (const auto& validator : activeValidators) {
-        validatorFutures.push_back(
-            std::async(std::launch::async, 
-                      &Validator::validateBlock, 
-                      validator.get(), 
-                      std::ref(block))
-        );
+std::vector<std::shared_ptr<Validator>> ConsensusManager::selectVoters(const Block& block) const {
+    if (type != ConsensusType::STAKE_WEIGHTED_COMMITTEE) {
+        return activeValidators;
     }
     
-    // Collect results
-    for (size_t i = 0; i < activeValidators.size(); i++) {
-        bool vote = validatorFutures[i].get();
-        consensusHistory.back().validatorVotes[activeValidators[i]->getAddress()] = vote;
+    // Committee size is fixed, so per-block validation work does not grow
+    // with the validator set
+    std::string seed = CommitteeSelector::deriveSeed(block.getPreviousHash());
+    return CommitteeSelector::selectCommittee(activeValidators, seed, committeeSize);
+}
+
+bool ConsensusManager::collectValidatorVotes(const Block& block,
+                                             std::vector<std::shared_ptr<Validator>> voters,
+                                             std::shared_ptr<ConsensusRound> round) {
+    // Everything the vote tasks touch, owned jointly with them since the
+    // round returns while stragglers are still validating
+    struct VoteTally {
+        Block block;
+        std::vector<std::shared_ptr<Validator>> voters;
+        std::shared_ptr<ConsensusRound> round;
+        size_t requiredApprovals;
+        size_t maxRejections;
+        std::atomic<size_t> approvals{0};
+        std::atomic<size_t> rejections{0};
+        std::atomic<bool> decided{false};
+        
+        VoteTally(const Block& blockIn, std::vector<std::shared_ptr<Validator>> votersIn,
+                  std::shared_ptr<ConsensusRound> roundIn, uint32_t threshold)
+            : block(blockIn),
+              voters(std::move(votersIn)),
+              round(std::move(roundIn)),
+              requiredApprovals((voters.size() * threshold + 99) / 100),
+              maxRejections(voters.size() - std::min(requiredApprovals, voters.size())) {
+        }
+    };
+    
+    auto tally = std::make_shared<VoteTally>(block, std::move(voters), std::move(round), consensusThreshold);
+    
+    // Stragglers may outlive any arena the caller is validating under
+    BlockArena::Scope noArena(nullptr);
+    
+    // Parallel validation on the persistent pool. The task that decides
+    // the outcome cancels the group, which skips queued votes and lets
+    // the round return without waiting for the ones still running.
+    ThreadPool::TaskGroup group(votePool);
+    for (size_t i = 0; i < tally->voters.size(); i++) {
+        group.run([tally, &group, i]() {
+            if (tally->decided.load(std::memory_order_acquire)) {
+                return;
+            }
+            
+            bool vote = tally->voters[i]->validateBlock(tally->block);
+            tally->round->validatorVotes[i] = vote ? VoteState::APPROVED : VoteState::REJECTED;
+            
+            size_t approved = vote ? tally->approvals.fetch_add(1) + 1 : tally->approvals.load();
+            size_t rejected = vote ? tally->rejections.load() : tally->rejections.fetch_add(1) + 1;
+            
+            // Only the first task to decide touches the group, which the
+            // waiting round keeps alive until it is cancelled
+            if ((approved >= tally->requiredApprovals || rejected > tally->maxRejections) &&
+                !tally->decided.exchange(true, std::memory_order_acq_rel)) {
+                group.cancel();
+            }
+        });
     }
-} 
\ No newline at end of file
+    group.waitUntilCancelled();
+    
+    return tally->approvals.load() >= tally->requiredApprovals;
+}
\ No newline at end of file
@@ -3,11 +3,14 @@
 #include <memory>
 #include "../core/block.hpp"
 #include "validator.hpp"
+#include "committee.hpp"
+#include "../utils/thread_pool.hpp"
 
 enum class ConsensusType {
     PROOF_OF_PARTICIPATION,
     PROOF_OF_STAKE,
-    HYBRID
+    HYBRID,
+    STAKE_WEIGHTED_COMMITTEE  // Per-block committee instead of the full set
 };
 
 class ConsensusManager {
@@ -15,24 +18,38 @@ private:
     ConsensusType type;
     uint32_t requiredValidators;
     uint32_t consensusThreshold;
+    size_t committeeSize;
     std::vector<std::shared_ptr<Validator>> activeValidators;
+    ThreadPool& votePool;
+    
+    enum class VoteState : uint8_t {
+        PENDING,
+        APPROVED,
+        REJECTED
+    };
     
     struct ConsensusRound {
-        uint32_t roundNumber;
+        uint64_t roundNumber;
         std::string blockHash;
-        std::unordered_map<std::string, bool> validatorVotes;
+        std::vector<VoteState> validatorVotes; // Indexed like the round's voters
         bool isComplete;
     };
     
-    std::vector<ConsensusRound> consensusHistory;
+    // Fixed-size ring of recent rounds. Vote tasks still running after a
+    // round is decided share ownership of it, so a slot is only reused
+    // once they have let go.
+    static constexpr size_t CONSENSUS_HISTORY_SIZE = 256;
+    std::vector<std::shared_ptr<ConsensusRound>> consensusHistory;
+    uint64_t roundCounter;
     
 public:
     ConsensusManager(ConsensusType typeIn, uint32_t requiredValidatorsIn);
     
     // Consensus operations
     bool achieveConsensus(const Block& block);
-    void collectValidatorVotes(const Block& block);
     bool finalizeBlock(const Block& block);
+    std::vector<std::shared_ptr<Validator>> selectVoters(const Block& block) const;
+    void setCommitteeSize(size_t size) { committeeSize = size; }
     
     // Validator management
     void registerValidator(std::shared_ptr<Validator> validator);
@@ -41,4 +58,9 @@ public:
     // Consensus metrics
     double getConsensusRate() const;
     uint32_t getActiveValidatorCount() const;
+    
+private:
+    bool collectValidatorVotes(const Block& block,
+                               std::vector<std::shared_ptr<Validator>> voters,
+                               std::shared_ptr<ConsensusRound> round);
 }; 
\ No newline at end of file
@@ -44,7 +44,7 @@ public:
     void updateHardwareSpecs(const HardwareSpecs& newSpecs);
     
     // Getters
-    std::string getAddress() const { return address; }
+    const std::string& getAddress() const { return address; }
     ValidatorType getType() const { return type; }
     double getStakingAmount() const { return stakingAmount; }
 }; 
\ No newline at end of file
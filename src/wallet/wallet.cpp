@@ -2,12 +2,57 @@
 #include <random>
 #include <sstream>
 #include "../crypto/hash.hpp"
+#include "../utils/thread_pool.hpp"
+#include <algorithm>
+#include <optional>
 
-Wallet::Wallet() {
+namespace {
+    // New arrivals below this count are decrypted on the calling thread
+    constexpr size_t PARALLEL_DECRYPT_THRESHOLD = 32;
+    constexpr size_t DECRYPT_BATCH_SIZE = 16;
+    
+    // Batch creation below this count stays on the calling thread
+    constexpr size_t PARALLEL_CREATE_THRESHOLD = 32;
+    constexpr size_t CREATE_BATCH_SIZE = 64;
+    
+    template<typename Fn>
+    void forEachParallel(size_t count, Fn fn) {
+        if (count < PARALLEL_CREATE_THRESHOLD) {
+            for (size_t i = 0; i < count; i++) {
+                fn(i);
+            }
+            return;
+        }
+        
+        // The first failure cancels the remaining batches and is rethrown
+        ThreadPool::getInstance().forEachBatch(count, CREATE_BATCH_SIZE, [&fn](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                fn(i);
+            }
+        });
+    }
+    
+    // Message recipients are given by address or by public key. Only a
+    // public key can be encrypted to directly; an address alone has no
+    // key to resolve.
+    struct Recipient {
+        std::string address;
+        std::string publicKey;
+    };
+    
+    Recipient resolveRecipient(const std::string& recipient) {
+        if (Encryption::isPublicKey(recipient)) {
+            return {Encryption::deriveAddress(recipient), recipient};
+        }
+        return {recipient, ""};
+    }
+}
+
+Wallet::Wallet() : decryptedThrough(0) {
     generateNewKeys();
 }
 
-Wallet::Wallet(const std::string& privateKeyIn) {
+Wallet::Wallet(const std::string& privateKeyIn) : decryptedThrough(0) {
     if (!importPrivateKey(privateKeyIn)) {
         generateNewKeys();
     }
@@ -30,7 +75,7 @@ void Wallet::generateNewKeys() {
     publicKey = Encryption::generatePublicKey(privateKey);
     
     // Generate address (starting with 'M')
-    address = "M" + SHA256::hash(publicKey).substr(0, 30);
+    address = Encryption::deriveAddress(publicKey);
 }
 
 Transaction Wallet::createTransaction(const std::string& recipient, double amount) {
@@ -40,43 +85,199 @@ Transaction Wallet::createTransaction(const std::string& recipient, double amoun
     
     Transaction transaction(address, recipient, TransactionType::FINANCIAL);
     transaction.setAmount(amount);
-    transaction.signTransaction(privateKey);
+    if (!transaction.sign(privateKey)) {
+        throw std::runtime_error("Failed to sign transaction");
+    }
     
     history.pending.push_back(transaction);
     return transaction;
 }
 
 Transaction Wallet::createMessage(const std::string& recipient, const std::string& message) {
-    Transaction messageTx(address, recipient, TransactionType::MESSAGE);
-    messageTx.setMessage(message, recipient);
-    messageTx.signTransaction(privateKey);
+    const Recipient resolved = resolveRecipient(recipient);
+    Transaction messageTx(address, resolved.address, TransactionType::MESSAGE);
+    encryptMessage(messageTx, resolved.address, resolved.publicKey, message);
+    if (!messageTx.sign(privateKey)) {
+        throw std::runtime_error("Failed to sign message");
+    }
+    
+    messageBox.sentMessages.push_back(messageTx);
+    return messageTx;
+}
+
+void Wallet::encryptMessage(Transaction& messageTx,
+                            const std::string& recipientAddress,
+                            const std::string& recipientPublicKey,
+                            const std::string& message) const {
+    // No session without the recipient's public key; one-shot encryption
+    // is the only option for a bare address
+    if (recipientPublicKey.empty()) {
+        messageTx.setMessage(message, recipientAddress);
+        return;
+    }
+    messageTx.setEncryptedMessage(sessionKeys.seal(message, privateKey, publicKey, recipientPublicKey),
+                                  recipientPublicKey);
+}
+
+std::vector<Transaction> Wallet::createTransactions(const std::vector<TransferRequest>& requests) {
+    double total = 0;
+    for (const auto& request : requests) {
+        total += request.amount;
+    }
+    if (total > balance) {
+        throw std::runtime_error("Insufficient funds");
+    }
+    
+    const SigningKey key(privateKey);
+    std::vector<Transaction> transactions;
+    transactions.reserve(requests.size());
+    for (const auto& request : requests) {
+        transactions.emplace_back(address, request.recipient, TransactionType::FINANCIAL);
+    }
+    
+    // Each task touches only its own slots; the key is parsed once and
+    // shared read-only
+    forEachParallel(requests.size(), [&](size_t i) {
+        transactions[i].setAmount(requests[i].amount);
+        if (!transactions[i].sign(key)) {
+            throw std::runtime_error("Failed to sign transaction");
+        }
+    });
+    
+    history.pending.insert(history.pending.end(), transactions.begin(), transactions.end());
+    return transactions;
+}
+
+std::vector<Transaction> Wallet::createMessages(const std::vector<MessageRequest>& requests) {
+    const SigningKey key(privateKey);
+    std::vector<Recipient> recipients;
+    std::vector<Transaction> messages;
+    recipients.reserve(requests.size());
+    messages.reserve(requests.size());
+    for (const auto& request : requests) {
+        recipients.push_back(resolveRecipient(request.recipient));
+        messages.emplace_back(address, recipients.back().address, TransactionType::MESSAGE);
+    }
+    
+    // Messages to the same recipient share one session, so only the first
+    // of them pays for ECDH
+    forEachParallel(requests.size(), [&](size_t i) {
+        encryptMessage(messages[i], recipients[i].address, recipients[i].publicKey, requests[i].message);
+        if (!messages[i].sign(key)) {
+            throw std::runtime_error("Failed to sign message");
+        }
+    });
+    
+    messageBox.sentMessages.insert(messageBox.sentMessages.end(), messages.begin(), messages.end());
+    return messages;
+}
+
+Transaction Wallet::createGroupMessage(const std::vector<std::string>& recipientPublicKeys,
+                                       const std::string& message) {
+    // Group messages have no single recipient address; members find them
+    // by their tags
+    Transaction messageTx(address, "", TransactionType::MESSAGE);
+    messageTx.setGroupMessage(message, recipientPublicKeys);
+    if (!messageTx.sign(privateKey)) {
+        throw std::runtime_error("Failed to sign message");
+    }
     
     messageBox.sentMessages.push_back(messageTx);
     return messageTx;
 }
 
 void Wallet::receiveMessage(const Transaction& messageTx) {
-    if (messageTx.getRecipient() != address) {
+    if (messageTx.isGroupMessage()) {
+        if (!messageTx.isMessageRecipient(publicKey)) {
+            throw std::runtime_error("Message not intended for this wallet");
+        }
+    } else if (messageTx.getRecipient() != address) {
         throw std::runtime_error("Message not intended for this wallet");
     }
     
-    if (messageTx.verifySignature()) {
+    if (messageTx.verify()) {
+        std::lock_guard<std::mutex> lock(decryptionMutex);
         messageBox.receivedMessages.push_back(messageTx);
     }
 }
 
 std::vector<std::string> Wallet::getDecryptedMessages() const {
-    std::vector<std::string> decryptedMessages;
-    
-    for (const auto& messageTx : messageBox.receivedMessages) {
-        try {
-            std::string decryptedMessage = messageTx.decryptMessage(privateKey);
-            decryptedMessages.push_back(decryptedMessage);
-        } catch (const std::exception& e) {
-            // Skip messages that can't be decrypted
-            continue;
+    std::lock_guard<std::mutex> lock(decryptionMutex);
+    decryptNewMessages();
+    
+    std::vector<std::string> plaintexts;
+    plaintexts.reserve(decryptedMessages.size());
+    for (const auto& message : decryptedMessages) {
+        plaintexts.push_back(message.plaintext);
+    }
+    return plaintexts;
+}
+
+std::vector<Wallet::DecryptedMessage> Wallet::getDecryptedMessages(size_t offset, size_t limit) const {
+    std::lock_guard<std::mutex> lock(decryptionMutex);
+    decryptNewMessages();
+    
+    if (offset >= decryptedMessages.size()) {
+        return {};
+    }
+    size_t end = offset + std::min(limit, decryptedMessages.size() - offset);
+    return std::vector<DecryptedMessage>(decryptedMessages.begin() + offset,
+                                         decryptedMessages.begin() + end);
+}
+
+size_t Wallet::getDecryptedMessageCount() const {
+    std::lock_guard<std::mutex> lock(decryptionMutex);
+    decryptNewMessages();
+    return decryptedMessages.size();
+}
+
+void Wallet::decryptNewMessages() const {
+    // Caller holds decryptionMutex
+    const auto& received = messageBox.receivedMessages;
+    const size_t begin = decryptedThrough;
+    const size_t count = received.size() - begin;
+    if (count == 0) {
+        return;
+    }
+    
+    std::vector<std::optional<std::string>> plaintexts(count);
+    auto decryptRange = [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            const Transaction& messageTx = received[begin + i];
+            if (decryptedHashes.count(messageTx.getHash()) > 0) continue;
+            try {
+                if (!messageTx.isGroupMessage() &&
+                    SessionKeyCache::isEnvelope(messageTx.getEncryptedMessage())) {
+                    plaintexts[i] = sessionKeys.open(messageTx.getEncryptedMessage(), privateKey, publicKey);
+                } else {
+                    plaintexts[i] = messageTx.decryptMessage(privateKey, publicKey);
+                }
+            } catch (const std::exception& e) {
+                // Skip messages that can't be decrypted
+            }
+        }
+    };
+    
+    if (count < PARALLEL_DECRYPT_THRESHOLD) {
+        decryptRange(0, count);
+    } else {
+        // Each batch writes only its own slots, so results keep arrival order
+        ThreadPool::TaskGroup tasks(ThreadPool::getInstance());
+        for (size_t first = 0; first < count; first += DECRYPT_BATCH_SIZE) {
+            tasks.run([&, first]() {
+                decryptRange(first, std::min(first + DECRYPT_BATCH_SIZE, count));
+            });
         }
+        tasks.wait();
     }
     
-    return decryptedMessages;
+    for (size_t i = 0; i < count; i++) {
+        if (!plaintexts[i]) continue;
+        const std::string& txHash = received[begin + i].getHash();
+        // A message delivered twice in one refresh is kept once
+        if (decryptedHashes.insert(txHash).second) {
+            decryptedMessages.push_back({txHash, std::move(*plaintexts[i])});
+        }
+    }
+    decryptedThrough = received.size();
 } 
\ No newline at end of file
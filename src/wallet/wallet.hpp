@@ -2,10 +2,29 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_set>
 #include "../crypto/encryption.hpp"
+#include "../crypto/session_key_cache.hpp"
 #include "../core/transaction.hpp"
 
 class Wallet {
+public:
+    struct DecryptedMessage {
+        std::string txHash;
+        std::string plaintext;
+    };
+    
+    struct TransferRequest {
+        std::string recipient;
+        double amount;
+    };
+    
+    struct MessageRequest {
+        std::string recipient;
+        std::string message;
+    };
+    
 private:
     std::string address;
     std::string privateKey;
@@ -17,6 +36,18 @@ private:
         std::vector<Transaction> receivedMessages;
     } messageBox;
     
+    // Plaintexts of received messages in arrival order. Only messages past
+    // decryptedThrough are decrypted on a refresh; ones that fail to
+    // decrypt are skipped once and not retried.
+    mutable std::vector<DecryptedMessage> decryptedMessages;
+    mutable std::unordered_set<std::string> decryptedHashes;
+    mutable size_t decryptedThrough;
+    mutable std::mutex decryptionMutex;
+    
+    // Session keys for direct messages, so repeat traffic with the same
+    // peer skips the EC work
+    mutable SessionKeyCache sessionKeys;
+    
     // Transaction history
     struct TransactionHistory {
         std::vector<Transaction> sent;
@@ -30,13 +61,30 @@ public:
     
     // Core wallet functions
     Transaction createTransaction(const std::string& recipient, double amount);
+    
+    // The recipient is a public key or an address. Messages to a public
+    // key are addressed to its derived address and sealed under a cached
+    // session; a bare address gets one-shot encryption.
     Transaction createMessage(const std::string& recipient, const std::string& message);
+    Transaction createGroupMessage(const std::vector<std::string>& recipientPublicKeys,
+                                   const std::string& message);
     bool sendTransaction(const Transaction& transaction);
     
+    // Batch creation: one parsed signing key for the whole batch, with
+    // encryption and signing spread over the thread pool. Results are in
+    // request order.
+    std::vector<Transaction> createTransactions(const std::vector<TransferRequest>& requests);
+    std::vector<Transaction> createMessages(const std::vector<MessageRequest>& requests);
+    
     // Message handling
     void receiveMessage(const Transaction& messageTx);
     std::vector<std::string> getDecryptedMessages() const;
     
+    // Pages over decrypted messages in arrival order; only messages that
+    // arrived since the last call are decrypted
+    std::vector<DecryptedMessage> getDecryptedMessages(size_t offset, size_t limit) const;
+    size_t getDecryptedMessageCount() const;
+    
     // Balance management
     void updateBalance(double newBalance);
     double getBalance() const { return balance; }
@@ -47,7 +95,14 @@ public:
     bool exportPrivateKey(const std::string& password);
     
     // Getters
-    std::string getAddress() const { return address; }
-    std::string getPublicKey() const { return publicKey; }
-    TransactionHistory getTransactionHistory() const { return history; }
+    const std::string& getAddress() const { return address; }
+    const std::string& getPublicKey() const { return publicKey; }
+    const TransactionHistory& getTransactionHistory() const { return history; }
+    
+private:
+    void decryptNewMessages() const;
+    void encryptMessage(Transaction& messageTx,
+                        const std::string& recipientAddress,
+                        const std::string& recipientPublicKey,
+                        const std::string& message) const;
 }; 
\ No newline at end of file
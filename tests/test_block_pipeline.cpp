@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <mutex>
+#include <future>
+#include "../src/network/block_pipeline.hpp"
+#include "../src/core/transaction.hpp"
+#include "../src/crypto/encryption.hpp"
+
+class BlockPipelineTest : public ::testing::Test {
+protected:
+    std::shared_ptr<Blockchain> blockchain;
+    std::unique_ptr<BlockPipeline> pipeline;
+    
+    std::mutex commitMutex;
+    std::vector<std::pair<std::string, uint64_t>> commits;
+    
+    void SetUp() override {
+        blockchain = std::make_shared<Blockchain>();
+        
+        // Empty blocks go to the message pool, which approves them. The
+        // financial pool holds a message-only validator that refuses every
+        // transfer, so a block with one passes its state check and then
+        // fails consensus.
+        blockchain->registerValidator(
+            std::make_shared<Validator>("message-validator", ValidatorType::MESSAGE), false);
+        blockchain->registerValidator(
+            std::make_shared<Validator>("financial-validator", ValidatorType::MESSAGE), true);
+        
+        pipeline = std::make_unique<BlockPipeline>(blockchain, [this](const Block& block, uint64_t height, bool) {
+            std::lock_guard<std::mutex> lock(commitMutex);
+            commits.emplace_back(block.getHash(), height);
+        });
+    }
+    
+    void TearDown() override {
+        pipeline.reset();
+    }
+    
+    std::string genesisHash() const {
+        return blockchain->getLatestBlock().getHash();
+    }
+    
+    static Transaction transfer(bool sign) {
+        Transaction tx("sender", "recipient", TransactionType::FINANCIAL);
+        if (sign) {
+            tx.sign(Encryption::generatePrivateKey());
+        }
+        return tx;
+    }
+};
+
+TEST_F(BlockPipelineTest, CommitsInSubmissionOrder) {
+    std::vector<Block> blocks;
+    std::string previousHash = genesisHash();
+    for (uint32_t i = 1; i <= 16; i++) {
+        blocks.emplace_back(i, std::vector<Transaction>(), previousHash);
+        previousHash = blocks.back().getHash();
+    }
+    
+    std::vector<std::future<bool>> results;
+    for (const Block& block : blocks) {
+        results.push_back(pipeline->submit(block));
+    }
+    for (auto& result : results) {
+        ASSERT_TRUE(result.get());
+    }
+    
+    ASSERT_EQ(blockchain->getChainLength(), blocks.size() + 1);
+    ASSERT_EQ(blockchain->getLatestBlock().getHash(), blocks.back().getHash());
+    
+    // Each callback sees its own block and the height it was committed at
+    std::lock_guard<std::mutex> lock(commitMutex);
+    ASSERT_EQ(commits.size(), blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        ASSERT_EQ(commits[i].first, blocks[i].getHash());
+        ASSERT_EQ(commits[i].second, i + 1);
+    }
+}
+
+TEST_F(BlockPipelineTest, ConsensusRejectRollsBackStackedBlocks) {
+    Block first(1, {}, genesisHash());
+    Block rejected(2, {transfer(true)}, first.getHash());
+    Block stacked(3, {}, rejected.getHash());
+    
+    std::future<bool> firstResult = pipeline->submit(first);
+    std::future<bool> rejectedResult = pipeline->submit(rejected);
+    std::future<bool> stackedResult = pipeline->submit(stacked);
+    
+    ASSERT_TRUE(firstResult.get());
+    ASSERT_FALSE(rejectedResult.get());
+    ASSERT_FALSE(stackedResult.get());
+    ASSERT_EQ(blockchain->getChainLength(), 2u);
+    ASSERT_EQ(pipeline->getInFlightCount(), 0u);
+    
+    // The speculative tip fell back to the last accepted block
+    Block replacement(2, {}, first.getHash());
+    ASSERT_TRUE(pipeline->submit(replacement).get());
+    ASSERT_EQ(blockchain->getLatestBlock().getHash(), replacement.getHash());
+    
+    std::lock_guard<std::mutex> lock(commitMutex);
+    ASSERT_EQ(commits, (std::vector<std::pair<std::string, uint64_t>>{
+        {first.getHash(), 1}, {replacement.getHash(), 2}}));
+}
+
+TEST_F(BlockPipelineTest, BlocksBuiltOnAFailedBlockFail) {
+    // An unsigned transfer fails the stateless checks
+    Block invalid(1, {transfer(false)}, genesisHash());
+    Block child(2, {}, invalid.getHash());
+    Block grandchild(3, {}, child.getHash());
+    
+    std::future<bool> invalidResult = pipeline->submit(invalid);
+    std::future<bool> childResult = pipeline->submit(child);
+    std::future<bool> grandchildResult = pipeline->submit(grandchild);
+    
+    ASSERT_FALSE(invalidResult.get());
+    ASSERT_FALSE(childResult.get());
+    ASSERT_FALSE(grandchildResult.get());
+    ASSERT_EQ(blockchain->getChainLength(), 1u);
+    
+    std::lock_guard<std::mutex> lock(commitMutex);
+    ASSERT_TRUE(commits.empty());
+}
\ No newline at end of file
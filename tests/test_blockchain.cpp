@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 #include "../src/core/blockchain.hpp"
 #include "../src/core/transaction.hpp"
+#include "../src/core/transaction_scheduler.hpp"
+#include "../src/core/account_table.hpp"
 #include "../src/wallet/wallet.hpp"
+#include "../src/network/block_downloader.hpp"
 
 class BlockchainTest : public ::testing::Test {
 protected:
@@ -52,4 +55,134 @@ TEST_F(BlockchainTest, ValidateChain) {
     }
     
     ASSERT_TRUE(blockchain->isChainValid());
-} 
\ No newline at end of file
+} 
+
+TEST_F(BlockchainTest, ConflictFreeTransactionGroups) {
+    auto wallet3 = std::make_shared<Wallet>();
+    auto wallet4 = std::make_shared<Wallet>();
+    
+    std::vector<Transaction> transactions = {
+        Transaction(wallet1->getAddress(), wallet2->getAddress(), TransactionType::FINANCIAL),
+        Transaction(wallet3->getAddress(), wallet4->getAddress(), TransactionType::FINANCIAL),
+        Transaction(wallet2->getAddress(), wallet3->getAddress(), TransactionType::FINANCIAL)
+    };
+    
+    // Disjoint transfers land in separate groups
+    auto disjoint = TransactionScheduler::partition({transactions[0], transactions[1]});
+    ASSERT_EQ(disjoint.size(), 2);
+    
+    // The third transfer links both account pairs into one ordered group
+    auto groups = TransactionScheduler::partition(transactions);
+    ASSERT_EQ(groups.size(), 1);
+    ASSERT_EQ(groups[0], std::vector<size_t>({0, 1, 2}));
+}
+
+TEST_F(BlockchainTest, AddressInterningIsDense) {
+    AddressTable addresses;
+    
+    AccountId first = addresses.intern(wallet1->getAddress());
+    AccountId second = addresses.intern(wallet2->getAddress());
+    ASSERT_EQ(first, 0u);
+    ASSERT_EQ(second, 1u);
+    ASSERT_EQ(addresses.intern(wallet1->getAddress()), first);
+    ASSERT_EQ(addresses.find(wallet2->getAddress()), second);
+    ASSERT_EQ(addresses.find("unknown"), INVALID_ACCOUNT_ID);
+    ASSERT_EQ(addresses.getAddress(second), wallet2->getAddress());
+    ASSERT_EQ(blockchain->getBalance(wallet1->getAddress()), 0.0);
+}
+
+TEST_F(BlockchainTest, HeadersFirstDownloadCommitsInOrder) {
+    // A chain of five blocks on top of genesis, known to peers
+    std::vector<Block> remote;
+    std::string previousHash = blockchain->getLatestBlock().getHash();
+    for (uint32_t i = 1; i <= 5; i++) {
+        Transaction tx(wallet1->getAddress(), wallet2->getAddress(), TransactionType::FINANCIAL);
+        tx.setAmount(i);
+        tx.sign(wallet1->getPrivateKey());
+        remote.emplace_back(i, std::vector<Transaction>{tx}, previousHash);
+        previousHash = remote.back().getHash();
+    }
+    
+    std::vector<BlockHeader> headers;
+    for (const Block& block : remote) {
+        headers.push_back(block.getHeader());
+    }
+    
+    std::map<std::string, std::vector<std::string>> requested;
+    std::vector<uint32_t> committed;
+    BlockDownloader::Config config;
+    config.batchSize = 2;
+    config.maxBatchesPerPeer = 1;
+    config.windowSize = 4;
+    BlockDownloader downloader(
+        blockchain->getLatestBlock().getHash(), 0,
+        [&](const std::string& peerId, const std::vector<std::string>& hashes) {
+            auto& list = requested[peerId];
+            list.insert(list.end(), hashes.begin(), hashes.end());
+        },
+        [&](Block&& block) { committed.push_back(block.getIndex()); },
+        config);
+    
+    // A header that does not link to the tip is refused
+    ASSERT_FALSE(downloader.addHeaders({headers[1]}));
+    ASSERT_TRUE(downloader.addHeaders(headers));
+    ASSERT_EQ(downloader.getHeaderHeight(), 6u);
+    
+    // Bodies are requested from both peers at once
+    downloader.addPeer("a");
+    downloader.addPeer("b");
+    ASSERT_EQ(requested["a"].size(), 2u);
+    ASSERT_EQ(requested["b"].size(), 2u);
+    
+    // Later blocks wait in the reorder buffer until the gap is filled
+    ASSERT_EQ(requested["a"][0], remote[0].getHash());
+    ASSERT_TRUE(downloader.onBlock("b", remote[3]));
+    ASSERT_TRUE(downloader.onBlock("b", remote[2]));
+    ASSERT_TRUE(committed.empty());
+    ASSERT_EQ(downloader.getBufferedCount(), 2u);
+    
+    // A body matching no header is not accepted
+    Block unknown(1, {}, blockchain->getLatestBlock().getHash());
+    ASSERT_FALSE(downloader.onBlock("a", unknown));
+    
+    // Peer "a" stalls and its heights move to "b"
+    requested.clear();
+    downloader.tick(BlockDownloader::Clock::now() + config.stallTimeout);
+    ASSERT_EQ(requested["b"], std::vector<std::string>({remote[0].getHash(), remote[1].getHash()}));
+    ASSERT_TRUE(requested["a"].empty());
+    
+    // Filling the gap commits the buffered blocks and slides the window
+    ASSERT_TRUE(downloader.onBlock("b", remote[1]));
+    ASSERT_TRUE(downloader.onBlock("b", remote[0]));
+    ASSERT_EQ(committed, std::vector<uint32_t>({1, 2, 3, 4}));
+    ASSERT_EQ(requested["b"].back(), remote[4].getHash());
+    ASSERT_TRUE(downloader.onBlock("b", remote[4]));
+    
+    ASSERT_EQ(committed, std::vector<uint32_t>({1, 2, 3, 4, 5}));
+    ASSERT_TRUE(downloader.isComplete());
+}
+
+TEST_F(BlockchainTest, ServesHeadersAndBlocksByHash) {
+    std::vector<std::string> hashes = {blockchain->getLatestBlock().getHash()};
+    for (uint32_t i = 1; i <= 5; i++) {
+        Block block(i, {}, hashes.back());
+        blockchain->commitBlock(block);
+        hashes.push_back(block.getHash());
+    }
+    
+    std::vector<BlockHeader> headers = blockchain->getHeadersAfter(hashes[1], 3);
+    ASSERT_EQ(headers.size(), 3u);
+    for (size_t i = 0; i < headers.size(); i++) {
+        ASSERT_EQ(headers[i].hash, hashes[i + 2]);
+        ASSERT_EQ(headers[i].calculateHash(), headers[i].hash);
+    }
+    
+    // Nothing past the tip, and nothing for a hash not on the chain
+    ASSERT_TRUE(blockchain->getHeadersAfter(hashes.back(), 10).empty());
+    ASSERT_TRUE(blockchain->getHeadersAfter("unknown", 10).empty());
+    
+    std::optional<Block> block = blockchain->findBlock(hashes[3]);
+    ASSERT_TRUE(block.has_value());
+    ASSERT_EQ(block->getIndex(), 3u);
+    ASSERT_FALSE(blockchain->findBlock("unknown").has_value());
+}
\ No newline at end of file
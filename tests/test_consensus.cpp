@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include "../src/validation/committee.hpp"
+#include "../src/validation/consensus.hpp"
+
+class CommitteeTest : public ::testing::Test {
+protected:
+    std::vector<std::shared_ptr<Validator>> validators;
+    
+    void SetUp() override {
+        for (int i = 0; i < 64; i++) {
+            auto validator = std::make_shared<Validator>("V" + std::to_string(i), ValidatorType::HYBRID);
+            validator->stake(100.0 + i);
+            validators.push_back(validator);
+        }
+    }
+};
+
+TEST_F(CommitteeTest, SelectionIsDeterministic) {
+    std::string seed = CommitteeSelector::deriveSeed("previous-hash");
+    auto first = CommitteeSelector::selectCommittee(validators, seed, 16);
+    auto second = CommitteeSelector::selectCommittee(validators, seed, 16);
+    
+    ASSERT_EQ(first.size(), 16);
+    ASSERT_EQ(first, second);
+}
+
+TEST_F(CommitteeTest, SeedChangesCommittee) {
+    auto first = CommitteeSelector::selectCommittee(
+        validators, CommitteeSelector::deriveSeed("hash-a"), 16);
+    auto second = CommitteeSelector::selectCommittee(
+        validators, CommitteeSelector::deriveSeed("hash-b"), 16);
+    
+    ASSERT_NE(first, second);
+}
+
+TEST_F(CommitteeTest, UnstakedValidatorsAreNeverSelected) {
+    auto unstaked = std::make_shared<Validator>("Unstaked", ValidatorType::HYBRID);
+    validators.push_back(unstaked);
+    
+    auto committee = CommitteeSelector::selectCommittee(
+        validators, CommitteeSelector::deriveSeed("previous-hash"), validators.size());
+    
+    ASSERT_EQ(committee.size(), validators.size() - 1);
+    ASSERT_EQ(std::find(committee.begin(), committee.end(), unstaked), committee.end());
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include <gtest/gtest.h>
+#include "../src/core/contract_vm.hpp"
+#include "../src/core/contract_code_cache.hpp"
+#include "../src/core/optimistic_executor.hpp"
+#include "../src/core/contract_storage.hpp"
+#include "../src/core/smart_contract.hpp"
+#include "../src/utils/log_store.hpp"
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+
+class ContractVMTest : public ::testing::Test {
+protected:
+    std::unordered_map<std::string, std::string> storage;
+    std::unique_ptr<MapStorageAccess> storageAccess;
+    
+    void SetUp() override {
+        storageAccess = std::make_unique<MapStorageAccess>(storage);
+    }
+};
+
+TEST_F(ContractVMTest, CompileRejectsUnknownOpcodes) {
+    ASSERT_THROW(ContractCompiler::compile("CONSTRUCTOR PUSH 1 JUMP"), std::invalid_argument);
+    ASSERT_THROW(ContractCompiler::compile("CONSTRUCTOR PUSH"), std::invalid_argument);
+}
+
+TEST_F(ContractVMTest, ArithmeticAndStorage) {
+    auto contract = ContractCompiler::compile(
+        "CONSTRUCTOR PUSH total PUSH 2 PUSH40 ADD STORE PUSH total LOAD PUSH 3 MUL RETURN");
+    ASSERT_TRUE(contract->hasConstructor);
+    
+    ContractVM vm(*storageAccess);
+    ASSERT_EQ(vm.execute(*contract, {}, 100000), "126");
+    ASSERT_EQ(storage["total"], "42");
+}
+
+TEST_F(ContractVMTest, ParamsArePushedInOrder) {
+    auto contract = ContractCompiler::compile("CONSTRUCTOR SUB");
+    
+    ContractVM vm(*storageAccess);
+    ASSERT_EQ(vm.execute(*contract, {"10", "4"}, 100000), "6");
+}
+
+TEST_F(ContractVMTest, CodeCacheAdmitsOnlyDeployableCode) {
+    ContractCodeCache cache;
+    std::string codeHash;
+    ASSERT_THROW(cache.getOrCompile("PUSH 1 PUSH 2 ADD", codeHash), std::invalid_argument);
+    ASSERT_THROW(cache.getOrCompile("CONSTRUCTOR JUMP", codeHash), std::invalid_argument);
+    ASSERT_EQ(cache.size(), 0u);
+    
+    auto code = cache.getOrCompile("CONSTRUCTOR PUSH 1 PUSH 2 ADD", codeHash);
+    ASSERT_EQ(cache.getOrCompile("CONSTRUCTOR PUSH 1 PUSH 2 ADD", codeHash), code);
+    ASSERT_EQ(cache.get(codeHash), code);
+    ASSERT_EQ(cache.size(), 1u);
+}
+
+TEST_F(ContractVMTest, StackStringsUseTheStackResource) {
+    // Outside a block arena the stack draws on the default resource
+    struct CountingResource : std::pmr::memory_resource {
+        size_t allocations = 0;
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            allocations++;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+    
+    // Every string is too long for the small-string buffer
+    const std::string key(40, 'k');
+    const std::string value(40, 'v');
+    auto contract = ContractCompiler::compile(
+        "CONSTRUCTOR PUSH " + key + " PUSH " + value + " STORE PUSH " + key + " LOAD RETURN");
+    
+    CountingResource counting;
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(&counting);
+    ContractVM vm(*storageAccess);
+    counting.allocations = 0;
+    std::string result = vm.execute(*contract, {}, 100000);
+    std::pmr::set_default_resource(previous);
+    
+    // Two copies of the key, the value and the loaded value
+    ASSERT_EQ(result, value);
+    ASSERT_EQ(counting.allocations, 4u);
+}
+
+TEST_F(ContractVMTest, RuntimeErrorsThrow) {
+    ContractVM vm(*storageAccess);
+    ASSERT_THROW(vm.execute(*ContractCompiler::compile("ADD"), {}, 100000), std::runtime_error);
+    ASSERT_THROW(vm.execute(*ContractCompiler::compile("PUSH 1 PUSH 0 DIV"), {}, 100000), std::runtime_error);
+}
+
+TEST_F(ContractVMTest, GasIsChargedPerInstruction) {
+    auto contract = ContractCompiler::compile("CONSTRUCTOR PUSH 1 PUSH 2 ADD");
+    
+    ContractVM vm(*storageAccess);
+    vm.execute(*contract, {}, 100000);
+    ASSERT_EQ(vm.getGasUsed(), ContractVM::gasCost(OpCode::PUSH) * 2 + ContractVM::gasCost(OpCode::ADD));
+}
+
+TEST_F(ContractVMTest, OutOfGasLeavesStorageUntouched) {
+    auto contract = ContractCompiler::compile("CONSTRUCTOR PUSH key PUSH 1 STORE PUSH key PUSH 2 STORE");
+    
+    BufferedStorageAccess buffered(*storageAccess);
+    ContractVM vm(buffered);
+    ASSERT_THROW(vm.execute(*contract, {}, 250), OutOfGasError);
+    ASSERT_EQ(vm.getGasUsed(), 250);
+    ASSERT_TRUE(storage.empty());
+}
+
+TEST_F(ContractVMTest, OptimisticExecutionMatchesSerialOrder) {
+    auto increment = ContractCompiler::compile("CONSTRUCTOR PUSH count PUSH count LOAD PUSH 1 ADD STORE");
+    const std::string counterKey = OptimisticExecutor::storageKey("Mcounter", "count");
+    storage[counterKey] = "0";
+    
+    // Every call conflicts on the same key, so each must see its predecessor
+    std::vector<OptimisticExecutor::Call> calls;
+    for (int i = 0; i < 50; i++) {
+        calls.push_back({"Mcounter", increment, {}, 100000});
+    }
+    
+    OptimisticExecutor executor;
+    auto results = executor.execute(calls, [this](const std::string& key, std::string& value) {
+        return storageAccess->load(key, value);
+    });
+    
+    ASSERT_EQ(results.size(), calls.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        ASSERT_TRUE(results[i].success);
+        ASSERT_EQ(results[i].writes.at(counterKey), std::to_string(i + 1));
+    }
+}
+
+TEST_F(ContractVMTest, LogStoreDropsTornBatches) {
+    const std::string path = ::testing::TempDir() + "log_store_torn.log";
+    std::remove(path.c_str());
+    auto fileSize = [&path]() {
+        return static_cast<off_t>(std::ifstream(path, std::ios::ate | std::ios::binary).tellg());
+    };
+    
+    off_t firstBatchEnd;
+    {
+        LogStore store(path);
+        store.writeBatch({{"a", "1"}, {"b", "2"}});
+        firstBatchEnd = fileSize();
+        store.writeBatch({{"a", "3"}, {"c", "4"}, {"h", "5"}});
+    }
+    
+    // Tear the last record of the second batch; its first records are intact
+    ASSERT_EQ(truncate(path.c_str(), fileSize() - 1), 0);
+    
+    std::string value;
+    {
+        LogStore store(path);
+        ASSERT_EQ(store.size(), 2u);
+        ASSERT_TRUE(store.get("a", value));
+        ASSERT_EQ(value, "1");
+        ASSERT_FALSE(store.contains("c"));
+        ASSERT_FALSE(store.contains("h"));
+        ASSERT_EQ(fileSize(), firstBatchEnd);
+        
+        // Appends continue on the batch boundary and survive compaction
+        store.writeBatch({{"a", "5"}, {"c", "6"}});
+        store.compact();
+    }
+    
+    LogStore reopened(path);
+    ASSERT_EQ(reopened.size(), 3u);
+    ASSERT_TRUE(reopened.get("a", value));
+    ASSERT_EQ(value, "5");
+    ASSERT_TRUE(reopened.get("c", value));
+    ASSERT_EQ(value, "6");
+    ASSERT_EQ(reopened.getDeadBytes(), 0u);
+}
+
+TEST_F(ContractVMTest, ContractStorageRootSurvivesReopen) {
+    const std::string pathA = ::testing::TempDir() + "contract_storage_a.log";
+    const std::string pathB = ::testing::TempDir() + "contract_storage_b.log";
+    std::remove(pathA.c_str());
+    std::remove(pathB.c_str());
+    
+    std::string root;
+    {
+        // Everything in one block
+        ContractStorage storage(pathA);
+        ASSERT_EQ(storage.getStateRoot("Mcontract"), SparseMerkleTree::emptyRoot());
+        storage.stage("Mcontract", "alpha", "1");
+        storage.stage("Mcontract", "beta", "2");
+        storage.commitBlock();
+        root = storage.getStateRoot("Mcontract");
+        ASSERT_NE(root, SparseMerkleTree::emptyRoot());
+    }
+    {
+        // Same final state over two blocks with an overwrite in between
+        ContractStorage storage(pathB);
+        storage.stage("Mcontract", "beta", "0");
+        storage.commitBlock();
+        storage.stage("Mcontract", "alpha", "1");
+        storage.stage("Mcontract", "beta", "2");
+        storage.commitBlock();
+        ASSERT_EQ(storage.getStateRoot("Mcontract"), root);
+    }
+    
+    ContractStorage reopened(pathA);
+    std::string value;
+    ASSERT_TRUE(reopened.load("Mcontract", "beta", value));
+    ASSERT_EQ(value, "2");
+    ASSERT_EQ(reopened.getStateRoot("Mcontract"), root);
+    ASSERT_FALSE(reopened.load("Mother", "beta", value));
+}
+
+TEST_F(ContractVMTest, SnapshotsAreIsolatedFromLaterBlocks) {
+    const std::string path = ::testing::TempDir() + "contract_storage_snapshot.log";
+    std::remove(path.c_str());
+    
+    ContractStorage storage(path);
+    storage.stage("Mcontract", "count", "1");
+    storage.commitBlock();
+    auto snapshot = storage.getSnapshot();
+    
+    storage.stage("Mcontract", "count", "2");
+    storage.stage("Mcontract", "other", "3");
+    std::string value;
+    ASSERT_TRUE(snapshot->get("Mcontract", "count", value));
+    ASSERT_EQ(value, "1");
+    
+    storage.commitBlock();
+    ASSERT_TRUE(snapshot->get("Mcontract", "count", value));
+    ASSERT_EQ(value, "1");
+    ASSERT_FALSE(snapshot->get("Mcontract", "other", value));
+    ASSERT_EQ(snapshot->getStateRoot("Mcontract"), storage.getSnapshot(1)->getStateRoot("Mcontract"));
+    
+    ASSERT_TRUE(storage.getSnapshot()->get("Mcontract", "count", value));
+    ASSERT_EQ(value, "2");
+    
+    // A block without contract writes still gets its own version
+    storage.commitBlock();
+    ASSERT_EQ(storage.getSnapshot()->getVersion(), 3u);
+    ASSERT_EQ(storage.getSnapshot()->getStateRoot("Mcontract"), storage.getSnapshot(2)->getStateRoot("Mcontract"));
+    ASSERT_TRUE(storage.getSnapshot()->get("Mcontract", "count", value));
+    ASSERT_EQ(value, "2");
+}
+
+TEST_F(ContractVMTest, ContractStateVerifiesAgainstCommittedRoot) {
+    const std::string path = ::testing::TempDir() + "contract_storage_verify.log";
+    std::remove(path.c_str());
+    
+    ContractStorage storage(path);
+    SmartContract contract("Mcontract", "", "");
+    storage.attach(contract);
+    ASSERT_TRUE(contract.verifyState(SparseMerkleTree::emptyRoot()));
+    
+    // Staged writes do not move the root until the block commits
+    storage.stage("Mcontract", "count", "1");
+    ASSERT_TRUE(contract.verifyState(SparseMerkleTree::emptyRoot()));
+    
+    storage.commitBlock();
+    const std::string committedRoot = storage.getStateRoot("Mcontract");
+    ASSERT_NE(committedRoot, SparseMerkleTree::emptyRoot());
+    ASSERT_TRUE(contract.verifyState(committedRoot));
+    
+    storage.stage("Mcontract", "count", "2");
+    storage.commitBlock();
+    ASSERT_FALSE(contract.verifyState(committedRoot));
+    ASSERT_TRUE(contract.verifyState(storage.getStateRoot("Mcontract")));
+    
+    // Other contracts' commits leave it alone
+    storage.stage("Mother", "count", "1");
+    storage.commitBlock();
+    ASSERT_TRUE(contract.verifyState(storage.getStateRoot("Mcontract")));
+    storage.detach(contract);
+}
\ No newline at end of file
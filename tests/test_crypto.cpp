@@ -1,6 +1,10 @@
 #include <gtest/gtest.h>
 #include "../src/crypto/encryption.hpp"
 #include "../src/crypto/hash.hpp"
+#include "../src/crypto/signature_cache.hpp"
+#include "../src/crypto/stream_cipher.hpp"
+#include "../src/crypto/session_key_cache.hpp"
+#include "../src/crypto/key_derivation.hpp"
 
 TEST(CryptoTest, SHA256Hashing) {
     std::string input = "test message";
@@ -40,4 +44,78 @@ TEST(CryptoTest, MessageEncryption) {
     std::string decrypted = Encryption::decrypt(encrypted, privateKey);
     
     ASSERT_EQ(message, decrypted);
-} 
\ No newline at end of file
+} 
+
+TEST(CryptoTest, SignatureCacheLookup) {
+    SignatureCache& cache = SignatureCache::getInstance();
+    std::string entry = cache.computeEntry("txid", 0, "public-key", "signature");
+    
+    ASSERT_FALSE(cache.contains(entry));
+    cache.insert(entry);
+    ASSERT_TRUE(cache.contains(entry));
+    
+    // Another input of the same transaction is a separate entry
+    ASSERT_FALSE(cache.contains(cache.computeEntry("txid", 1, "public-key", "signature")));
+    
+    // Moving bytes across a field boundary changes the entry
+    ASSERT_NE(cache.computeEntry("txid", 0, "key:x", "signature"),
+              cache.computeEntry("txid", 0, "key", "x:signature"));
+    
+    cache.erase(entry);
+    ASSERT_FALSE(cache.contains(entry));
+}
+
+TEST(CryptoTest, StreamCipherChunksAuthenticate) {
+    std::vector<uint8_t> key(StreamCipher::KEY_SIZE, 0x42);
+    std::string message(1000, 'm');
+    
+    std::vector<uint8_t> payload = StreamCipher::seal(message, key, 64);
+    ASSERT_EQ(message, StreamCipher::open(payload, key));
+    
+    // Dropping the final chunk must not pass as a shorter message
+    std::vector<uint8_t> truncated(payload.begin(),
+        payload.begin() + StreamCipher::HEADER_SIZE + 2 * (64 + StreamCipher::TAG_SIZE));
+    ASSERT_THROW(StreamCipher::open(truncated, key), std::runtime_error);
+    
+    payload[StreamCipher::HEADER_SIZE] ^= 1;
+    ASSERT_THROW(StreamCipher::open(payload, key), std::runtime_error);
+}
+
+TEST(CryptoTest, SessionKeysRatchetAcrossEpochs) {
+    std::string senderKey = Encryption::generatePrivateKey();
+    std::string recipientKey = Encryption::generatePrivateKey();
+    std::string senderPublic = Encryption::generatePublicKey(senderKey);
+    std::string recipientPublic = Encryption::generatePublicKey(recipientKey);
+    
+    SessionKeyCache sender(4);
+    SessionKeyCache recipient(4);
+    std::vector<std::string> envelopes;
+    for (int i = 0; i < 10; i++) {
+        envelopes.push_back(sender.seal("message " + std::to_string(i), senderKey, senderPublic, recipientPublic));
+    }
+    
+    // A later epoch first, then an earlier one that has been ratcheted away
+    ASSERT_EQ(recipient.open(envelopes[9], recipientKey, recipientPublic), "message 9");
+    ASSERT_EQ(recipient.open(envelopes[2], recipientKey, recipientPublic), "message 2");
+    
+    envelopes[5].back() ^= 1;
+    ASSERT_THROW(recipient.open(envelopes[5], recipientKey, recipientPublic), std::runtime_error);
+}
+
+TEST(CryptoTest, KeyRangeMatchesSingleDerivation) {
+    // BIP32 test vector 1
+    std::string seed;
+    for (char i = 0; i < 16; i++) {
+        seed += i;
+    }
+    std::string master = KeyDerivation::createHDWallet(seed);
+    std::string hardenedChild = KeyDerivation::deriveChildKey(master, 0x80000000);
+    ASSERT_EQ(hardenedChild.substr(0, 64), "edb2e14f9ee77d26dd93b4ecede8d16ed408ce149b6cd80b0715a2d911a0afea");
+    
+    std::vector<KeyDerivation::DerivedKey> keys = KeyDerivation::deriveRange(master, 0, 100);
+    ASSERT_EQ(keys.size(), 100u);
+    for (uint32_t i : {0u, 63u, 64u, 99u}) {
+        ASSERT_EQ(keys[i].extendedKey, KeyDerivation::deriveChildKey(master, i));
+        ASSERT_EQ(keys[i].address, Encryption::deriveAddress(keys[i].publicKey));
+    }
+}
\ No newline at end of file
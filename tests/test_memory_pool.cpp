@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "../src/utils/memory_pool.hpp"
+
+class MemoryPoolTest : public ::testing::Test {
+protected:
+    static constexpr uint64_t GAS = 100;
+    static constexpr uint64_t NO_GAS_LIMIT = 1ull << 40;
+
+    MemoryPool pool{1000};
+
+    // Spends the given outputs and pays its fee through gas, so tests can
+    // set fees without funding inputs
+    static Transaction spend(const std::vector<std::pair<std::string, uint32_t>>& outputs, double fee) {
+        Transaction tx(TransactionType::FINANCIAL);
+        for (const auto& [txHash, index] : outputs) {
+            TransactionInput input;
+            input.previousTxHash = txHash;
+            input.outputIndex = index;
+            tx.addInput(input);
+        }
+        tx.setGas(GAS, fee / GAS);
+        return tx;
+    }
+
+    static std::vector<std::string> hashesOf(const BlockTemplate& blockTemplate) {
+        std::vector<std::string> hashes;
+        for (const Transaction& tx : blockTemplate.transactions) {
+            hashes.push_back(tx.getHash());
+        }
+        return hashes;
+    }
+};
+
+TEST_F(MemoryPoolTest, ChildPaysForParent) {
+    Transaction parent = spend({{"coin-parent", 0}}, 1);
+    Transaction child = spend({{parent.getHash(), 0}}, 200);
+    Transaction standalone = spend({{"coin-standalone", 0}}, 30);
+    ASSERT_TRUE(pool.addTransaction(parent));
+    ASSERT_TRUE(pool.addTransaction(child));
+    ASSERT_TRUE(pool.addTransaction(standalone));
+
+    // Room for two: the parent and child package outbids the standalone
+    // transaction, and the parent comes first
+    const size_t packageBytes = parent.getSerializedSize() + child.getSerializedSize();
+    auto blockTemplate = pool.buildTemplate(packageBytes, NO_GAS_LIMIT);
+    ASSERT_EQ(hashesOf(*blockTemplate), std::vector<std::string>({parent.getHash(), child.getHash()}));
+    ASSERT_DOUBLE_EQ(blockTemplate->totalFees, 201);
+
+    // An unchanged pool reuses its template
+    ASSERT_EQ(pool.buildTemplate(packageBytes, NO_GAS_LIMIT), blockTemplate);
+    ASSERT_EQ(pool.buildTemplate(pool.getTotalBytes(), NO_GAS_LIMIT)->transactions.size(), 3u);
+}
+
+TEST_F(MemoryPoolTest, SiblingsAreRescoredOnceTheParentIsIn) {
+    Transaction parent = spend({{"coin-parent", 0}}, 1);
+    Transaction first = spend({{parent.getHash(), 0}}, 100);
+    Transaction second = spend({{parent.getHash(), 1}}, 80);
+    Transaction standalone = spend({{"coin-standalone", 0}}, 27);
+    for (const Transaction& tx : {parent, first, second, standalone}) {
+        ASSERT_TRUE(pool.addTransaction(tx));
+    }
+
+    // The standalone transaction outbids the second child's package, but
+    // once the first child has paid for the parent the second child
+    // competes on its own fee and wins
+    const size_t bytes = parent.getSerializedSize() + first.getSerializedSize() + second.getSerializedSize();
+    auto blockTemplate = pool.buildTemplate(bytes, NO_GAS_LIMIT);
+    ASSERT_EQ(hashesOf(*blockTemplate),
+              std::vector<std::string>({parent.getHash(), first.getHash(), second.getHash()}));
+}
+
+TEST_F(MemoryPoolTest, RemovalTakesDescendants) {
+    Transaction parent = spend({{"coin-parent", 0}}, 10);
+    Transaction child = spend({{parent.getHash(), 0}}, 10);
+    Transaction grandchild = spend({{child.getHash(), 0}}, 10);
+    Transaction unrelated = spend({{"coin-unrelated", 0}}, 10);
+    for (const Transaction& tx : {parent, child, grandchild, unrelated}) {
+        ASSERT_TRUE(pool.addTransaction(tx));
+    }
+
+    pool.removeTransaction(child.getHash());
+    ASSERT_EQ(pool.size(), 2u);
+    ASSERT_TRUE(pool.contains(parent.getHash()));
+    ASSERT_FALSE(pool.contains(grandchild.getHash()));
+    ASSERT_EQ(pool.getTotalBytes(), parent.getSerializedSize() + unrelated.getSerializedSize());
+
+    // The freed output can be spent again
+    ASSERT_TRUE(pool.addTransaction(spend({{parent.getHash(), 0}}, 5)));
+}
+
+TEST_F(MemoryPoolTest, ConfirmedAncestorsLeaveDescendantPackages) {
+    // Several parent, child, grandchild chains, so the confirmed pairs are
+    // visited in both orders whatever order the pool walks them in
+    std::vector<Transaction> confirmed;
+    std::vector<Transaction> grandchildren;
+    size_t grandchildBytes = 0;
+    for (int chain = 0; chain < 8; chain++) {
+        Transaction parent = spend({{"coin-" + std::to_string(chain), 0}}, 1);
+        Transaction child = spend({{parent.getHash(), 0}}, 30);
+        Transaction grandchild = spend({{child.getHash(), 0}}, 20);
+        for (const Transaction& tx : {parent, child, grandchild}) {
+            ASSERT_TRUE(pool.addTransaction(tx));
+        }
+        confirmed.push_back(child);
+        confirmed.push_back(parent);
+        grandchildren.push_back(grandchild);
+        grandchildBytes += grandchild.getSerializedSize();
+    }
+
+    // Every grandchild must end up priced on its own size alone, so all of
+    // them fit a budget of exactly their own bytes
+    pool.removeForBlock(confirmed);
+    ASSERT_EQ(pool.size(), grandchildren.size());
+    auto blockTemplate = pool.buildTemplate(grandchildBytes, NO_GAS_LIMIT);
+    ASSERT_EQ(blockTemplate->transactions.size(), grandchildren.size());
+
+    // Only in-pool ancestors count toward the chain limit
+    Transaction tip = grandchildren.front();
+    for (size_t i = 1; i < MemoryPool::MAX_ANCESTORS; i++) {
+        tip = spend({{tip.getHash(), 0}}, 1);
+        ASSERT_TRUE(pool.addTransaction(tip));
+    }
+    ASSERT_FALSE(pool.addTransaction(spend({{tip.getHash(), 0}}, 1)));
+}
+
+TEST_F(MemoryPoolTest, ConflictsAreRefusedAndEvicted) {
+    Transaction first = spend({{"coin", 0}}, 10);
+    Transaction doubleSpend = spend({{"coin", 0}, {"coin", 2}}, 50);
+    ASSERT_TRUE(pool.addTransaction(first));
+    ASSERT_FALSE(pool.addTransaction(doubleSpend));
+
+    Transaction child = spend({{first.getHash(), 0}}, 10);
+    Transaction other = spend({{"other-coin", 0}}, 10);
+    ASSERT_TRUE(pool.addTransaction(child));
+    ASSERT_TRUE(pool.addTransaction(other));
+
+    // A block that confirms the double spend evicts the pool's spender of
+    // that output and everything built on it
+    pool.removeForBlock({doubleSpend});
+    ASSERT_FALSE(pool.contains(first.getHash()));
+    ASSERT_FALSE(pool.contains(child.getHash()));
+    ASSERT_TRUE(pool.contains(other.getHash()));
+    ASSERT_EQ(pool.getTotalBytes(), other.getSerializedSize());
+    ASSERT_TRUE(pool.addTransaction(spend({{"coin", 1}}, 10)));
+}
+
+TEST_F(MemoryPoolTest, UnderpaidContractCallsAreRefused) {
+    // The fixture pays through the gas price alone, which a contract call
+    // must cover with a prepaid fee
+    Transaction call = spend({{"coin", 0}}, 50);
+    call.setContractCall("contract", "run", {});
+    ASSERT_FALSE(pool.addTransaction(call));
+    ASSERT_EQ(pool.size(), 0u);
+    
+    ASSERT_TRUE(pool.addTransaction(spend({{"coin", 0}}, 50)));
+}
+
+TEST_F(MemoryPoolTest, FullPoolEvictsTheLowestPackage) {
+    MemoryPool small(3);
+    Transaction parent = spend({{"coin-parent", 0}}, 1);
+    Transaction child = spend({{parent.getHash(), 0}}, 30);
+    Transaction middle = spend({{"coin-middle", 0}}, 50);
+    for (const Transaction& tx : {parent, child, middle}) {
+        ASSERT_TRUE(small.addTransaction(tx));
+    }
+    
+    // Ranking below the lowest package gets nothing evicted
+    ASSERT_FALSE(small.addTransaction(spend({{"coin-cheap", 0}}, 0.5)));
+    ASSERT_EQ(small.size(), 3u);
+    
+    // A better transaction evicts the lowest package, descendants included
+    Transaction rich = spend({{"coin-rich", 0}}, 100);
+    ASSERT_TRUE(small.addTransaction(rich));
+    ASSERT_FALSE(small.contains(parent.getHash()));
+    ASSERT_FALSE(small.contains(child.getHash()));
+    ASSERT_TRUE(small.contains(middle.getHash()));
+    ASSERT_TRUE(small.contains(rich.getHash()));
+    ASSERT_EQ(small.size(), 2u);
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <thread>
+#include "../src/core/message_index.hpp"
+#include "../src/crypto/encryption.hpp"
+
+class MessageIndexTest : public ::testing::Test {
+protected:
+    std::string path;
+    
+    void SetUp() override {
+        path = ::testing::TempDir() + "message_index.log";
+        std::remove(path.c_str());
+    }
+    
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+    
+    static Transaction message(const std::string& recipient) {
+        Transaction tx("sender", recipient, TransactionType::MESSAGE);
+        tx.setMessage("hello", recipient);
+        return tx;
+    }
+    
+    // Block at height with one message per recipient, in order
+    static Block blockOf(uint64_t height, const std::vector<std::string>& recipients) {
+        std::vector<Transaction> transactions;
+        for (const auto& recipient : recipients) {
+            transactions.push_back(message(recipient));
+        }
+        return Block(static_cast<uint32_t>(height), transactions, "previous");
+    }
+    
+    static Transaction groupMessage(const std::vector<std::string>& publicKeys) {
+        Transaction tx("sender", "", TransactionType::MESSAGE);
+        tx.setGroupMessage("hello group", publicKeys);
+        return tx;
+    }
+    
+    static std::vector<std::pair<uint64_t, uint32_t>> positionsOf(const MessageIndex::Page& page) {
+        std::vector<std::pair<uint64_t, uint32_t>> positions;
+        for (const auto& location : page.messages) {
+            positions.emplace_back(location.blockHeight, location.txOffset);
+        }
+        return positions;
+    }
+};
+
+TEST_F(MessageIndexTest, PagesThroughAnInbox) {
+    MessageIndex index(path);
+    index.indexBlock(blockOf(0, {"alice", "bob", "alice"}), 0);
+    index.indexBlock(blockOf(1, {"bob"}), 1);
+    index.indexBlock(blockOf(2, {"alice", "alice"}), 2);
+    ASSERT_EQ(index.getMessageCount("alice"), 4u);
+    ASSERT_EQ(index.getMessageCount("bob"), 2u);
+    ASSERT_EQ(index.getIndexedHeight(), 3u);
+    
+    MessageIndex::Page page = index.query("alice", 0, "", 3);
+    ASSERT_EQ(positionsOf(page), (std::vector<std::pair<uint64_t, uint32_t>>{{0, 0}, {0, 2}, {2, 0}}));
+    ASSERT_FALSE(page.nextCursor.empty());
+    
+    page = index.query("alice", 0, page.nextCursor, 3);
+    ASSERT_EQ(positionsOf(page), (std::vector<std::pair<uint64_t, uint32_t>>{{2, 1}}));
+    ASSERT_TRUE(page.nextCursor.empty());
+    
+    // sinceHeight skips older blocks, cursor or not
+    ASSERT_EQ(positionsOf(index.query("alice", 1)), (std::vector<std::pair<uint64_t, uint32_t>>{{2, 0}, {2, 1}}));
+    ASSERT_TRUE(index.query("carol", 0).messages.empty());
+    ASSERT_THROW(index.query("alice", 0, "not-a-cursor"), std::invalid_argument);
+}
+
+TEST_F(MessageIndexTest, ReloadsFromItsLog) {
+    {
+        MessageIndex index(path);
+        index.indexBlock(blockOf(0, {"alice"}), 0);
+        index.indexBlock(blockOf(1, {"bob", "alice"}), 1);
+    }
+    
+    MessageIndex reopened(path);
+    ASSERT_EQ(reopened.getIndexedHeight(), 2u);
+    ASSERT_EQ(positionsOf(reopened.query("alice", 0)), (std::vector<std::pair<uint64_t, uint32_t>>{{0, 0}, {1, 1}}));
+    ASSERT_EQ(reopened.getMessageCount("bob"), 1u);
+    
+    // Replaying committed blocks after a restart changes nothing
+    reopened.indexBlock(blockOf(1, {"bob", "alice"}), 1);
+    ASSERT_EQ(reopened.getMessageCount("alice"), 2u);
+    
+    reopened.indexBlock(blockOf(2, {"alice"}), 2);
+    ASSERT_EQ(reopened.getMessageCount("alice"), 3u);
+    ASSERT_EQ(reopened.getIndexedHeight(), 3u);
+}
+
+TEST_F(MessageIndexTest, ConcurrentReplaysIndexABlockOnce) {
+    MessageIndex index(path);
+    const Block block = blockOf(0, {"alice"});
+    
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&]() { index.indexBlock(block, 0); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    ASSERT_EQ(index.getMessageCount("alice"), 1u);
+    ASSERT_EQ(MessageIndex(path).getMessageCount("alice"), 1u);
+}
+
+TEST_F(MessageIndexTest, GroupMessagesMatchByPublicKey) {
+    const std::string alice = Encryption::generatePublicKey(Encryption::generatePrivateKey());
+    const std::string bob = Encryption::generatePublicKey(Encryption::generatePrivateKey());
+    const std::string carol = Encryption::generatePublicKey(Encryption::generatePrivateKey());
+    
+    {
+        MessageIndex index(path);
+        index.indexBlock(Block(0, {groupMessage({alice, bob}), message("dave"), groupMessage({bob})}, "previous"), 0);
+        index.indexBlock(Block(1, {groupMessage({carol, alice})}, "previous"), 1);
+        
+        // Group messages stay out of the address inboxes
+        ASSERT_EQ(index.getMessageCount(""), 0u);
+        ASSERT_EQ(index.getMessageCount("dave"), 1u);
+    }
+    
+    // Matching survives a reload, since the headers and tags are persisted
+    MessageIndex index(path);
+    MessageIndex::Page page = index.queryGroup(alice, 0, "", 1);
+    ASSERT_EQ(positionsOf(page), (std::vector<std::pair<uint64_t, uint32_t>>{{0, 0}}));
+    page = index.queryGroup(alice, 0, page.nextCursor, 1);
+    ASSERT_EQ(positionsOf(page), (std::vector<std::pair<uint64_t, uint32_t>>{{1, 0}}));
+    ASSERT_TRUE(page.nextCursor.empty());
+    
+    ASSERT_EQ(positionsOf(index.queryGroup(bob, 0)), (std::vector<std::pair<uint64_t, uint32_t>>{{0, 0}, {0, 2}}));
+    ASSERT_EQ(positionsOf(index.queryGroup(carol, 1)), (std::vector<std::pair<uint64_t, uint32_t>>{{1, 0}}));
+    ASSERT_TRUE(index.queryGroup("dave", 0).messages.empty());
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "../src/utils/mpsc_queue.hpp"
+
+TEST(BoundedMpscQueueTest, ProducersAndConsumerUnderWaitAndInterrupt) {
+    constexpr uint64_t PRODUCERS = 4;
+    constexpr uint64_t ITEMS_PER_PRODUCER = 50000;
+    
+    // Small enough that producers keep hitting a full queue
+    BoundedMpscQueue<uint64_t> queue(64);
+    std::atomic<bool> producing(true);
+    
+    std::vector<std::thread> producers;
+    for (uint64_t producer = 0; producer < PRODUCERS; producer++) {
+        producers.emplace_back([&queue, producer]() {
+            for (uint64_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+                while (!queue.tryPush((producer << 32) | i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    
+    // Interrupts cut the consumer's waits short but never lose an item
+    std::thread interrupter([&]() {
+        while (producing.load()) {
+            queue.interrupt();
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            queue.resume();
+        }
+    });
+    
+    // Each producer's items arrive once, in the order it pushed them
+    std::vector<uint64_t> nextExpected(PRODUCERS, 0);
+    uint64_t received = 0;
+    while (received < PRODUCERS * ITEMS_PER_PRODUCER) {
+        queue.waitUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(50));
+        uint64_t item;
+        while (queue.tryPop(item)) {
+            const uint64_t producer = item >> 32;
+            ASSERT_LT(producer, PRODUCERS);
+            ASSERT_EQ(item & 0xffffffffu, nextExpected[producer]);
+            nextExpected[producer]++;
+            received++;
+        }
+    }
+    
+    producing.store(false);
+    interrupter.join();
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    
+    uint64_t item;
+    ASSERT_FALSE(queue.tryPop(item));
+    ASSERT_EQ(queue.size(), 0u);
+}
+
+TEST(BoundedMpscQueueTest, InterruptWakesAWaitingConsumer) {
+    BoundedMpscQueue<int> queue(8);
+    
+    std::thread consumer([&queue]() {
+        // Would sleep for a minute without the interrupt
+        ASSERT_FALSE(queue.waitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(60)));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    
+    const auto start = std::chrono::steady_clock::now();
+    queue.interrupt();
+    consumer.join();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    ASSERT_TRUE(queue.isInterrupted());
+    
+    // A push wakes a consumer that is already asleep
+    queue.resume();
+    std::thread producer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        queue.tryPush(7);
+    });
+    ASSERT_TRUE(queue.waitUntil(std::chrono::steady_clock::now() + std::chrono::seconds(60)));
+    producer.join();
+    
+    int item = 0;
+    ASSERT_TRUE(queue.tryPop(item));
+    ASSERT_EQ(item, 7);
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "../src/utils/thread_pool.hpp"
+
+TEST(ThreadPoolTest, WaitRunsEveryTask) {
+    ThreadPool pool(4);
+    std::atomic<int> completed(0);
+    
+    ThreadPool::TaskGroup group(pool);
+    for (int i = 0; i < 100; i++) {
+        group.run([&completed]() { completed.fetch_add(1); });
+    }
+    group.wait();
+    
+    ASSERT_EQ(completed.load(), 100);
+}
+
+TEST(ThreadPoolTest, WaitUntilCancelledLeavesRunningTasksBehind) {
+    ThreadPool pool(2);
+    
+    // The straggler owns its state and blocks until released
+    auto release = std::make_shared<std::promise<void>>();
+    std::shared_future<void> released = release->get_future().share();
+    auto stragglerStarted = std::make_shared<std::promise<void>>();
+    auto stragglerDone = std::make_shared<std::promise<void>>();
+    std::future<void> done = stragglerDone->get_future();
+    
+    {
+        ThreadPool::TaskGroup group(pool);
+        group.run([released, stragglerStarted, stragglerDone]() {
+            stragglerStarted->set_value();
+            released.wait();
+            stragglerDone->set_value();
+        });
+        stragglerStarted->get_future().wait();
+        
+        group.run([&group]() { group.cancel(); });
+        group.waitUntilCancelled();
+        ASSERT_TRUE(group.isCancelled());
+    }
+    
+    // Neither the wait nor the group's destructor blocked on the straggler
+    ASSERT_EQ(done.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+    release->set_value();
+    done.wait();
+}
+
+TEST(ThreadPoolTest, WaitUntilCancelledReturnsWhenAllFinish) {
+    ThreadPool pool(2);
+    std::atomic<int> completed(0);
+    
+    ThreadPool::TaskGroup group(pool);
+    for (int i = 0; i < 10; i++) {
+        group.run([&completed]() { completed.fetch_add(1); });
+    }
+    group.waitUntilCancelled();
+    
+    ASSERT_FALSE(group.isCancelled());
+    ASSERT_EQ(completed.load(), 10);
+}
+
+TEST(ThreadPoolTest, ForEachBatchCoversTheRangeOnce) {
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> visits(1000);
+    
+    pool.forEachBatch(visits.size(), 64, [&visits](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            visits[i].fetch_add(1);
+        }
+    });
+    
+    for (const auto& count : visits) {
+        ASSERT_EQ(count.load(), 1);
+    }
+}
+
+TEST(ThreadPoolTest, ForEachBatchRethrowsTheFirstException) {
+    ThreadPool pool(4);
+    
+    try {
+        pool.forEachBatch(100, 10, [](size_t first, size_t) {
+            if (first == 50) {
+                throw std::invalid_argument("batch 50 failed");
+            }
+        });
+        FAIL() << "Expected the batch's exception";
+    } catch (const std::invalid_argument& e) {
+        ASSERT_STREQ(e.what(), "batch 50 failed");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include "../src/utils/tracer.hpp"
+
+class TracerTest : public ::testing::Test {
+protected:
+    struct Event {
+        std::string name;
+        uint64_t start;
+        uint64_t duration;
+        uint32_t threadId;
+        std::string traceId;
+    };
+    
+    std::string path;
+    
+    void SetUp() override {
+        path = ::testing::TempDir() + "tracer_test.json";
+        Tracer::getInstance()->enable(path);
+    }
+    
+    void TearDown() override {
+        Tracer::getInstance()->disable();
+        std::remove(path.c_str());
+    }
+    
+    // Parses the trace file, failing the test unless every event has the
+    // exact shape the trace viewers expect
+    std::vector<Event> readEvents() {
+        std::ifstream in(path);
+        std::stringstream contents;
+        contents << in.rdbuf();
+        std::string json = contents.str();
+        
+        static const std::regex eventPattern(
+            "\\n\\{\"name\":\"((?:[^\"\\\\]|\\\\.)*)\",\"cat\":\"block\",\"ph\":\"X\""
+            ",\"ts\":(\\d+),\"dur\":(\\d+),\"pid\":\\d+,\"tid\":(\\d+)"
+            ",\"args\":\\{\"traceId\":\"([0-9a-f]{16})\"\\}\\}");
+        
+        std::vector<Event> parsed;
+        EXPECT_EQ(json.substr(0, 1), "[");
+        size_t offset = 1;
+        std::smatch match;
+        while (offset < json.size()) {
+            if (!parsed.empty()) {
+                EXPECT_EQ(json[offset], ',');
+                offset++;
+            }
+            std::string rest = json.substr(offset);
+            if (!std::regex_search(rest, match, eventPattern,
+                                   std::regex_constants::match_continuous)) {
+                ADD_FAILURE() << "Malformed event at offset " << offset;
+                break;
+            }
+            parsed.push_back({match[1], std::stoull(match[2]), std::stoull(match[3]),
+                              static_cast<uint32_t>(std::stoul(match[4])), match[5]});
+            offset += match.length(0);
+        }
+        return parsed;
+    }
+};
+
+TEST_F(TracerTest, NestedSpansLieWithinTheirParent) {
+    {
+        TRACE_SPAN("outer", 0xabc);
+        {
+            TRACE_SPAN("inner", 0xabc);
+        }
+    }
+    ASSERT_TRUE(Tracer::getInstance()->flush());
+    
+    std::vector<Event> events = readEvents();
+    ASSERT_EQ(events.size(), 2u);
+    
+    // Spans are recorded as they close, innermost first
+    const Event& inner = events[0];
+    const Event& outer = events[1];
+    ASSERT_EQ(inner.name, "inner");
+    ASSERT_EQ(outer.name, "outer");
+    ASSERT_EQ(inner.threadId, outer.threadId);
+    ASSERT_EQ(inner.traceId, "0000000000000abc");
+    ASSERT_GE(inner.start, outer.start);
+    
+    // Start and duration are each truncated to microseconds
+    ASSERT_LE(inner.start + inner.duration, outer.start + outer.duration + 1);
+}
+
+TEST_F(TracerTest, FlushesAppendToTheTrace) {
+    {
+        TRACE_SPAN("first \"quoted\"", 1);
+    }
+    ASSERT_TRUE(Tracer::getInstance()->flush());
+    
+    {
+        Tracer::Span span("second", "block", 0);
+        span.setTraceId(Tracer::traceIdFor("ff00"));
+    }
+    ASSERT_TRUE(Tracer::getInstance()->flush());
+    
+    std::vector<Event> events = readEvents();
+    ASSERT_EQ(events.size(), 2u);
+    ASSERT_EQ(events[0].name, "first \\\"quoted\\\"");
+    ASSERT_EQ(events[1].name, "second");
+    ASSERT_EQ(events[1].traceId, "000000000000ff00");
+}
\ No newline at end of file
@@ -38,4 +38,26 @@ TEST_F(TransactionTest, MessageTransaction) {
     
     std::string decrypted = tx.decryptMessage(recipient->getPrivateKey());
     ASSERT_EQ(decrypted, message);
-} 
\ No newline at end of file
+} 
+
+TEST_F(TransactionTest, SerializeRoundTrip) {
+    Transaction tx(sender->getAddress(), recipient->getAddress(), TransactionType::MESSAGE);
+    tx.setGroupMessage("Hello, group!", {recipient->getPublicKey(), sender->getPublicKey()});
+    tx.setContractCall("contract", "transfer(address,uint256)", {"alice", "42"});
+    ASSERT_TRUE(tx.sign(sender->getPrivateKey()));
+    
+    const std::string encoded = tx.serialize();
+    Transaction decoded = Transaction::deserialize(encoded);
+    ASSERT_EQ(decoded.getHash(), tx.getHash());
+    ASSERT_EQ(decoded.serialize(), encoded);
+    ASSERT_TRUE(decoded.verify());
+    ASSERT_EQ(decoded.decryptMessage(recipient->getPrivateKey(), recipient->getPublicKey()), "Hello, group!");
+    
+    // A plain transfer decodes to the same hash, output included
+    Transaction transfer(sender->getAddress(), recipient->getAddress(), TransactionType::FINANCIAL);
+    ASSERT_EQ(Transaction::deserialize(transfer.serialize()).getHash(), transfer.getHash());
+    
+    // Truncated or padded input is refused rather than half-decoded
+    ASSERT_THROW(Transaction::deserialize(encoded.substr(0, encoded.size() - 1)), std::runtime_error);
+    ASSERT_THROW(Transaction::deserialize(encoded + "x"), std::runtime_error);
+}
\ No newline at end of file
@@ -45,4 +45,102 @@ TEST_F(WalletTest, MessageHandling) {
     auto messages = recipient->getDecryptedMessages();
     ASSERT_FALSE(messages.empty());
     ASSERT_EQ(messages[0], testMessage);
-} 
\ No newline at end of file
+}
+
+TEST_F(WalletTest, DirectMessagesShareASession) {
+    std::shared_ptr<Wallet> recipient = std::make_shared<Wallet>();
+    
+    // Addressed by public key, messages go through one cached session and
+    // still land at the recipient's address
+    std::vector<Transaction> sent;
+    for (int i = 0; i < 3; i++) {
+        sent.push_back(wallet->createMessage(recipient->getPublicKey(), "Session message " + std::to_string(i)));
+        ASSERT_EQ(sent.back().getRecipient(), recipient->getAddress());
+        ASSERT_TRUE(SessionKeyCache::isEnvelope(sent.back().getEncryptedMessage()));
+        recipient->receiveMessage(sent.back());
+    }
+    
+    // The session id follows the 4-byte envelope magic
+    ASSERT_EQ(sent[0].getEncryptedMessage().substr(4, 8), sent[2].getEncryptedMessage().substr(4, 8));
+    
+    auto messages = recipient->getDecryptedMessages();
+    ASSERT_EQ(messages.size(), 3u);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(messages[i], "Session message " + std::to_string(i));
+    }
+}
+
+TEST_F(WalletTest, DecryptedMessagesPageInArrivalOrder) {
+    std::shared_ptr<Wallet> recipient = std::make_shared<Wallet>();
+    std::vector<Transaction> sent;
+    auto receive = [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            sent.push_back(wallet->createMessage(recipient->getPublicKey(), "Message " + std::to_string(i)));
+            recipient->receiveMessage(sent.back());
+        }
+    };
+    
+    receive(0, 10);
+    ASSERT_EQ(recipient->getDecryptedMessageCount(), 10u);
+    
+    // The second refresh only decrypts the new arrivals, enough of them to
+    // go through the thread pool
+    receive(10, 50);
+    auto page = recipient->getDecryptedMessages(5, 20);
+    ASSERT_EQ(page.size(), 20u);
+    for (size_t i = 0; i < page.size(); i++) {
+        ASSERT_EQ(page[i].txHash, sent[5 + i].getHash());
+        ASSERT_EQ(page[i].plaintext, "Message " + std::to_string(5 + i));
+    }
+    
+    ASSERT_EQ(recipient->getDecryptedMessages(40, 20).size(), 10u);
+    ASSERT_TRUE(recipient->getDecryptedMessages(50, 20).empty());
+    
+    // A redelivered message is kept once
+    recipient->receiveMessage(sent.front());
+    ASSERT_EQ(recipient->getDecryptedMessageCount(), 50u);
+    ASSERT_EQ(recipient->getDecryptedMessages().back(), "Message 49");
+}
+
+TEST_F(WalletTest, GroupMessageHandling) {
+    std::shared_ptr<Wallet> first = std::make_shared<Wallet>();
+    std::shared_ptr<Wallet> second = std::make_shared<Wallet>();
+    std::shared_ptr<Wallet> outsider = std::make_shared<Wallet>();
+    std::string testMessage = "Test group message";
+    
+    Transaction msgTx = wallet->createGroupMessage(
+        {first->getPublicKey(), second->getPublicKey()}, testMessage);
+    ASSERT_EQ(msgTx.getMessageKeys().size(), 2u);
+    ASSERT_FALSE(msgTx.isMessageRecipient(outsider->getPublicKey()));
+    ASSERT_THROW(outsider->receiveMessage(msgTx), std::runtime_error);
+    
+    first->receiveMessage(msgTx);
+    second->receiveMessage(msgTx);
+    ASSERT_EQ(first->getDecryptedMessages()[0], testMessage);
+    ASSERT_EQ(second->getDecryptedMessages()[0], testMessage);
+}
+
+TEST_F(WalletTest, BatchMessageCreation) {
+    std::vector<std::shared_ptr<Wallet>> recipients;
+    std::vector<Wallet::MessageRequest> requests;
+    for (int i = 0; i < 100; i++) {
+        recipients.push_back(std::make_shared<Wallet>());
+        requests.push_back({recipients.back()->getPublicKey(), "Batch message " + std::to_string(i)});
+    }
+    
+    std::vector<Transaction> messages = wallet->createMessages(requests);
+    ASSERT_EQ(messages.size(), requests.size());
+    
+    // Results come back in request order, signed and readable by their
+    // recipients
+    for (size_t i = 0; i < messages.size(); i++) {
+        ASSERT_EQ(messages[i].getRecipient(), recipients[i]->getAddress());
+        ASSERT_TRUE(SessionKeyCache::isEnvelope(messages[i].getEncryptedMessage()));
+        ASSERT_TRUE(messages[i].verify());
+        
+        recipients[i]->receiveMessage(messages[i]);
+        auto plaintexts = recipients[i]->getDecryptedMessages();
+        ASSERT_EQ(plaintexts.size(), 1u);
+        ASSERT_EQ(plaintexts[0], requests[i].message);
+    }
+}
\ No newline at end of file